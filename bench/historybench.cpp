@@ -0,0 +1,146 @@
+// Reports how well CompressedSeries packs real metric traces.
+//
+//   SystemMonitorHistoryBench [history-dir]   replays the app's recorded history
+//   SystemMonitorHistoryBench --live seconds  samples this host at 1 Hz first
+//
+// Prints bytes per sample for every series and overall, next to the 16
+// bytes a raw (timestamp, double) pair takes.
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include "../utils/compressedseries.h"
+#include "../utils/historystore.h"
+#include "../utils/metrichistory.h"
+#include "../utils/systeminfo.h"
+
+static constexpr double kRawBytesPerSample = 16.0;
+
+struct SeriesReport {
+    QString name;
+    int samples;
+    qint64 bytes;
+};
+
+static void printReports(QVector<SeriesReport> reports)
+{
+    QTextStream out(stdout);
+    std::sort(reports.begin(), reports.end(), [](const SeriesReport &a, const SeriesReport &b) {
+        return a.name < b.name;
+    });
+    qint64 totalSamples = 0;
+    qint64 totalBytes = 0;
+    for (const SeriesReport &report : reports) {
+        if (report.samples == 0) {
+            continue;
+        }
+        out << QString("%1 %2 samples %3 bytes/sample\n")
+                   .arg(report.name, -32)
+                   .arg(report.samples, 8)
+                   .arg(double(report.bytes) / report.samples, 8, 'f', 3);
+        totalSamples += report.samples;
+        totalBytes += report.bytes;
+    }
+    if (totalSamples == 0) {
+        out << "no samples\n";
+        return;
+    }
+    const double perSample = double(totalBytes) / totalSamples;
+    out << QString("total %1 series, %2 samples, %3 bytes/sample, %4x smaller than raw\n")
+               .arg(reports.size())
+               .arg(totalSamples)
+               .arg(perSample, 0, 'f', 3)
+               .arg(kRawBytesPerSample / perSample, 0, 'f', 1);
+}
+
+// Compresses every channel of the recorded families
+static QVector<SeriesReport> benchHistory(const QString &directory)
+{
+    static const char *const kFamilyNames[MetricFamilyCount] = {
+        "cpu", "memory", "network", "process", "disk", "diskio", "processdetail"
+    };
+    QVector<SeriesReport> reports;
+    HistoryStore store;
+    if (!store.openReadOnly(directory)) {
+        QTextStream(stderr) << "no history in " << directory << "\n";
+        return reports;
+    }
+    for (int family = 0; family < MetricFamilyCount; ++family) {
+        if (!HistoryStore::isRecorded(MetricFamily(family))) {
+            continue;
+        }
+        QVector<HistoryRecord> records;
+        store.query(MetricFamily(family), 0, QDateTime::currentMSecsSinceEpoch(), records);
+        for (int channel = 0; channel < kHistoryChannels; ++channel) {
+            CompressedSeries series;
+            for (const HistoryRecord &record : records) {
+                series.append(record.timestampMs, record.values[channel]);
+            }
+            reports.append({QString("%1.%2").arg(kFamilyNames[family]).arg(channel), series.size(),
+                            series.byteSize()});
+        }
+    }
+    return reports;
+}
+
+// Samples the host once per second, like the collector does
+static QVector<SeriesReport> benchLive(int seconds)
+{
+    QTextStream err(stderr);
+    QHash<QString, CompressedSeries> series;
+    for (int i = 0; i <= seconds; ++i) {
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        const CpuInfo cpu = SystemInfo::getCpuInfo();
+        series["cpu.total"].append(now, cpu.total.usage);
+        for (int core = 0; core < cpu.cores.size(); ++core) {
+            series[QString("cpu.core%1").arg(core)].append(now, cpu.cores.at(core).usage);
+        }
+        const MemoryInfo memory = SystemInfo::getMemoryInfo();
+        series["memory.used"].append(now, double(memory.usedPhysical));
+        series["memory.cached"].append(now, double(memory.cached));
+        for (const InterfaceStats &iface : SystemInfo::getInterfaceStats()) {
+            series[QString("net.%1.rx").arg(iface.name)].append(now, iface.rxBytesPerSec);
+            series[QString("net.%1.tx").arg(iface.name)].append(now, iface.txBytesPerSec);
+        }
+        for (const DiskIoStats &disk : SystemInfo::getDiskIoStats()) {
+            series[QString("disk.%1.read").arg(disk.name)].append(now, disk.readBytesPerSec);
+            series[QString("disk.%1.write").arg(disk.name)].append(now, disk.writeBytesPerSec);
+        }
+        if (i % 10 == 0) {
+            err << "sampled " << i << "/" << seconds << " s\r";
+            err.flush();
+        }
+        if (i < seconds) {
+            QThread::msleep(1000);
+        }
+    }
+    err << "\n";
+
+    QVector<SeriesReport> reports;
+    for (auto it = series.constBegin(); it != series.constEnd(); ++it) {
+        reports.append({it.key(), it.value().size(), it.value().byteSize()});
+    }
+    return reports;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // Same data location as the GUI
+    QCoreApplication::setApplicationName("SystemMonitor");
+
+    const QStringList args = app.arguments();
+    if (args.size() >= 3 && args.at(1) == "--live") {
+        printReports(benchLive(qMax(1, args.at(2).toInt())));
+        return 0;
+    }
+    const QString directory = args.size() >= 2
+        ? args.at(1)
+        : QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/history";
+    printReports(benchHistory(directory));
+    return 0;
+}
@@ -0,0 +1,240 @@
+#include "procfixture.h"
+#include <QDir>
+#include <QFile>
+
+// Process names cycled through the fixture; some have the spaces and
+// parentheses real comm values can contain
+static const char *const kProcessNames[] = {
+    "systemd", "kworker/3:1H", "bash", "sshd", "postgres", "nginx",
+    "Web Content", "java", "python3", "(sd-pam)", "a) b (c", "containerd-shim"
+};
+static constexpr int kProcessNameCount = sizeof(kProcessNames) / sizeof(kProcessNames[0]);
+
+// Fields of /proc/vmstat other than the ones the collector reads; their
+// number, not their values, is what matters
+static const char *const kVmstatKeys[] = {
+    "nr_free_pages", "nr_zone_inactive_anon", "nr_zone_active_anon", "nr_zone_inactive_file",
+    "nr_zone_active_file", "nr_zone_unevictable", "nr_zone_write_pending", "nr_mlock",
+    "nr_bounce", "nr_zspages", "nr_free_cma", "numa_hit", "numa_miss", "numa_foreign",
+    "numa_interleave", "numa_local", "numa_other", "nr_inactive_anon", "nr_active_anon",
+    "nr_inactive_file", "nr_active_file", "nr_unevictable", "nr_slab_reclaimable",
+    "nr_slab_unreclaimable", "nr_isolated_anon", "nr_isolated_file", "workingset_nodes",
+    "workingset_refault_anon", "workingset_refault_file", "workingset_activate_anon",
+    "workingset_activate_file", "workingset_restore_anon", "workingset_restore_file",
+    "workingset_nodereclaim", "nr_anon_pages", "nr_mapped", "nr_file_pages", "nr_dirty",
+    "nr_writeback", "nr_writeback_temp", "nr_shmem", "nr_shmem_hugepages", "nr_shmem_pmdmapped",
+    "nr_file_hugepages", "nr_file_pmdmapped", "nr_anon_transparent_hugepages", "nr_vmscan_write",
+    "nr_vmscan_immediate_reclaim", "nr_dirtied", "nr_written", "nr_kernel_misc_reclaimable",
+    "nr_foll_pin_acquired", "nr_foll_pin_released", "nr_kernel_stack", "nr_page_table_pages",
+    "nr_swapcached", "nr_dirty_threshold", "nr_dirty_background_threshold", "pgpgin", "pgpgout",
+    "pswpin", "pswpout", "pgalloc_dma", "pgalloc_dma32", "pgalloc_normal", "pgalloc_movable",
+    "allocstall_dma", "allocstall_dma32", "allocstall_normal", "allocstall_movable",
+    "pgskip_dma", "pgskip_dma32", "pgskip_normal", "pgskip_movable", "pgfree", "pgactivate",
+    "pgdeactivate", "pglazyfree", "pgfault", "pgmajfault", "pglazyfreed", "pgrefill",
+    "pgreuse", "pgsteal_kswapd", "pgsteal_direct", "pgscan_kswapd", "pgscan_direct",
+    "pgscan_direct_throttle", "pgscan_anon", "pgscan_file", "pgsteal_anon", "pgsteal_file",
+    "zone_reclaim_failed", "pginodesteal", "slabs_scanned", "kswapd_inodesteal",
+    "kswapd_low_wmark_hit_quickly", "kswapd_high_wmark_hit_quickly", "pageoutrun", "pgrotated",
+    "drop_pagecache", "drop_slab", "oom_kill", "numa_pte_updates", "numa_huge_pte_updates",
+    "numa_hint_faults", "numa_hint_faults_local", "numa_pages_migrated", "pgmigrate_success",
+    "pgmigrate_fail", "thp_migration_success", "thp_migration_fail", "compact_migrate_scanned",
+    "compact_free_scanned", "compact_isolated", "compact_stall", "compact_fail", "compact_success",
+    "htlb_buddy_alloc_success", "htlb_buddy_alloc_fail", "unevictable_pgs_culled",
+    "unevictable_pgs_scanned", "unevictable_pgs_rescued", "unevictable_pgs_mlocked",
+    "unevictable_pgs_munlocked", "unevictable_pgs_cleared", "unevictable_pgs_stranded",
+    "thp_fault_alloc", "thp_fault_fallback", "thp_collapse_alloc", "thp_split_page",
+    "thp_zero_page_alloc", "balloon_inflate", "balloon_deflate", "swap_ra", "swap_ra_hit",
+    "nr_unstable"
+};
+
+static QByteArray number(quint64 value)
+{
+    return QByteArray::number(value);
+}
+
+// "cpu" line fields: user nice system idle iowait irq softirq steal guest guest_nice
+static QByteArray cpuLine(const QByteArray &name, quint64 seed)
+{
+    QByteArray line = name;
+    const quint64 fields[] = {
+        seed * 7 + 1000, seed + 20, seed * 3 + 500, seed * 40 + 90000, seed + 300,
+        0, seed + 40, 0, 0, 0
+    };
+    for (quint64 field : fields) {
+        line += ' ';
+        line += number(field);
+    }
+    line += '\n';
+    return line;
+}
+
+ProcFixture::ProcFixture(const QString &root)
+    : m_root(root)
+    , m_pidCount(0)
+{
+}
+
+bool ProcFixture::writeFile(const QString &relativePath, const QByteArray &content) const
+{
+    QFile file(m_root + '/' + relativePath);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(content) == content.size();
+}
+
+bool ProcFixture::writeProcess(int pid) const
+{
+    const QString directory = QString("proc/%1").arg(pid);
+    if (!QDir(m_root).mkpath(directory)) {
+        return false;
+    }
+    const char *name = kProcessNames[pid % kProcessNameCount];
+    const quint64 ticks = quint64(pid) * 13;
+    char stat[512];
+    // All 52 fields of a 5.x kernel, so lines are as long as real ones
+    qsnprintf(stat, sizeof(stat),
+              "%d (%s) S 1 %d %d 0 -1 4194560 %llu 0 12 0 %llu %llu 0 0 20 0 %d 0 %llu %llu %llu "
+              "18446744073709551615 1 1 0 0 0 0 671173123 4096 1260 0 0 0 17 %d 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+              pid, name, pid, pid, ticks * 3, ticks, ticks / 2, 1 + pid % 8, 1000 + quint64(pid),
+              quint64(pid % 512 + 1) * 1048576, quint64(pid % 4096 + 100), pid % 64);
+    char io[256];
+    qsnprintf(io, sizeof(io),
+              "rchar: %llu\nwchar: %llu\nsyscr: %llu\nsyscw: %llu\n"
+              "read_bytes: %llu\nwrite_bytes: %llu\ncancelled_write_bytes: 0\n",
+              ticks * 4096, ticks * 2048, ticks, ticks / 2, ticks * 512, ticks * 256);
+    return writeFile(directory + "/stat", stat) && writeFile(directory + "/io", io);
+}
+
+bool ProcFixture::removeProcess(int pid) const
+{
+    return QDir(QString("%1/proc/%2").arg(m_root).arg(pid)).removeRecursively();
+}
+
+bool ProcFixture::setPidCount(int count)
+{
+    for (int pid = m_pidCount + 1; pid <= count; ++pid) {
+        if (!writeProcess(pid)) {
+            return false;
+        }
+    }
+    for (int pid = m_pidCount; pid > count; --pid) {
+        removeProcess(pid);
+    }
+    m_pidCount = count;
+    return true;
+}
+
+bool ProcFixture::create(const Scale &scale)
+{
+    QDir root(m_root);
+    if (!root.mkpath("proc/self") || !root.mkpath("proc/net") || !root.mkpath("sys/block")) {
+        return false;
+    }
+
+    QByteArray stat = cpuLine("cpu ", quint64(scale.cores) * 100);
+    for (int core = 0; core < scale.cores; ++core) {
+        stat += cpuLine("cpu" + number(core), 100 + core);
+    }
+    stat += "intr 123456789";
+    for (int i = 0; i < 256; ++i) {
+        stat += " 0";
+    }
+    stat += "\nctxt 987654321\nbtime 1700000000\nprocesses 123456\nprocs_running 3\n"
+            "procs_blocked 0\nsoftirq 1234 0 1 2 3 4 5 6 7 8 9\n";
+
+    const QByteArray meminfo =
+        "MemTotal:       65536000 kB\nMemFree:         8192000 kB\nMemAvailable:   40960000 kB\n"
+        "Buffers:          512000 kB\nCached:         30000000 kB\nSwapCached:         1024 kB\n"
+        "Active:         20000000 kB\nInactive:       25000000 kB\nActive(anon):    9000000 kB\n"
+        "Inactive(anon):   400000 kB\nActive(file):   11000000 kB\nInactive(file): 24600000 kB\n"
+        "Unevictable:       20000 kB\nMlocked:           20000 kB\nSwapTotal:       8388604 kB\n"
+        "SwapFree:        8300000 kB\nZswap:                 0 kB\nZswapped:              0 kB\n"
+        "Dirty:              2048 kB\nWriteback:             0 kB\nAnonPages:       9400000 kB\n"
+        "Mapped:          1200000 kB\nShmem:            300000 kB\nKReclaimable:    1500000 kB\n"
+        "Slab:            2000000 kB\nSReclaimable:    1500000 kB\nSUnreclaim:       500000 kB\n"
+        "KernelStack:       30000 kB\nPageTables:        90000 kB\nSecPageTables:         0 kB\n"
+        "NFS_Unstable:          0 kB\nBounce:                0 kB\nWritebackTmp:          0 kB\n"
+        "CommitLimit:   41156604 kB\nCommitted_AS:  20000000 kB\nVmallocTotal:   34359738367 kB\n"
+        "VmallocUsed:      200000 kB\nVmallocChunk:          0 kB\nPercpu:            40000 kB\n"
+        "HardwareCorrupted:     0 kB\nAnonHugePages:    200000 kB\nShmemHugePages:        0 kB\n"
+        "ShmemPmdMapped:        0 kB\nFileHugePages:         0 kB\nFilePmdMapped:         0 kB\n"
+        "HugePages_Total:       0\nHugePages_Free:        0\nHugePages_Rsvd:        0\n"
+        "HugePages_Surp:        0\nHugepagesize:       2048 kB\nHugetlb:               0 kB\n"
+        "DirectMap4k:      600000 kB\nDirectMap2M:    20000000 kB\nDirectMap1G:    48234496 kB\n";
+
+    QByteArray vmstat;
+    quint64 value = 1000;
+    for (const char *key : kVmstatKeys) {
+        vmstat += key;
+        vmstat += ' ';
+        vmstat += number(value);
+        vmstat += '\n';
+        value = value * 3 % 1000003;
+    }
+
+    // Whole disks with three partitions each, plus loop devices that the
+    // collector skips
+    QByteArray diskstats;
+    auto diskLine = [&diskstats](int major, int minor, const QByteArray &name, quint64 seed) {
+        char line[256];
+        qsnprintf(line, sizeof(line),
+                  "%4d %7d %s %llu 0 %llu %llu %llu 0 %llu %llu 0 %llu %llu 0 0 0 0 0 0\n",
+                  major, minor, name.constData(), seed * 10, seed * 80, seed * 5, seed * 20,
+                  seed * 160, seed * 9, seed * 11, seed * 14);
+        diskstats += line;
+    };
+    for (int disk = 0; disk < scale.disks; ++disk) {
+        const QByteArray name = "nvme" + number(disk) + "n1";
+        diskLine(259, disk * 16, name, 1000 + disk);
+        for (int partition = 1; partition <= 3; ++partition) {
+            diskLine(259, disk * 16 + partition, name + 'p' + number(partition), 100 + disk);
+        }
+        if (!root.mkpath("sys/block/" + QString::fromLatin1(name))) {
+            return false;
+        }
+    }
+    for (int loop = 0; loop < 8; ++loop) {
+        diskLine(7, loop, "loop" + number(loop), 1);
+    }
+    // An LVM volume on a SATA disk; only sda is counted
+    diskLine(8, 0, "sda", 500);
+    diskLine(8, 1, "sda1", 50);
+    diskLine(253, 0, "dm-0", 40);
+    if (!root.mkpath("sys/block/sda/holders/dm-0") || !root.mkpath("sys/block/dm-0/slaves/sda")) {
+        return false;
+    }
+
+    QByteArray netDev =
+        "Inter-|   Receive                                                |  Transmit\n"
+        " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+        "    lo: 123456 1000 0 0 0 0 0 0 123456 1000 0 0 0 0 0 0\n";
+    for (int iface = 0; iface < scale.interfaces; ++iface) {
+        const quint64 seed = 1000 + quint64(iface) * 37;
+        char line[256];
+        qsnprintf(line, sizeof(line),
+                  "veth%05d: %llu %llu 0 %llu 0 0 0 0 %llu %llu 0 0 0 0 0 0\n",
+                  iface, seed * 1500, seed, seed / 100, seed * 900, seed / 2);
+        netDev += line;
+    }
+
+    // Real filesystems first, then the pseudo ones MountTable filters out
+    QByteArray mounts;
+    for (int mount = 0; mount < scale.mounts; ++mount) {
+        const QByteArray point = "/mnt/vol" + number(mount);
+        if (!root.mkpath(QString::fromLatin1(point.mid(1)))) {
+            return false;
+        }
+        mounts += "/dev/nvme" + number(mount % qMax(1, scale.disks)) + "n1p" + number(mount % 3 + 1) +
+                  ' ' + point + " ext4 rw,relatime 0 0\n";
+    }
+    mounts += "proc /proc proc rw,nosuid,nodev,noexec,relatime 0 0\n"
+              "sysfs /sys sysfs rw,nosuid,nodev,noexec,relatime 0 0\n"
+              "devtmpfs /dev devtmpfs rw,nosuid,size=4096k,mode=755 0 0\n"
+              "tmpfs /run tmpfs rw,nosuid,nodev,size=6553600k,mode=755 0 0\n"
+              "cgroup2 /sys/fs/cgroup cgroup2 rw,nosuid,nodev,noexec,relatime 0 0\n";
+
+    if (!writeFile("proc/stat", stat) || !writeFile("proc/meminfo", meminfo) ||
+        !writeFile("proc/vmstat", vmstat) || !writeFile("proc/diskstats", diskstats) ||
+        !writeFile("proc/net/dev", netDev) || !writeFile("proc/self/mounts", mounts)) {
+        return false;
+    }
+    return setPidCount(scale.pids);
+}
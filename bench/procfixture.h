@@ -0,0 +1,50 @@
+#ifndef PROCFIXTURE_H
+#define PROCFIXTURE_H
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * @brief Writes a synthetic /proc and /sys tree for the collectors to read
+ *
+ * The tree holds what the Linux collectors parse, in the kernel's
+ * formats: proc/stat, meminfo, vmstat, diskstats, net/dev, self/mounts,
+ * a stat and io file per PID, and sys/block entries for the whole
+ * disks, one of them (sda) under a device-mapper volume (dm-0). Point
+ * ProcReader::setRoot() at root() to sample it.
+ *
+ * Mount points are created as directories under the root, so statvfs()
+ * works on them; they all live on the filesystem holding the fixture,
+ * which MountTable treats as one filesystem mounted many times.
+ */
+class ProcFixture
+{
+public:
+    struct Scale {
+        int pids = 1000;
+        int cores = 64;
+        int interfaces = 500;
+        int mounts = 200;
+        int disks = 32;
+    };
+
+    explicit ProcFixture(const QString &root);
+
+    // Writes every file; PIDs are 1..scale.pids
+    bool create(const Scale &scale);
+    // Adds or removes PID directories so that exactly count exist
+    bool setPidCount(int count);
+
+    QString root() const { return m_root; }
+    int pidCount() const { return m_pidCount; }
+
+private:
+    bool writeFile(const QString &relativePath, const QByteArray &content) const;
+    bool writeProcess(int pid) const;
+    bool removeProcess(int pid) const;
+
+    QString m_root;
+    int m_pidCount;
+};
+
+#endif // PROCFIXTURE_H
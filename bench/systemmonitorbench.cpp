@@ -0,0 +1,184 @@
+// Times every SystemInfo collector, and a full sampling pass, against a
+// generated /proc tree at several process counts.
+//
+//   SystemMonitorBench [--pids 1000,10000,100000] [--interfaces 500]
+//                      [--mounts 200] [--cores 64] [--iterations 20]
+//                      [--threads N] [--root dir] [--output file]
+//
+// Results are written as JSON (stdout by default), one entry per
+// collector and process count, with times in microseconds.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+#include <functional>
+#include "procfixture.h"
+#include "../samplecollector.h"
+#include "../utils/procreader.h"
+#include "../utils/systeminfo.h"
+
+struct Benchmark {
+    const char *name;
+    std::function<void()> run;
+};
+
+// Runs benchmark once untimed, so every collector has its baseline and
+// its buffers, then iterations times
+static QJsonObject measure(const Benchmark &benchmark, int iterations, int pids)
+{
+    benchmark.run();
+    QVector<double> micros;
+    micros.reserve(iterations);
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+        timer.start();
+        benchmark.run();
+        micros.append(timer.nsecsElapsed() / 1000.0);
+    }
+    std::sort(micros.begin(), micros.end());
+    double sum = 0.0;
+    for (double value : micros) {
+        sum += value;
+    }
+
+    QJsonObject result;
+    result["benchmark"] = benchmark.name;
+    result["pids"] = pids;
+    result["iterations"] = iterations;
+    result["min_us"] = micros.first();
+    result["median_us"] = micros.at(micros.size() / 2);
+    result["mean_us"] = sum / micros.size();
+    result["p95_us"] = micros.at(qMin(micros.size() - 1, int(micros.size() * 0.95)));
+    result["max_us"] = micros.last();
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("SystemMonitorBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks the collectors against a synthetic /proc tree.");
+    parser.addHelpOption();
+    parser.addOption({"pids", "Comma-separated process counts to run at.", "counts", "1000,10000,100000"});
+    parser.addOption({"interfaces", "Network interfaces in the fixture.", "count", "500"});
+    parser.addOption({"mounts", "Mounted filesystems in the fixture.", "count", "200"});
+    parser.addOption({"cores", "CPU cores in the fixture.", "count", "64"});
+    parser.addOption({"iterations", "Timed runs per benchmark.", "count", "20"});
+    parser.addOption({"threads", "Threads the process scan may use.", "count"});
+    parser.addOption({"root", "Build the fixture in this directory and keep it.", "dir"});
+    parser.addOption({"output", "Write the JSON results to file instead of stdout.", "file"});
+    parser.process(app);
+
+    QTextStream err(stderr);
+    QTemporaryDir temporary;
+    const QString root = parser.isSet("root") ? parser.value("root") : temporary.path();
+    if (root.isEmpty()) {
+        err << "Cannot create a fixture directory\n";
+        return 1;
+    }
+
+    QVector<int> pidCounts;
+    for (const QString &count : parser.value("pids").split(',', Qt::SkipEmptyParts)) {
+        pidCounts.append(qMax(1, count.toInt()));
+    }
+    ProcFixture::Scale scale;
+    scale.pids = pidCounts.value(0, 1000);
+    scale.interfaces = parser.value("interfaces").toInt();
+    scale.mounts = parser.value("mounts").toInt();
+    scale.cores = qMax(1, parser.value("cores").toInt());
+    const int iterations = qMax(1, parser.value("iterations").toInt());
+
+    ProcFixture fixture(root);
+    err << "Writing fixture to " << root << "\n";
+    err.flush();
+    if (!fixture.create(scale)) {
+        err << "Cannot write the fixture\n";
+        return 1;
+    }
+    // Before the first collector call, which opens the files for good
+    ProcReader::setRoot(QFile::encodeName(root));
+    if (parser.isSet("threads")) {
+        SystemInfo::setMaxScanThreads(parser.value("threads").toInt());
+    }
+
+    // The fixture's disks as the collector must see them: every nvme disk
+    // and sda, without partitions, loop devices or the dm-0 stacked on sda
+    SystemInfo::getDiskIoStats();
+    QStringList disks;
+    for (const DiskIoStats &disk : SystemInfo::getDiskIoStats()) {
+        disks.append(disk.name);
+    }
+    if (disks.size() != scale.disks + 1 || !disks.contains("sda") || disks.contains("dm-0")) {
+        err << "Unexpected disks in the fixture: " << disks.join(' ') << "\n";
+        return 1;
+    }
+
+    // A full sampling pass as SystemMonitor::updateData sees it: every
+    // family collected, published and picked up by the reader
+    TripleBuffer<SystemSnapshot> buffer;
+    SampleCollector collector(&buffer, nullptr, nullptr);
+    const Benchmark benchmarks[] = {
+        {"getCpuInfo", [] { SystemInfo::getCpuInfo(); }},
+        {"getMemoryInfo", [] { SystemInfo::getMemoryInfo(); }},
+        {"getDiskInfo", [] { SystemInfo::getDiskInfo(); }},
+        {"getDiskIoStats", [] { SystemInfo::getDiskIoStats(); }},
+        {"getNetworkStats", [] { SystemInfo::getNetworkStats(); }},
+        {"getInterfaceStats", [] { SystemInfo::getInterfaceStats(); }},
+        {"getProcesses", [] { SystemInfo::getProcesses(); }},
+        {"getTopProcesses", [] { SystemInfo::getTopProcesses(10); }},
+        {"updateData", [&] { collector.collect(kAllFamilies); buffer.acquire(); }},
+    };
+
+    QJsonArray results;
+    for (int pids : pidCounts) {
+        if (!fixture.setPidCount(pids)) {
+            err << "Cannot write " << pids << " processes\n";
+            return 1;
+        }
+        for (const Benchmark &benchmark : benchmarks) {
+            err << pids << " pids: " << benchmark.name << "\n";
+            err.flush();
+            results.append(measure(benchmark, iterations, pids));
+        }
+    }
+
+    QJsonObject fixtureInfo;
+    fixtureInfo["cores"] = scale.cores;
+    fixtureInfo["interfaces"] = scale.interfaces;
+    fixtureInfo["mounts"] = scale.mounts;
+    fixtureInfo["disks"] = scale.disks;
+    QJsonObject report;
+    report["version"] = 1;
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["host"] = QSysInfo::machineHostName();
+    report["cpu"] = QSysInfo::currentCpuArchitecture();
+    report["fixture"] = fixtureInfo;
+    report["results"] = results;
+    const QByteArray json = QJsonDocument(report).toJson();
+
+    QFile output;
+    bool opened = false;
+    if (parser.isSet("output")) {
+        output.setFileName(parser.value("output"));
+        opened = output.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    } else {
+        opened = output.open(stdout, QIODevice::WriteOnly);
+    }
+    if (!opened || output.write(json) != json.size()) {
+        err << "Cannot write the results\n";
+        return 1;
+    }
+    return 0;
+}
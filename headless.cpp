@@ -0,0 +1,198 @@
+#include "headless.h"
+#include "metricsserver.h"
+#include "samplewriter.h"
+#include "systemmonitor.h"
+#include "utils/instrumentation.h"
+#include "utils/proccapture.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <csignal>
+
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Write end of the pipe the signal handler wakes the event loop through
+static int g_signalFd = -1;
+
+static void onTerminationSignal(int)
+{
+    const char byte = 1;
+    ssize_t written = ::write(g_signalFd, &byte, 1);
+    Q_UNUSED(written);
+}
+
+// Quits the event loop on SIGINT or SIGTERM; only async-signal-safe work
+// happens in the handler itself
+static void installSignalHandlers(QCoreApplication *app)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        return;
+    }
+    g_signalFd = fds[0];
+    QSocketNotifier *notifier = new QSocketNotifier(fds[1], QSocketNotifier::Read, app);
+    QObject::connect(notifier, &QSocketNotifier::activated, app, &QCoreApplication::quit);
+
+    struct sigaction action = {};
+    action.sa_handler = onTerminationSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+}
+#else
+static void onTerminationSignal(int)
+{
+    // Posting an event is thread-safe, and the handler runs on its own thread
+    QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+}
+
+static void installSignalHandlers(QCoreApplication *)
+{
+    std::signal(SIGINT, onTerminationSignal);
+    std::signal(SIGTERM, onTerminationSignal);
+}
+#endif
+
+void addCaptureOptions(QCommandLineParser &parser)
+{
+    parser.addOption({"record", "Also write everything the collectors read to a capture file.", "file"});
+    parser.addOption({"replay", "Collect from a capture file instead of this host.", "file"});
+    parser.addOption({"replay-speed", "Replay at the recorded pace or as fast as possible.",
+                      "realtime|fast", "realtime"});
+}
+
+bool startCapture(const QCommandLineParser &parser, QTextStream &err)
+{
+    if (parser.isSet("record") && parser.isSet("replay")) {
+        err << "--record and --replay cannot be combined\n";
+        return false;
+    }
+    if (parser.isSet("record") && !ProcCapture::startRecording(parser.value("record"))) {
+        err << "Cannot record to " << parser.value("record") << ": " << ProcCapture::errorString() << "\n";
+        return false;
+    }
+    const ProcCapture::ReplaySpeed speed = parser.value("replay-speed") == "fast"
+                                               ? ProcCapture::AsFastAsPossible : ProcCapture::RealTime;
+    if (parser.isSet("replay") && !ProcCapture::startReplay(parser.value("replay"), speed)) {
+        err << "Cannot replay " << parser.value("replay") << ": " << ProcCapture::errorString() << "\n";
+        return false;
+    }
+    return true;
+}
+
+void addMetricsOptions(QCommandLineParser &parser)
+{
+    parser.addOption({"metrics-port", "Serve OpenMetrics over HTTP on this TCP port.", "port"});
+    parser.addOption({"metrics-address", "Address the metrics port binds to.", "address", "127.0.0.1"});
+    parser.addOption({"metrics-socket", "Serve OpenMetrics over HTTP on this local socket.", "path"});
+}
+
+bool wantsMetrics(const QCommandLineParser &parser)
+{
+    return parser.isSet("metrics-port") || parser.isSet("metrics-socket");
+}
+
+bool startMetrics(const QCommandLineParser &parser, SystemMonitor *monitor, QTextStream &err)
+{
+    // Rendering every snapshot is only worth it with somewhere to serve it
+    if (!wantsMetrics(parser)) {
+        return true;
+    }
+    MetricsServer *metrics = new MetricsServer(monitor, monitor);
+    QObject::connect(monitor, &SystemMonitor::dataUpdated, metrics, &MetricsServer::updateSnapshot);
+    if (parser.isSet("metrics-port")) {
+        bool ok = false;
+        const uint port = parser.value("metrics-port").toUInt(&ok);
+        if (!ok || port == 0 || port > 65535) {
+            err << "Invalid metrics port: " << parser.value("metrics-port") << "\n";
+            return false;
+        }
+        if (!metrics->listen(QHostAddress(parser.value("metrics-address")), quint16(port))) {
+            err << "Cannot serve metrics: " << metrics->errorString() << "\n";
+            return false;
+        }
+    }
+    if (parser.isSet("metrics-socket") && !metrics->listenLocal(parser.value("metrics-socket"))) {
+        err << "Cannot serve metrics: " << metrics->errorString() << "\n";
+        return false;
+    }
+    return true;
+}
+
+int runHeadless(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // Same data location, and so the same history, as the GUI
+    QCoreApplication::setApplicationName("SystemMonitor");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Samples system metrics and writes them as text lines.");
+    parser.addHelpOption();
+    parser.addOption({"headless", "Run without a GUI (implied by this binary)."});
+    parser.addOption({"interval", "Sampling interval in milliseconds.", "ms", "1000"});
+    parser.addOption({"output", "Append samples to file instead of stdout.", "file"});
+    parser.addOption({"diagnostics", "Measure what each collector costs and write it as JSON on exit.", "file"});
+    parser.addOption({"cpu-budget", "Back off sampling while the monitor uses more than this share of one core "
+                                    "(0 disables).", "percent"});
+    addCaptureOptions(parser);
+    addMetricsOptions(parser);
+    parser.process(app);
+
+    QTextStream err(stderr);
+    if (!startCapture(parser, err)) {
+        return 1;
+    }
+
+    QFile output;
+    const QString path = parser.value("output");
+    // Unbuffered: each snapshot is one write() and is visible immediately
+    bool opened = false;
+    if (path.isEmpty()) {
+        opened = output.open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered);
+    } else {
+        output.setFileName(path);
+        opened = output.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered);
+    }
+    if (!opened) {
+        err << "Cannot open " << (path.isEmpty() ? QString("stdout") : path) << "\n";
+        return 1;
+    }
+
+    SystemMonitor monitor;
+    SampleWriter writer(&monitor, &output);
+    QObject::connect(&monitor, &SystemMonitor::dataUpdated, &writer, &SampleWriter::writeSnapshot);
+
+    if (!startMetrics(parser, &monitor, err)) {
+        return 1;
+    }
+    installSignalHandlers(&app);
+
+    // A replay ends with the capture, reporting its throughput
+    QElapsedTimer replayTimer;
+    QObject::connect(&monitor, &SystemMonitor::replayFinished, &app, [&]() {
+        err << "Replayed " << ProcCapture::frameCount() << " frames in "
+            << replayTimer.elapsed() << " ms\n";
+        err.flush();
+        app.quit();
+    });
+    replayTimer.start();
+
+    // Samples always have a reader here, so nothing pauses for being hidden
+    if (parser.isSet("cpu-budget")) {
+        monitor.setCpuBudget(qMax(0.0, parser.value("cpu-budget").toDouble()));
+    }
+    Instrumentation::setEnabled(parser.isSet("diagnostics"));
+    monitor.startMonitoring(qMax(100, parser.value("interval").toInt()));
+    const int status = app.exec();
+    ProcCapture::stop();
+    if (parser.isSet("diagnostics") && !Instrumentation::writeJson(parser.value("diagnostics"))) {
+        err << "Cannot write diagnostics to " << parser.value("diagnostics") << "\n";
+    }
+    return status;
+}
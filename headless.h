@@ -0,0 +1,38 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+class QCommandLineParser;
+class QTextStream;
+class SystemMonitor;
+
+/**
+ * @brief Runs the collector without any GUI, on a QCoreApplication
+ *
+ * Options: --interval <ms> (default 1000) and --output <file> (appends;
+ * default stdout), plus the metrics options below. Samples are written in SampleWriter's line format
+ * until SIGINT or SIGTERM. Used by the SystemMonitorHeadless binary and
+ * by "SystemMonitor --headless".
+ *
+ * With --replay <file> the run collects from a ProcCapture instead, and
+ * exits once the capture is done, printing how long it took.
+ * --diagnostics <file> enables Instrumentation and writes its JSON report
+ * on exit.
+ */
+int runHeadless(int argc, char *argv[]);
+
+// --record <file>, --replay <file> and --replay-speed realtime|fast, shared
+// with the GUI. startCapture() must run before any SystemMonitor exists;
+// false, with the reason written to err, if the capture cannot start.
+void addCaptureOptions(QCommandLineParser &parser);
+bool startCapture(const QCommandLineParser &parser, QTextStream &err);
+
+// --metrics-port <port> (with --metrics-address, default 127.0.0.1) and
+// --metrics-socket <path>, shared with the GUI. startMetrics() serves
+// monitor's snapshots through a MetricsServer, which only exists when one
+// of them is given; false, with the reason written to err, if it cannot
+// listen.
+void addMetricsOptions(QCommandLineParser &parser);
+bool wantsMetrics(const QCommandLineParser &parser);
+bool startMetrics(const QCommandLineParser &parser, SystemMonitor *monitor, QTextStream &err);
+
+#endif // HEADLESS_H
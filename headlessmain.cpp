@@ -0,0 +1,6 @@
+#include "headless.h"
+
+int main(int argc, char *argv[])
+{
+    return runHeadless(argc, argv);
+}
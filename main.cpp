@@ -1,13 +1,33 @@
+#include "headless.h"
 #include "mainwindow.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QLocale>
+#include <QTextStream>
 #include <QTranslator>
 
 int main(int argc, char *argv[])
 {
+    // Decided before QApplication exists, which would need a display
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--headless") == 0) {
+            return runHeadless(argc, argv);
+        }
+    }
+
     QApplication a(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    addCaptureOptions(parser);
+    addMetricsOptions(parser);
+    parser.process(a);
+    QTextStream err(stderr);
+    if (!startCapture(parser, err)) {
+        return 1;
+    }
+
     QTranslator translator;
     const QStringList uiLanguages = QLocale::system().uiLanguages();
     for (const QString &locale : uiLanguages) {
@@ -18,6 +38,10 @@ int main(int argc, char *argv[])
         }
     }
     MainWindow w;
+    if (!startMetrics(parser, w.systemMonitor(), err)) {
+        return 1;
+    }
+    w.setServingMetrics(wantsMetrics(parser));
     w.show();
     return a.exec();
 }
@@ -2,9 +2,17 @@
 #include "./ui_mainwindow.h"
 #include "systemmonitor.h"
 #include "utils/formatters.h"
+#include "widgets/chartwidget.h"
+#include "widgets/diagnosticsdialog.h"
 #include "widgets/infocard.h"
+#include "widgets/processtable.h"
 #include <iostream>
+#include <QAction>
+#include <QDateTime>
+#include <QMenu>
+#include <QMenuBar>
 #include <QTimer>
+#include <QWindow>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -13,7 +21,13 @@ MainWindow::MainWindow(QWidget *parent)
     , m_memoryCard(nullptr)
     , m_diskCard(nullptr)
     , m_networkCard(nullptr)
+    , m_cpuChart(nullptr)
+    , m_memoryChart(nullptr)
+    , m_processTable(nullptr)
     , m_systemMonitor(nullptr)
+    , m_diagnostics(nullptr)
+    , m_viewsVisible(true)
+    , m_servingMetrics(false)
 {
     ui->setupUi(this);
 
@@ -34,9 +48,89 @@ MainWindow::MainWindow(QWidget *parent)
     gridLayout->addWidget(m_diskCard, 1, 0);
     gridLayout->addWidget(m_networkCard, 1, 1);
 
+    // History charts below the cards
+    setUpCharts();
+    gridLayout->addWidget(m_cpuChart, 2, 0);
+    gridLayout->addWidget(m_memoryChart, 2, 1);
+
+    // Process list across the bottom, taking the extra height
+    m_processTable = new ProcessTable(this);
+    gridLayout->addWidget(m_processTable, 3, 0, 1, 2);
+    gridLayout->setRowStretch(3, 1);
+
     // Setup system monitoring
     setUpSystemMonitor();
 
+    setUpMenus();
+}
+
+void MainWindow::setUpMenus()
+{
+    QMenu *viewMenu = ui->menubar->addMenu("&View");
+    QAction *diagnostics = viewMenu->addAction("&Diagnostics…");
+    diagnostics->setShortcut(QKeySequence("Ctrl+Shift+D"));
+    connect(diagnostics, &QAction::triggered, this, &MainWindow::showDiagnostics);
+}
+
+void MainWindow::changeEvent(QEvent *event)
+{
+    QMainWindow::changeEvent(event);
+    if (event->type() == QEvent::WindowStateChange) {
+        updateViewsVisible();
+    }
+}
+
+void MainWindow::showEvent(QShowEvent *event)
+{
+    QMainWindow::showEvent(event);
+    // The native window exists from the first show; its expose events
+    // tell when it is covered or on another workspace
+    windowHandle()->removeEventFilter(this);
+    windowHandle()->installEventFilter(this);
+    updateViewsVisible();
+}
+
+void MainWindow::hideEvent(QHideEvent *event)
+{
+    QMainWindow::hideEvent(event);
+    updateViewsVisible();
+}
+
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == windowHandle() && event->type() == QEvent::Expose) {
+        updateViewsVisible();
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::setServingMetrics(bool serving)
+{
+    m_servingMetrics = serving;
+    updateViewsVisible();
+}
+
+void MainWindow::updateViewsVisible()
+{
+    // Minimised, hidden or fully covered windows show nothing, so the
+    // monitor can sample less, unless it also feeds scrapers
+    const bool visible = m_servingMetrics ||
+                         (isVisible() && !isMinimized() && windowHandle() && windowHandle()->isExposed());
+    if (visible == m_viewsVisible || !m_systemMonitor) {
+        return;
+    }
+    m_viewsVisible = visible;
+    m_systemMonitor->setViewsVisible(visible);
+}
+
+void MainWindow::showDiagnostics()
+{
+    if (!m_diagnostics) {
+        m_diagnostics = new DiagnosticsDialog(this);
+    }
+    m_diagnostics->show();
+    m_diagnostics->raise();
+    m_diagnostics->activateWindow();
 }
 
 void MainWindow::setUpCards()
@@ -68,12 +162,57 @@ void MainWindow::setUpCards()
     m_networkCard->setSubtitle("Network activity");
 }
 
+void MainWindow::setUpCharts()
+{
+    m_cpuChart = new ChartWidget("CPU History", this);
+    m_cpuChart->setValueSuffix("%");
+
+    m_memoryChart = new ChartWidget("Memory History", this);
+    m_memoryChart->setColor(QColor("#4CAF50"));
+    m_memoryChart->setValueSuffix("%");
+}
+
+void MainWindow::seedChartsFromHistory()
+{
+    // The charts keep a few hours; older history stays on disk
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 from = now - 4 * 3600 * 1000;
+    for (const HistoryRecord &record : m_systemMonitor->history(CpuFamily, from, now)) {
+        m_cpuChart->addDataPoint(record.timestampMs, record.values[CpuUsageChannel]);
+    }
+    for (const HistoryRecord &record : m_systemMonitor->history(MemoryFamily, from, now)) {
+        m_memoryChart->addDataPoint(record.timestampMs, record.values[MemoryUsageChannel]);
+    }
+}
+
 void MainWindow::onCpuUsageChanged(double usage)
 {
+    if (m_cpuChart && m_systemMonitor) {
+        m_cpuChart->addDataPoint(m_systemMonitor->snapshot().timestampMs, usage);
+    }
     if (m_cpuCard) {
         m_cpuCard->setValue(Formatters::formatPercentage(usage));
         m_cpuCard->setPercentage(usage);
     }
+    if (m_cpuCard && m_systemMonitor) {
+        // Steal and iowait are hidden by the aggregate, and so is a single hot core
+        const CpuInfo info = m_systemMonitor->getCpuInfo();
+        int hottestCore = -1;
+        for (int i = 0; i < info.cores.size(); ++i) {
+            if (hottestCore < 0 || info.cores[i].usage > info.cores[hottestCore].usage) {
+                hottestCore = i;
+            }
+        }
+        QString subtitle = QString("iowait %1 · steal %2")
+                               .arg(Formatters::formatPercentage(info.total.iowait))
+                               .arg(Formatters::formatPercentage(info.total.steal));
+        if (hottestCore >= 0) {
+            subtitle += QString(" · core %1 at %2")
+                            .arg(hottestCore)
+                            .arg(Formatters::formatPercentage(info.cores[hottestCore].usage));
+        }
+        m_cpuCard->setSubtitle(subtitle);
+    }
 }
 
 void MainWindow::onMemoryUsageChanged(qint64 used, qint64 total)
@@ -84,6 +223,21 @@ void MainWindow::onMemoryUsageChanged(qint64 used, qint64 total)
                                    .arg(Formatters::formatBytes(used))
                                    .arg(Formatters::formatBytes(total)));
         m_memoryCard->setPercentage(usagePercent);
+        if (m_memoryChart && m_systemMonitor) {
+            m_memoryChart->addDataPoint(m_systemMonitor->snapshot().timestampMs, usagePercent);
+        }
+    }
+    if (m_memoryCard && m_systemMonitor) {
+        const MemoryInfo memory = m_systemMonitor->getMemoryInfo();
+        QString subtitle = QString("%1 available · %2 cached")
+                               .arg(Formatters::formatBytes(memory.availablePhysical))
+                               .arg(Formatters::formatBytes(memory.cached));
+        if (memory.majorFaultsPerSec >= 1.0 || memory.swapInPagesPerSec + memory.swapOutPagesPerSec >= 1.0) {
+            subtitle += QString(" · %1 swap pg/s · %2 major faults/s")
+                            .arg(memory.swapInPagesPerSec + memory.swapOutPagesPerSec, 0, 'f', 0)
+                            .arg(memory.majorFaultsPerSec, 0, 'f', 0);
+        }
+        m_memoryCard->setSubtitle(subtitle);
     }
 }
 
@@ -96,6 +250,22 @@ void MainWindow::onNetworkActivityChanged(double downloadKBps, double uploadKBps
         double percentage = qMin(100.0, (totalKBps / 1024.0) / 100.0 * 100.0);
         m_networkCard->setPercentage(percentage);
     }
+    if (m_networkCard && m_systemMonitor) {
+        // Packet, drop and error rates over all interfaces
+        double packets = 0.0, drops = 0.0, errors = 0.0;
+        for (const InterfaceStats &iface : m_systemMonitor->getInterfaceStats()) {
+            packets += iface.rxPacketsPerSec + iface.txPacketsPerSec;
+            drops += iface.rxDropsPerSec + iface.txDropsPerSec;
+            errors += iface.rxErrorsPerSec + iface.txErrorsPerSec;
+        }
+        const NetworkStats stats = m_systemMonitor->getNetworkStats();
+        m_networkCard->setSubtitle(QString("%1 · %2 pkt/s · %3 drop/s · %4 err/s")
+                                       .arg(stats.interfaceName.isEmpty() ? QString("Network activity")
+                                                                          : stats.interfaceName)
+                                       .arg(packets, 0, 'f', 0)
+                                       .arg(drops, 0, 'f', 0)
+                                       .arg(errors, 0, 'f', 0));
+    }
 }
 
 void MainWindow::updateDiskUsage()
@@ -112,6 +282,25 @@ void MainWindow::updateDiskUsage()
                                      .arg(Formatters::formatBytes(disk.totalSpace)));
             m_diskCard->setPercentage(usagePercent);
         }
+
+        // Throughput and latency summed over all disks
+        const auto diskIo = m_systemMonitor->getDiskIoStats();
+        double readBytesPerSec = 0.0, writeBytesPerSec = 0.0, requests = 0.0, weightedLatency = 0.0;
+        for (const DiskIoStats &io : diskIo) {
+            readBytesPerSec += io.readBytesPerSec;
+            writeBytesPerSec += io.writeBytesPerSec;
+            const double iops = io.readIops + io.writeIops;
+            requests += iops;
+            weightedLatency += io.avgLatencyMs * iops;
+        }
+        if (!diskIo.isEmpty()) {
+            const double latencyMs = requests > 0.0 ? weightedLatency / requests : 0.0;
+            m_diskCard->setSecondaryValue(QString("R %1 · W %2 · %3 IOPS · %4 ms")
+                                              .arg(Formatters::formatSpeed(readBytesPerSec / 1024.0))
+                                              .arg(Formatters::formatSpeed(writeBytesPerSec / 1024.0))
+                                              .arg(requests, 0, 'f', 0)
+                                              .arg(latencyMs, 0, 'f', 1));
+        }
     }
 }
 
@@ -129,6 +318,21 @@ void MainWindow::setUpSystemMonitor()
 
     connect(m_systemMonitor, &SystemMonitor::dataUpdated, this, &MainWindow::updateDiskUsage);
 
+    // The process table diffs each snapshot in, and asks for details of
+    // the rows it shows
+    connect(m_systemMonitor, &SystemMonitor::dataUpdated, this, [this]() {
+        m_processTable->updateSnapshot(m_systemMonitor->snapshot());
+    });
+    connect(m_processTable, &ProcessTable::watchedProcessesChanged, m_systemMonitor,
+            &SystemMonitor::setWatchedProcesses);
+
+    // Show what was recorded before this run, then continue live; wide
+    // views switch to the minute and hour rollups
+    seedChartsFromHistory();
+    m_systemMonitor->enableRollups();
+    m_cpuChart->setRollups(m_systemMonitor->rollups()->series(CpuFamily, CpuUsageChannel));
+    m_memoryChart->setRollups(m_systemMonitor->rollups()->series(MemoryFamily, MemoryUsageChannel));
+
     // Start monitoring with 1 second intervals
     m_systemMonitor->startMonitoring(1000);
 }
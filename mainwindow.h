@@ -10,7 +10,10 @@ class MainWindow;
 }
 QT_END_NAMESPACE
 
+class ChartWidget;
+class DiagnosticsDialog;
 class InfoCard;
+class ProcessTable;
 class SystemMonitor;
 
 class MainWindow : public QMainWindow
@@ -21,15 +24,31 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    SystemMonitor *systemMonitor() const { return m_systemMonitor; }
+    // Scrapers read the snapshots too, so sampling no longer slows down
+    // while the window is hidden
+    void setServingMetrics(bool serving);
+
+protected:
+    void changeEvent(QEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private slots:
     void onCpuUsageChanged(double usage);
     void onMemoryUsageChanged(qint64 used, qint64 total);
     void onNetworkActivityChanged(double downloadKBps, double uploadKBps);
     void updateDiskUsage();
+    void showDiagnostics();
 
 private:
     void setUpCards();
+    void setUpCharts();
+    void seedChartsFromHistory();
     void setUpSystemMonitor();
+    void setUpMenus();
+    void updateViewsVisible();
 private:
     Ui::MainWindow *ui;
     // InfoCard instances
@@ -37,8 +56,18 @@ private:
     InfoCard *m_memoryCard;
     InfoCard *m_diskCard;
     InfoCard *m_networkCard;
+    // History charts
+    ChartWidget *m_cpuChart;
+    ChartWidget *m_memoryChart;
+    // Every process, below the charts
+    ProcessTable *m_processTable;
 
     // System monitoring
     SystemMonitor *m_systemMonitor;
+    // Created on first use
+    DiagnosticsDialog *m_diagnostics;
+    // Last visibility passed to the monitor
+    bool m_viewsVisible;
+    bool m_servingMetrics;
 };
 #endif // MAINWINDOW_H
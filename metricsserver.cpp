@@ -0,0 +1,514 @@
+#include "metricsserver.h"
+#include "systemmonitor.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QVector>
+#include <algorithm>
+
+// Busiest processes exported from each ranking
+static constexpr int kExportedProcessCount = 10;
+// Longest request head accepted before the connection is dropped
+static constexpr int kMaxRequestSize = 8192;
+// Connections served at once; more are refused until one closes
+static constexpr int kMaxConnections = 32;
+// Connections without traffic for this long are dropped
+static constexpr int kIdleTimeoutMs = 30000;
+
+static const char kContentType[] = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+// One metric family read from a sampled item of type Item
+template<typename Item>
+struct MetricField {
+    const char *name;
+    const char *type; // "gauge" or "counter"
+    const char *help;
+    double (*value)(const Item &item);
+};
+
+static void appendLabel(QByteArray &labels, const char *key, const QString &value)
+{
+    if (!labels.isEmpty()) {
+        labels += ',';
+    }
+    labels += key;
+    labels += "=\"";
+    for (char c : value.toUtf8()) {
+        switch (c) {
+        case '\\': labels += "\\\\"; break;
+        case '"': labels += "\\\""; break;
+        case '\n': labels += "\\n"; break;
+        default: labels += c; break;
+        }
+    }
+    labels += '"';
+}
+
+static void appendFamily(QByteArray &out, const char *name, const char *type, const char *help)
+{
+    out += "# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += "\n# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += '\n';
+}
+
+static void appendSample(QByteArray &out, const char *name, const char *suffix,
+                         const QByteArray &labels, double value)
+{
+    out += name;
+    out += suffix;
+    if (!labels.isEmpty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    if (qIsFinite(value)) {
+        out += QByteArray::number(value, 'g', 15);
+    } else {
+        out += "NaN";
+    }
+    out += '\n';
+}
+
+// Writes every field of fields as a family with one sample per item;
+// labels[i] holds the label set of items[i]
+template<typename Item, int N>
+static void appendFamilies(QByteArray &out, const MetricField<Item> (&fields)[N],
+                           const QVector<Item> &items, const QVector<QByteArray> &labels)
+{
+    for (const MetricField<Item> &field : fields) {
+        // Counter samples carry the _total suffix, their family does not
+        const char *suffix = qstrcmp(field.type, "counter") == 0 ? "_total" : "";
+        appendFamily(out, field.name, field.type, field.help);
+        for (int i = 0; i < items.size(); ++i) {
+            appendSample(out, field.name, suffix, labels.at(i), field.value(items.at(i)));
+        }
+    }
+}
+
+static const MetricField<MemoryInfo> memoryFields[] = {
+    {"systemmonitor_memory_total_bytes", "gauge", "Physical memory.",
+     [](const MemoryInfo &m) { return double(m.totalPhysical); }},
+    {"systemmonitor_memory_available_bytes", "gauge", "Memory that can be allocated without swapping.",
+     [](const MemoryInfo &m) { return double(m.availablePhysical); }},
+    {"systemmonitor_memory_used_bytes", "gauge", "Physical memory in use, page cache excluded.",
+     [](const MemoryInfo &m) { return double(m.usedPhysical); }},
+    {"systemmonitor_memory_free_bytes", "gauge", "Physical memory not used for anything.",
+     [](const MemoryInfo &m) { return double(m.freePhysical); }},
+    {"systemmonitor_memory_buffers_bytes", "gauge", "Block device buffers.",
+     [](const MemoryInfo &m) { return double(m.buffers); }},
+    {"systemmonitor_memory_cached_bytes", "gauge", "Page cache.",
+     [](const MemoryInfo &m) { return double(m.cached); }},
+    {"systemmonitor_memory_dirty_bytes", "gauge", "Page cache waiting to be written back.",
+     [](const MemoryInfo &m) { return double(m.dirty); }},
+    {"systemmonitor_memory_writeback_bytes", "gauge", "Page cache being written back.",
+     [](const MemoryInfo &m) { return double(m.writeback); }},
+    {"systemmonitor_memory_slab_bytes", "gauge", "Kernel slab allocations.",
+     [](const MemoryInfo &m) { return double(m.slab); }},
+    {"systemmonitor_memory_slab_reclaimable_bytes", "gauge", "Slab allocations the kernel can reclaim.",
+     [](const MemoryInfo &m) { return double(m.slabReclaimable); }},
+    {"systemmonitor_memory_shmem_bytes", "gauge", "Shared memory and tmpfs.",
+     [](const MemoryInfo &m) { return double(m.shmem); }},
+    {"systemmonitor_swap_total_bytes", "gauge", "Swap space.",
+     [](const MemoryInfo &m) { return double(m.totalVirtual); }},
+    {"systemmonitor_swap_free_bytes", "gauge", "Unused swap space.",
+     [](const MemoryInfo &m) { return double(m.availableVirtual); }},
+    {"systemmonitor_swap_in_pages_per_second", "gauge", "Pages swapped in over the last interval.",
+     [](const MemoryInfo &m) { return m.swapInPagesPerSec; }},
+    {"systemmonitor_swap_out_pages_per_second", "gauge", "Pages swapped out over the last interval.",
+     [](const MemoryInfo &m) { return m.swapOutPagesPerSec; }},
+    {"systemmonitor_page_faults_per_second", "gauge", "Page faults over the last interval.",
+     [](const MemoryInfo &m) { return m.pageFaultsPerSec; }},
+    {"systemmonitor_major_page_faults_per_second", "gauge", "Page faults that needed I/O over the last interval.",
+     [](const MemoryInfo &m) { return m.majorFaultsPerSec; }},
+};
+
+static const MetricField<InterfaceStats> interfaceFields[] = {
+    {"systemmonitor_network_up", "gauge", "Whether the interface is up.",
+     [](const InterfaceStats &s) { return s.up ? 1.0 : 0.0; }},
+    {"systemmonitor_network_receive_bytes", "counter", "Bytes received since the interface came up.",
+     [](const InterfaceStats &s) { return double(s.rxBytes); }},
+    {"systemmonitor_network_transmit_bytes", "counter", "Bytes sent since the interface came up.",
+     [](const InterfaceStats &s) { return double(s.txBytes); }},
+    {"systemmonitor_network_receive_bytes_per_second", "gauge", "Receive rate over the last interval.",
+     [](const InterfaceStats &s) { return s.rxBytesPerSec; }},
+    {"systemmonitor_network_transmit_bytes_per_second", "gauge", "Send rate over the last interval.",
+     [](const InterfaceStats &s) { return s.txBytesPerSec; }},
+    {"systemmonitor_network_receive_packets_per_second", "gauge", "Packets received over the last interval.",
+     [](const InterfaceStats &s) { return s.rxPacketsPerSec; }},
+    {"systemmonitor_network_transmit_packets_per_second", "gauge", "Packets sent over the last interval.",
+     [](const InterfaceStats &s) { return s.txPacketsPerSec; }},
+    {"systemmonitor_network_drops_per_second", "gauge", "Dropped packets, both directions, over the last interval.",
+     [](const InterfaceStats &s) { return s.rxDropsPerSec + s.txDropsPerSec; }},
+    {"systemmonitor_network_errors_per_second", "gauge", "Packet errors, both directions, over the last interval.",
+     [](const InterfaceStats &s) { return s.rxErrorsPerSec + s.txErrorsPerSec; }},
+};
+
+static const MetricField<DiskIoStats> diskIoFields[] = {
+    {"systemmonitor_disk_read_bytes_per_second", "gauge", "Read rate over the last interval.",
+     [](const DiskIoStats &s) { return s.readBytesPerSec; }},
+    {"systemmonitor_disk_write_bytes_per_second", "gauge", "Write rate over the last interval.",
+     [](const DiskIoStats &s) { return s.writeBytesPerSec; }},
+    {"systemmonitor_disk_reads_per_second", "gauge", "Completed reads over the last interval.",
+     [](const DiskIoStats &s) { return s.readIops; }},
+    {"systemmonitor_disk_writes_per_second", "gauge", "Completed writes over the last interval.",
+     [](const DiskIoStats &s) { return s.writeIops; }},
+    {"systemmonitor_disk_queue_depth", "gauge", "Average requests in flight over the last interval.",
+     [](const DiskIoStats &s) { return s.avgQueueDepth; }},
+    {"systemmonitor_disk_latency_seconds", "gauge", "Average time per completed request over the last interval.",
+     [](const DiskIoStats &s) { return s.avgLatencyMs / 1000.0; }},
+    {"systemmonitor_disk_utilization_percent", "gauge", "Time with requests in flight over the last interval.",
+     [](const DiskIoStats &s) { return s.utilization; }},
+};
+
+static const MetricField<DiskInfo> filesystemFields[] = {
+    {"systemmonitor_filesystem_size_bytes", "gauge", "Filesystem size.",
+     [](const DiskInfo &d) { return double(d.totalSpace); }},
+    {"systemmonitor_filesystem_used_bytes", "gauge", "Filesystem space in use.",
+     [](const DiskInfo &d) { return double(d.usedSpace); }},
+    {"systemmonitor_filesystem_available_bytes", "gauge", "Filesystem space available to unprivileged users.",
+     [](const DiskInfo &d) { return double(d.availableSpace); }},
+};
+
+static const MetricField<ProcessInfo> processFields[] = {
+    {"systemmonitor_process_cpu_percent", "gauge", "Process CPU usage over the last interval.",
+     [](const ProcessInfo &p) { return p.cpuUsage; }},
+    {"systemmonitor_process_memory_bytes", "gauge", "Process memory usage.",
+     [](const ProcessInfo &p) { return double(p.memoryUsage); }},
+    {"systemmonitor_process_io_bytes_per_second", "gauge", "Process storage reads and writes over the last interval.",
+     [](const ProcessInfo &p) { return double(p.ioBytesPerSec); }},
+};
+
+static const struct {
+    const char *label;
+    double CpuCoreUsage::*field;
+} cpuModes[] = {
+    {"mode=\"user\"", &CpuCoreUsage::user},
+    {"mode=\"system\"", &CpuCoreUsage::system},
+    {"mode=\"iowait\"", &CpuCoreUsage::iowait},
+    {"mode=\"irq\"", &CpuCoreUsage::irq},
+    {"mode=\"steal\"", &CpuCoreUsage::steal},
+};
+
+void MetricsServer::render(const SystemSnapshot &snapshot, QByteArray &out)
+{
+    // reserve() keeps the allocation through resize(0) on Qt 5 as well
+    out.reserve(out.capacity());
+    out.resize(0);
+
+    // CPU: the total first, then each core by number
+    QVector<CpuCoreUsage> cpus;
+    QVector<QByteArray> cpuLabels;
+    cpus.reserve(snapshot.cpu.cores.size() + 1);
+    cpus.append(snapshot.cpu.total);
+    cpuLabels.append("cpu=\"total\"");
+    for (int i = 0; i < snapshot.cpu.cores.size(); ++i) {
+        cpus.append(snapshot.cpu.cores.at(i));
+        cpuLabels.append("cpu=\"" + QByteArray::number(i) + '"');
+    }
+    static const MetricField<CpuCoreUsage> cpuFields[] = {
+        {"systemmonitor_cpu_usage_percent", "gauge", "CPU time outside idle and iowait over the last interval.",
+         [](const CpuCoreUsage &c) { return c.usage; }},
+    };
+    appendFamilies(out, cpuFields, cpus, cpuLabels);
+    appendFamily(out, "systemmonitor_cpu_mode_percent", "gauge", "CPU time by mode over the last interval.");
+    for (int i = 0; i < cpus.size(); ++i) {
+        for (const auto &mode : cpuModes) {
+            appendSample(out, "systemmonitor_cpu_mode_percent", "",
+                         cpuLabels.at(i) + ',' + mode.label, cpus.at(i).*mode.field);
+        }
+    }
+
+    appendFamilies(out, memoryFields, QVector<MemoryInfo>{snapshot.memory}, QVector<QByteArray>{QByteArray()});
+
+    QVector<QByteArray> labels;
+    for (const InterfaceStats &iface : snapshot.interfaces) {
+        QByteArray set;
+        appendLabel(set, "interface", iface.name);
+        labels.append(set);
+    }
+    appendFamilies(out, interfaceFields, snapshot.interfaces, labels);
+
+    labels.clear();
+    for (const DiskIoStats &disk : snapshot.diskIo) {
+        QByteArray set;
+        appendLabel(set, "device", disk.name);
+        labels.append(set);
+    }
+    appendFamilies(out, diskIoFields, snapshot.diskIo, labels);
+
+    labels.clear();
+    for (const DiskInfo &disk : snapshot.disks) {
+        QByteArray set;
+        appendLabel(set, "mountpoint", disk.mountPoint);
+        appendLabel(set, "device", disk.name);
+        appendLabel(set, "fstype", disk.fileSystem);
+        labels.append(set);
+    }
+    appendFamilies(out, filesystemFields, snapshot.disks, labels);
+
+    // The busiest processes of every ranking, each exported once
+    QVector<ProcessInfo> processes;
+    labels.clear();
+    for (const QVector<ProcessInfo> &ranking : snapshot.topProcesses) {
+        for (int i = 0; i < qMin(kExportedProcessCount, ranking.size()); ++i) {
+            const ProcessInfo &process = ranking.at(i);
+            const bool seen = std::any_of(processes.cbegin(), processes.cend(),
+                                          [&](const ProcessInfo &p) { return p.pid == process.pid; });
+            if (seen) {
+                continue;
+            }
+            QByteArray set;
+            appendLabel(set, "pid", QString::number(process.pid));
+            appendLabel(set, "name", process.name);
+            processes.append(process);
+            labels.append(set);
+        }
+    }
+    appendFamilies(out, processFields, processes, labels);
+
+    out += "# EOF\n";
+}
+
+MetricsServer::MetricsServer(const SystemMonitor *monitor, QObject *parent)
+    : QObject{parent}
+    , m_monitor(monitor)
+    , m_idleTimer(new QTimer(this))
+{
+    m_clock.start();
+    m_idleTimer->setInterval(kIdleTimeoutMs / 2);
+    connect(m_idleTimer, &QTimer::timeout, this, &MetricsServer::dropIdleConnections);
+}
+
+bool MetricsServer::listen(const QHostAddress &address, quint16 port)
+{
+    if (!m_tcpServer) {
+        m_tcpServer = new QTcpServer(this);
+        connect(m_tcpServer, &QTcpServer::newConnection, this, [this]() {
+            while (m_tcpServer->hasPendingConnections()) {
+                acceptConnection(m_tcpServer->nextPendingConnection());
+            }
+        });
+    }
+    if (!m_tcpServer->listen(address, port)) {
+        m_errorString = m_tcpServer->errorString();
+        return false;
+    }
+    return true;
+}
+
+bool MetricsServer::listenLocal(const QString &path)
+{
+    if (!m_localServer) {
+        m_localServer = new QLocalServer(this);
+        connect(m_localServer, &QLocalServer::newConnection, this, [this]() {
+            while (m_localServer->hasPendingConnections()) {
+                acceptConnection(m_localServer->nextPendingConnection());
+            }
+        });
+    }
+    QLocalServer::removeServer(path);
+    if (!m_localServer->listen(path)) {
+        m_errorString = m_localServer->errorString();
+        return false;
+    }
+    return true;
+}
+
+void MetricsServer::updateSnapshot()
+{
+    // Render into the buffers not being served; connections still writing
+    // the previous payload hold their own reference to it
+    const int next = m_current == 0 ? 1 : 0;
+    QByteArray &body = m_bodies[next];
+    render(m_monitor->snapshot(), body);
+
+    // Without the blank line, so respond() can add Connection: close
+    QByteArray &header = m_headers[next];
+    header.reserve(header.capacity());
+    header.resize(0);
+    header += "HTTP/1.1 200 OK\r\nContent-Type: ";
+    header += kContentType;
+    header += "\r\nContent-Length: ";
+    header += QByteArray::number(body.size());
+    header += "\r\n";
+    m_current = next;
+}
+
+// Closes without waiting for queued data to be sent
+// Whether the Connection header of a request head lists option, which is
+// lower case; names and values are compared case-insensitively and may be
+// padded with whitespace
+static bool hasConnectionOption(const QByteArray &head, const QByteArray &option)
+{
+    const QList<QByteArray> lines = head.split('\n');
+    // The first line is the request line
+    for (int i = 1; i < lines.size(); ++i) {
+        const QByteArray &line = lines[i];
+        const int colon = line.indexOf(':');
+        if (colon < 0 || line.left(colon).trimmed().toLower() != "connection") {
+            continue;
+        }
+        for (const QByteArray &value : line.mid(colon + 1).split(',')) {
+            if (value.trimmed().toLower() == option) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void abortConnection(QIODevice *connection)
+{
+    if (QTcpSocket *socket = qobject_cast<QTcpSocket *>(connection)) {
+        socket->abort();
+    } else if (QLocalSocket *socket = qobject_cast<QLocalSocket *>(connection)) {
+        socket->abort();
+    }
+}
+
+void MetricsServer::acceptConnection(QIODevice *connection)
+{
+    if (m_connections.size() >= kMaxConnections) {
+        abortConnection(connection);
+        connection->deleteLater();
+        return;
+    }
+    m_connections[connection].lastActiveMs = m_clock.elapsed();
+    if (!m_idleTimer->isActive()) {
+        m_idleTimer->start();
+    }
+
+    connect(connection, &QIODevice::readyRead, this, [this, connection]() {
+        readRequests(connection);
+    });
+    // A scraper reading a large body slowly is not idle
+    connect(connection, &QIODevice::bytesWritten, this, [this, connection]() {
+        auto it = m_connections.find(connection);
+        if (it != m_connections.end()) {
+            it->lastActiveMs = m_clock.elapsed();
+        }
+    });
+    auto forget = [this, connection]() {
+        m_connections.remove(connection);
+        if (m_connections.isEmpty()) {
+            m_idleTimer->stop();
+        }
+        connection->deleteLater();
+    };
+    if (QTcpSocket *socket = qobject_cast<QTcpSocket *>(connection)) {
+        connect(socket, &QAbstractSocket::disconnected, this, forget);
+    } else if (QLocalSocket *socket = qobject_cast<QLocalSocket *>(connection)) {
+        connect(socket, &QLocalSocket::disconnected, this, forget);
+    }
+}
+
+void MetricsServer::readRequests(QIODevice *connection)
+{
+    auto it = m_connections.find(connection);
+    if (it == m_connections.end() || it->closing) {
+        connection->readAll();
+        return;
+    }
+    it->lastActiveMs = m_clock.elapsed();
+    QByteArray &pending = it->pending;
+    pending += connection->readAll();
+
+    int end;
+    while ((end = pending.indexOf("\r\n\r\n")) >= 0) {
+        const QByteArray head = pending.left(end).toLower();
+        pending.remove(0, end + 4);
+
+        const int lineEnd = head.indexOf("\r\n");
+        const QByteArray requestLine = lineEnd < 0 ? head : head.left(lineEnd);
+        // HTTP/1.1 keeps the connection unless told to close, HTTP/1.0 the reverse
+        const bool keepAlive = requestLine.endsWith("http/1.1")
+            ? !hasConnectionOption(head, "close")
+            : hasConnectionOption(head, "keep-alive");
+        if (!respond(connection, requestLine, keepAlive)) {
+            closeConnection(connection);
+            return;
+        }
+    }
+    if (pending.size() > kMaxRequestSize) {
+        connection->write("HTTP/1.1 431 Request Header Fields Too Large\r\n"
+                          "Content-Length: 0\r\nConnection: close\r\n\r\n");
+        closeConnection(connection);
+    }
+}
+
+bool MetricsServer::respond(QIODevice *connection, const QByteArray &requestLine, bool keepAlive)
+{
+    const QList<QByteArray> request = requestLine.split(' ');
+    const QByteArray method = request.value(0);
+    QByteArray path = request.value(1);
+    const int query = path.indexOf('?');
+    if (query >= 0) {
+        path.truncate(query);
+    }
+
+    if (method != "get" && method != "head") {
+        connection->write("HTTP/1.1 405 Method Not Allowed\r\nAllow: GET, HEAD\r\n"
+                          "Content-Length: 0\r\nConnection: close\r\n\r\n");
+        return false;
+    }
+    const bool found = path == "/metrics" || path == "/";
+    if (!found) {
+        connection->write("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n");
+    } else if (m_current < 0) {
+        // Nothing sampled yet
+        connection->write("HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\nContent-Length: 0\r\n");
+    } else {
+        connection->write(m_headers[m_current]);
+    }
+    connection->write(keepAlive ? "\r\n" : "Connection: close\r\n\r\n");
+    if (found && m_current >= 0 && method == "get") {
+        connection->write(m_bodies[m_current]);
+    }
+    return keepAlive;
+}
+
+void MetricsServer::closeConnection(QIODevice *connection)
+{
+    // Both flush what is queued before disconnecting; the connection
+    // stays listed until it is gone, so it still counts and can time out
+    auto it = m_connections.find(connection);
+    if (it != m_connections.end()) {
+        it->closing = true;
+        it->pending.clear();
+    }
+    if (QTcpSocket *socket = qobject_cast<QTcpSocket *>(connection)) {
+        socket->disconnectFromHost();
+    } else if (QLocalSocket *socket = qobject_cast<QLocalSocket *>(connection)) {
+        socket->disconnectFromServer();
+    }
+}
+
+void MetricsServer::dropIdleConnections()
+{
+    const qint64 now = m_clock.elapsed();
+    QVector<QIODevice *> idle;
+    for (auto it = m_connections.cbegin(); it != m_connections.cend(); ++it) {
+        if (now - it->lastActiveMs >= kIdleTimeoutMs) {
+            idle.append(it.key());
+        }
+    }
+    for (QIODevice *connection : idle) {
+        abortConnection(connection);
+        // Already forgotten if aborting emitted disconnected
+        if (m_connections.remove(connection)) {
+            connection->deleteLater();
+        }
+    }
+    if (m_connections.isEmpty()) {
+        m_idleTimer->stop();
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QObject>
+#include <QString>
+
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+class QTimer;
+class SystemMonitor;
+struct SystemSnapshot;
+
+/**
+ * @brief Serves the latest snapshot over HTTP in OpenMetrics text format
+ *
+ * GET /metrics on a TCP port, a local socket, or both. The exposition
+ * is rendered once per published snapshot, alternating between two
+ * buffers so the one being rendered is never the one being sent. A
+ * request only writes the prebuilt header and body, so a scrape costs
+ * the same whatever the number of series. Keep-alive connections are
+ * supported, up to a fixed number at once; a connection that neither
+ * sends nor receives anything for a while is dropped.
+ *
+ * Exported: per-core and total CPU usage and modes, memory and paging,
+ * per-interface traffic, per-device disk I/O, filesystem space and the
+ * busiest processes by CPU, memory and I/O. Each metric has a fixed
+ * label set.
+ *
+ * The headless runner and the GUI both create one through startMetrics()
+ * when --metrics-port or --metrics-socket is given.
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetricsServer(const SystemMonitor *monitor, QObject *parent = nullptr);
+
+    bool listen(const QHostAddress &address, quint16 port);
+    // Removes a stale socket file left at path by an earlier run first
+    bool listenLocal(const QString &path);
+    QString errorString() const { return m_errorString; }
+
+    // Renders the exposition for snapshot into out, replacing its contents
+    static void render(const SystemSnapshot &snapshot, QByteArray &out);
+
+public slots:
+    // Connected to SystemMonitor::dataUpdated
+    void updateSnapshot();
+
+private:
+    void acceptConnection(QIODevice *connection);
+    void readRequests(QIODevice *connection);
+    // Answers one request; false when the connection should be closed
+    bool respond(QIODevice *connection, const QByteArray &requestLine, bool keepAlive);
+    void closeConnection(QIODevice *connection);
+    void dropIdleConnections();
+
+    const SystemMonitor *m_monitor;
+    QTcpServer *m_tcpServer = nullptr;
+    QLocalServer *m_localServer = nullptr;
+    QString m_errorString;
+    // Response headers and bodies; m_current is the one being served
+    QByteArray m_headers[2];
+    QByteArray m_bodies[2];
+    int m_current = -1;
+    struct Connection {
+        QByteArray pending; // request bytes received but not yet answered
+        qint64 lastActiveMs = 0;
+        bool closing = false;
+    };
+    QHash<QIODevice *, Connection> m_connections;
+    QElapsedTimer m_clock;
+    // Runs while there are connections
+    QTimer *m_idleTimer = nullptr;
+};
+
+#endif // METRICSSERVER_H
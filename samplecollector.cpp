@@ -0,0 +1,517 @@
+#include "samplecollector.h"
+#include "utils/instrumentation.h"
+#include "utils/proccapture.h"
+#include "utils/topk.h"
+#include <QDateTime>
+#include <QDebug>
+#include <utility>
+
+// Default periods of the expensive families, in ms
+static constexpr int kProcessPeriodMs = 2000;
+static constexpr int kDiskPeriodMs = 30000;
+static constexpr int kProcessDetailPeriodMs = 5000;
+// Processes with a series of their own, from the top of the CPU ranking
+static constexpr int kRecordedProcessCount = 10;
+// Keys whose series names are kept; past that the cache starts over, so
+// names of departed processes and devices do not pile up
+static constexpr int kMaxSeriesNameKeys = 1024;
+// How often a writer with no visible views checks for new ring viewers
+static constexpr int kViewerPollMs = 250;
+
+// The series names "<family>.<key>.<metric>" for each of metrics, built
+// the first time key is seen
+template<typename Key>
+static const QVector<QString> &seriesNames(QHash<Key, QVector<QString>> &cache, const Key &key,
+                                           const char *family, std::initializer_list<const char *> metrics)
+{
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        if (cache.size() >= kMaxSeriesNameKeys) {
+            cache.clear();
+        }
+        QVector<QString> names;
+        for (const char *metric : metrics) {
+            names.append(QString("%1.%2.%3").arg(QString::fromLatin1(family)).arg(key).arg(QString::fromLatin1(metric)));
+        }
+        it = cache.insert(key, names);
+    }
+    return it.value();
+}
+
+// Sums the interfaces; the busiest one names the total
+static NetworkStats networkTotals(const QVector<InterfaceStats> &interfaces)
+{
+    NetworkStats stats = {};
+    double busiest = -1.0;
+    for (const InterfaceStats &iface : interfaces) {
+        stats.bytesReceived += static_cast<qint64>(iface.rxBytes);
+        stats.bytesSent += static_cast<qint64>(iface.txBytes);
+        stats.downloadSpeedKBps += iface.rxBytesPerSec / 1024.0;
+        stats.uploadSpeedKBps += iface.txBytesPerSec / 1024.0;
+        const double rate = iface.rxBytesPerSec + iface.txBytesPerSec;
+        if (iface.up && rate > busiest) {
+            busiest = rate;
+            stats.interfaceName = iface.name;
+        }
+    }
+    return stats;
+}
+
+HistoryRecord SampleCollector::historyRecord(MetricFamily family, const SystemSnapshot &snapshot)
+{
+    HistoryRecord record = {};
+    record.timestampMs = snapshot.timestampMs;
+    float *values = record.values;
+    switch (family) {
+    case CpuFamily: {
+        const CpuCoreUsage &total = snapshot.cpu.total;
+        values[CpuUsageChannel] = float(total.usage);
+        values[CpuUserChannel] = float(total.user);
+        values[CpuSystemChannel] = float(total.system);
+        values[CpuIowaitChannel] = float(total.iowait);
+        values[CpuIrqChannel] = float(total.irq);
+        values[CpuStealChannel] = float(total.steal);
+        for (const CpuCoreUsage &core : snapshot.cpu.cores) {
+            values[CpuHottestCoreChannel] = qMax(values[CpuHottestCoreChannel], float(core.usage));
+        }
+        break;
+    }
+    case MemoryFamily: {
+        const MemoryInfo &memory = snapshot.memory;
+        values[MemoryUsageChannel] = float(memory.usagePercentage);
+        values[MemoryUsedChannel] = float(memory.usedPhysical);
+        values[MemoryAvailableChannel] = float(memory.availablePhysical);
+        values[MemoryCachedChannel] = float(memory.cached);
+        values[MemorySwapUsedChannel] = float(memory.totalVirtual - memory.availableVirtual);
+        values[MemorySwapPagesChannel] = float(memory.swapInPagesPerSec + memory.swapOutPagesPerSec);
+        values[MemoryMajorFaultsChannel] = float(memory.majorFaultsPerSec);
+        break;
+    }
+    case NetworkFamily:
+        for (const InterfaceStats &iface : snapshot.interfaces) {
+            values[NetworkRxBytesChannel] += float(iface.rxBytesPerSec);
+            values[NetworkTxBytesChannel] += float(iface.txBytesPerSec);
+            values[NetworkRxPacketsChannel] += float(iface.rxPacketsPerSec);
+            values[NetworkTxPacketsChannel] += float(iface.txPacketsPerSec);
+            values[NetworkDropsChannel] += float(iface.rxDropsPerSec + iface.txDropsPerSec);
+            values[NetworkErrorsChannel] += float(iface.rxErrorsPerSec + iface.txErrorsPerSec);
+        }
+        break;
+    case DiskIoFamily:
+        for (const DiskIoStats &disk : snapshot.diskIo) {
+            values[DiskReadBytesChannel] += float(disk.readBytesPerSec);
+            values[DiskWriteBytesChannel] += float(disk.writeBytesPerSec);
+            values[DiskReadIopsChannel] += float(disk.readIops);
+            values[DiskWriteIopsChannel] += float(disk.writeIops);
+            // The slowest and busiest disk stand for the whole host
+            values[DiskLatencyChannel] = qMax(values[DiskLatencyChannel], float(disk.avgLatencyMs));
+            values[DiskQueueDepthChannel] += float(disk.avgQueueDepth);
+            values[DiskUtilizationChannel] = qMax(values[DiskUtilizationChannel], float(disk.utilization));
+        }
+        break;
+    default:
+        break;
+    }
+    return record;
+}
+
+SampleCollector::SampleCollector(TripleBuffer<SystemSnapshot> *buffer, HistoryStore *history,
+                                 MetricHistory *recent, SharedSnapshotRing *shared,
+                                 QObject *parent)
+    : QObject{parent}
+    , m_buffer(buffer)
+    , m_history(history)
+    , m_recent(recent)
+    , m_rollupStore(nullptr)
+    , m_shared(shared)
+    , m_timer(new QTimer(this))
+    , m_viewerPoll(new QTimer(this))
+    , m_viewerGeneration(0)
+    , m_viewsVisible(true)
+    , m_lastCpuNs(0)
+{
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &SampleCollector::onWakeup);
+    m_viewerPoll->setInterval(kViewerPollMs);
+    connect(m_viewerPoll, &QTimer::timeout, this, &SampleCollector::onViewerPoll);
+    m_clock.start();
+}
+
+void SampleCollector::start(int intervalMs)
+{
+    // Cheap counters follow the requested interval, the process table and
+    // disk capacity never run faster than their own defaults
+    m_policy.setBasePeriod(CpuFamily, intervalMs);
+    m_policy.setBasePeriod(MemoryFamily, intervalMs);
+    m_policy.setBasePeriod(NetworkFamily, intervalMs);
+    m_policy.setBasePeriod(DiskIoFamily, intervalMs);
+    m_policy.setBasePeriod(ProcessFamily, qMax(intervalMs, kProcessPeriodMs));
+    m_policy.setBasePeriod(DiskFamily, qMax(intervalMs, kDiskPeriodMs));
+    m_policy.setBasePeriod(ProcessDetailFamily, qMax(intervalMs, kProcessDetailPeriodMs));
+
+    if (ProcCapture::isReplaying()) {
+        // Replay reproduces the recorded frames, whatever the policy says
+        for (int family = 0; family < MetricFamilyCount; ++family) {
+            const MetricFamily metric = static_cast<MetricFamily>(family);
+            m_scheduler.setPeriod(metric, m_policy.basePeriod(metric));
+        }
+        m_replayClock.invalidate();
+        replayNext();
+        return;
+    }
+
+    startRollups();
+    // Get initial data for every family, then follow the schedule; paused
+    // families are left out until they resume
+    applyPolicy();
+    m_scheduler.reset(m_clock.elapsed());
+    m_costClock.start();
+    m_lastCpuNs = Instrumentation::processCpuNs();
+    onWakeup();
+}
+
+void SampleCollector::stop()
+{
+    m_timer->stop();
+    m_viewerPoll->stop();
+}
+
+void SampleCollector::setPeriod(MetricFamily family, int periodMs)
+{
+    m_policy.setBasePeriod(family, periodMs);
+    if (ProcCapture::isReplaying()) {
+        m_scheduler.setPeriod(family, periodMs);
+    } else if (m_timer->isActive()) {
+        applyPolicy();
+        scheduleNext();
+    }
+}
+
+void SampleCollector::setViewsVisible(bool visible)
+{
+    if (m_viewsVisible == visible) {
+        return;
+    }
+    m_viewsVisible = visible;
+    if (!visible || !m_timer->isActive() || ProcCapture::isReplaying()) {
+        return;
+    }
+    // Views coming back get current data straight away, not whatever the
+    // slowed-down schedule last produced
+    m_policy.setVisible(true);
+    applyPolicy();
+    m_scheduler.reset(m_clock.elapsed());
+    onWakeup();
+}
+
+void SampleCollector::setCpuBudget(double percent)
+{
+    m_policy.setCpuBudget(percent);
+}
+
+void SampleCollector::setWatchedProcesses(const QVector<quint32> &pids)
+{
+    m_watched = pids;
+    // Rows that scroll into view should not wait a whole detail period;
+    // cached details of the rows already shown are reused as they are
+    if (m_timer->isActive() && !ProcCapture::isReplaying() && m_policy.period(ProcessDetailFamily) > 0) {
+        collect(familyBit(ProcessDetailFamily));
+    }
+}
+
+void SampleCollector::setRollupStore(RollupStore *store)
+{
+    m_rollupStore = store;
+}
+
+void SampleCollector::startRollups()
+{
+    if (m_rollups || !m_history || !m_rollupStore || !m_rollupStore->isWritable()) {
+        return;
+    }
+    // Buckets closed by earlier runs are in the store; the raw history
+    // fills in the ones still open
+    m_rollups.reset(new RollupEngine);
+    m_rollups->persistTo(m_rollupStore);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QVector<HistoryRecord> records;
+    for (int family = 0; family < MetricFamilyCount; ++family) {
+        const MetricFamily metric = static_cast<MetricFamily>(family);
+        if (HistoryStore::isRecorded(metric)) {
+            records.resize(0);
+            m_history->query(metric, 0, now, records);
+            m_rollups->backfill(metric, records);
+        }
+    }
+}
+
+void SampleCollector::setRecentHistory(MetricHistory *recent)
+{
+    m_recent = recent;
+    m_recordedPids.resize(0);
+    m_processSeries.clear();
+}
+
+void SampleCollector::onWakeup()
+{
+    if (ProcCapture::isReplaying()) {
+        replayNext();
+        return;
+    }
+    const MetricFamilies due = m_scheduler.takeDue(m_clock.elapsed());
+    if (due) {
+        collect(due);
+        updatePolicy();
+    }
+    scheduleNext();
+}
+
+void SampleCollector::onViewerPoll()
+{
+    const quint32 generation = m_shared->viewerGeneration();
+    if (generation == m_viewerGeneration || !m_timer->isActive()) {
+        return;
+    }
+    m_viewerGeneration = generation;
+    // A reader started viewing; collect now instead of at the next,
+    // possibly much later, wakeup
+    updatePolicy();
+    if (m_policy.isVisible()) {
+        onWakeup();
+    }
+}
+
+void SampleCollector::scheduleNext()
+{
+    m_timer->start(static_cast<int>(m_scheduler.msUntilNext(m_clock.elapsed())));
+}
+
+void SampleCollector::applyPolicy()
+{
+    for (int family = 0; family < MetricFamilyCount; ++family) {
+        const MetricFamily metric = static_cast<MetricFamily>(family);
+        m_scheduler.setPeriod(metric, m_policy.period(metric));
+    }
+}
+
+void SampleCollector::updatePolicy()
+{
+    // Read before the viewers, so a reader that starts viewing after the
+    // check below still changes it
+    const quint32 viewerGeneration = m_shared ? m_shared->viewerGeneration() : 0;
+    // Readers of the shared ring count as views too
+    const bool visible = m_viewsVisible || (m_shared && m_shared->hasViewers());
+    const bool wasVisible = m_policy.isVisible();
+    m_policy.setVisible(visible);
+    if (m_current.updatedFamilies & familyBit(CpuFamily)) {
+        m_policy.addHostCpuUsage(m_current.cpu.total.usage);
+    }
+    const qint64 cpuNs = Instrumentation::processCpuNs();
+    m_policy.addCost(cpuNs - m_lastCpuNs, m_costClock.nsecsElapsed());
+    m_costClock.restart();
+    m_lastCpuNs = cpuNs;
+    applyPolicy();
+    if (visible && !wasVisible) {
+        // A shared-ring viewer appeared; resumed families are already due
+        m_scheduler.reset(m_clock.elapsed());
+    }
+    if (!visible && m_shared && m_shared->role() == SharedSnapshotRing::Writer) {
+        m_viewerGeneration = viewerGeneration;
+        if (!m_viewerPoll->isActive()) {
+            m_viewerPoll->start();
+        }
+    } else {
+        m_viewerPoll->stop();
+    }
+}
+
+void SampleCollector::replayNext()
+{
+    MetricFamilies families = 0;
+    if (!ProcCapture::nextFrame(families)) {
+        ProcCapture::stop();
+        emit replayFinished();
+        return;
+    }
+    if (!m_replayClock.isValid()) {
+        m_replayClock.start();
+    }
+    collect(families);
+    const qint64 dueMs = ProcCapture::nextFrameOffsetMs();
+    m_timer->start(static_cast<int>(qMax<qint64>(0, dueMs - m_replayClock.elapsed())));
+}
+
+void SampleCollector::collect(MetricFamilies families)
+{
+    Instrumentation::Scope pass(Instrumentation::CollectProbe);
+    SystemSnapshot &snapshot = m_current;
+    snapshot.timestampMs = ProcCapture::isReplaying() ? ProcCapture::frameWallMs()
+                                                      : QDateTime::currentMSecsSinceEpoch();
+    snapshot.updatedFamilies = families;
+    if (ProcCapture::isRecording()) {
+        ProcCapture::beginFrame(snapshot.timestampMs, families);
+    }
+
+    // CPU usage (aggregate and per core)
+    if (families & familyBit(CpuFamily)) {
+        Instrumentation::Scope scope(Instrumentation::CpuProbe);
+        snapshot.cpu = SystemInfo::getCpuInfo();
+    }
+
+    // Memory info
+    if (families & familyBit(MemoryFamily)) {
+        Instrumentation::Scope scope(Instrumentation::MemoryProbe);
+        snapshot.memory = SystemInfo::getMemoryInfo();
+    }
+
+    // Disk info
+    if (families & familyBit(DiskFamily)) {
+        Instrumentation::Scope scope(Instrumentation::DiskProbe);
+        snapshot.disks = SystemInfo::getDiskInfo();
+    }
+
+    // Disk throughput, IOPS and latency
+    if (families & familyBit(DiskIoFamily)) {
+        Instrumentation::Scope scope(Instrumentation::DiskIoProbe);
+        snapshot.diskIo = SystemInfo::getDiskIoStats();
+    }
+
+    // Per-interface network rates, and their totals
+    if (families & familyBit(NetworkFamily)) {
+        Instrumentation::Scope scope(Instrumentation::InterfaceProbe);
+        snapshot.interfaces = SystemInfo::getInterfaceStats();
+        snapshot.network = networkTotals(snapshot.interfaces);
+    }
+
+    // Process rankings, all selected in one pass over the process list
+    if (families & familyBit(ProcessFamily)) {
+        {
+            Instrumentation::Scope scope(Instrumentation::ProcessProbe);
+            m_processes = SystemInfo::getProcesses();
+        }
+        snapshot.processes = m_processes;
+        Instrumentation::Scope scope(Instrumentation::RankProbe);
+        rankProcesses(m_processes, kRankedProcessCount, snapshot.topProcesses);
+    }
+
+    // Detail fields of the watched processes. Cached details are reused
+    // for half a period: a scheduled pass, which may come up to the
+    // scheduler's slack early, always re-reads them, while a pass for a
+    // changed watch list only reads the new PIDs
+    if (families & familyBit(ProcessDetailFamily)) {
+        Instrumentation::Scope scope(Instrumentation::ProcessDetailProbe);
+        snapshot.processDetails = SystemInfo::getProcessDetails(m_watched, m_scheduler.period(ProcessDetailFamily) / 2);
+    }
+
+    if (ProcCapture::isRecording()) {
+        ProcCapture::endFrame();
+    }
+
+    recordHistory(families);
+    recordSeries(families);
+
+    // Families that were not due keep their previous values; copying only
+    // bumps the reference counts of the shared containers
+    m_buffer->back() = snapshot;
+    m_buffer->publish();
+    if (m_shared) {
+        m_shared->publish(snapshot);
+    }
+    emit snapshotPublished();
+}
+
+void SampleCollector::recordHistory(MetricFamilies families)
+{
+    if (!m_history) {
+        return;
+    }
+    for (int family = 0; family < MetricFamilyCount; ++family) {
+        const MetricFamily metric = static_cast<MetricFamily>(family);
+        if ((families & familyBit(metric)) && HistoryStore::isRecorded(metric)) {
+            const HistoryRecord record = historyRecord(metric, m_current);
+            m_history->append(metric, record);
+            if (m_rollups) {
+                m_rollups->append(metric, record);
+            }
+        }
+    }
+}
+
+void SampleCollector::recordSeries(MetricFamilies families)
+{
+    if (!m_recent) {
+        return;
+    }
+    QVector<MetricSample> &samples = m_samples;
+    samples.resize(0);
+    const SystemSnapshot &snapshot = m_current;
+
+    if (families & familyBit(CpuFamily)) {
+        samples.append({QStringLiteral("cpu.total"), snapshot.cpu.total.usage});
+        samples.append({QStringLiteral("cpu.iowait"), snapshot.cpu.total.iowait});
+        samples.append({QStringLiteral("cpu.steal"), snapshot.cpu.total.steal});
+        // Core names never change, build them once
+        while (m_coreSeries.size() < snapshot.cpu.cores.size()) {
+            m_coreSeries.append(QString("cpu.core%1").arg(m_coreSeries.size()));
+        }
+        for (int i = 0; i < snapshot.cpu.cores.size(); ++i) {
+            samples.append({m_coreSeries.at(i), snapshot.cpu.cores.at(i).usage});
+        }
+    }
+    if (families & familyBit(MemoryFamily)) {
+        const MemoryInfo &memory = snapshot.memory;
+        samples.append({QStringLiteral("memory.used"), double(memory.usedPhysical)});
+        samples.append({QStringLiteral("memory.available"), double(memory.availablePhysical)});
+        samples.append({QStringLiteral("memory.cached"), double(memory.cached)});
+        samples.append({QStringLiteral("memory.swapUsed"), double(memory.totalVirtual - memory.availableVirtual)});
+        samples.append({QStringLiteral("memory.majorFaults"), memory.majorFaultsPerSec});
+    }
+    if (families & familyBit(NetworkFamily)) {
+        for (const InterfaceStats &iface : snapshot.interfaces) {
+            const QVector<QString> &names = seriesNames(m_interfaceSeries, iface.name, "net", {"rx", "tx"});
+            samples.append({names.at(0), iface.rxBytesPerSec});
+            samples.append({names.at(1), iface.txBytesPerSec});
+        }
+    }
+    if (families & familyBit(DiskIoFamily)) {
+        for (const DiskIoStats &disk : snapshot.diskIo) {
+            const QVector<QString> &names = seriesNames(m_diskSeries, disk.name, "disk", {"read", "write", "latency"});
+            samples.append({names.at(0), disk.readBytesPerSec});
+            samples.append({names.at(1), disk.writeBytesPerSec});
+            samples.append({names.at(2), disk.avgLatencyMs});
+        }
+    }
+    if (families & familyBit(DiskFamily)) {
+        for (const DiskInfo &disk : snapshot.disks) {
+            const QVector<QString> &names = seriesNames(m_mountSeries, disk.mountPoint, "mount", {"used"});
+            samples.append({names.at(0), double(disk.usedSpace)});
+        }
+    }
+    if (families & familyBit(ProcessFamily)) {
+        const QVector<ProcessInfo> &top = snapshot.topProcesses[SortByCpu];
+        m_rankedPids.resize(0);
+        for (int i = 0; i < qMin(kRecordedProcessCount, top.size()); ++i) {
+            const ProcessInfo &process = top.at(i);
+            const QVector<QString> &names = seriesNames(m_processSeries, process.pid, "process", {"cpu", "memory"});
+            samples.append({names.at(0), process.cpuUsage});
+            samples.append({names.at(1), double(process.memoryUsage)});
+            m_rankedPids.append(process.pid);
+        }
+        // A process that exited or left the ranking has no further samples,
+        // so its series would only sit there until it aged out
+        m_finishedSeries.resize(0);
+        for (quint32 pid : std::as_const(m_recordedPids)) {
+            if (!m_rankedPids.contains(pid)) {
+                m_finishedSeries += m_processSeries.take(pid);
+            }
+        }
+        if (!m_finishedSeries.isEmpty()) {
+            m_recent->remove(m_finishedSeries);
+        }
+        m_recordedPids.swap(m_rankedPids);
+    }
+    if (!samples.isEmpty()) {
+        m_recent->append(snapshot.timestampMs, samples);
+    }
+}
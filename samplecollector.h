@@ -0,0 +1,128 @@
+#ifndef SAMPLECOLLECTOR_H
+#define SAMPLECOLLECTOR_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QScopedPointer>
+#include <QTimer>
+#include <QVector>
+#include "sharedsnapshot.h"
+#include "systemsnapshot.h"
+#include "utils/historystore.h"
+#include "utils/metrichistory.h"
+#include "utils/rollup.h"
+#include "utils/samplingpolicy.h"
+#include "utils/samplingscheduler.h"
+#include "utils/triplebuffer.h"
+
+/**
+ * @brief Runs the SystemInfo collectors on a worker thread
+ *
+ * Each metric family is sampled at its own period. On every wakeup the
+ * due families are refreshed in the collector's working snapshot, which
+ * is then copied into the back buffer of the shared triple buffer and
+ * published. The GUI thread never touches /proc; it only picks up
+ * finished snapshots. Every sampled metric is also appended to the
+ * in-memory history, and the recorded families to the on-disk history,
+ * when those are given. Snapshots also go to the shared ring when this
+ * process is its writer.
+ *
+ * The schedule follows a SamplingPolicy: expensive families slow down or
+ * pause while no view is visible, in this process or as a reader of the
+ * shared ring, and everything backs off when the monitor's own CPU time
+ * exceeds its budget. Views becoming visible get a fresh snapshot at
+ * once; while nothing is visible the writer of the shared ring polls its
+ * viewer generation every few hundred ms, so a reader that appears does
+ * not wait for the backed-off schedule.
+ *
+ * The process table is two-tiered: every scan covers every PID with the
+ * cheap fields, and the detail fields are loaded at their own, slower
+ * period for the watched PIDs only, e.g. the rows a view shows.
+ *
+ * While a ProcCapture is replaying, the capture's frames drive collection
+ * instead of the schedule, each refreshing the families it recorded.
+ */
+class SampleCollector : public QObject
+{
+    Q_OBJECT
+public:
+    SampleCollector(TripleBuffer<SystemSnapshot> *buffer, HistoryStore *history,
+                    MetricHistory *recent, SharedSnapshotRing *shared = nullptr,
+                    QObject *parent = nullptr);
+
+    // The history record of a recorded family, from the values in snapshot
+    static HistoryRecord historyRecord(MetricFamily family, const SystemSnapshot &snapshot);
+
+public slots:
+    void start(int intervalMs);
+    void stop();
+    void setPeriod(MetricFamily family, int periodMs);
+    void setViewsVisible(bool visible);
+    // Percent of one core; 0 disables the budget
+    void setCpuBudget(double percent);
+    // PIDs whose details are loaded; new ones are loaded right away
+    void setWatchedProcesses(const QVector<quint32> &pids);
+    // Where every sampled metric is appended by name; null stops it
+    void setRecentHistory(MetricHistory *recent);
+    // Where closed rollup buckets are written while the store is writable;
+    // set before start()
+    void setRollupStore(RollupStore *store);
+    void collect(MetricFamilies families);
+
+signals:
+    void snapshotPublished();
+    // The replayed capture has no frames left
+    void replayFinished();
+
+private slots:
+    void onWakeup();
+    void onViewerPoll();
+
+private:
+    void scheduleNext();
+    void applyPolicy();
+    void updatePolicy();
+    void replayNext();
+    void recordHistory(MetricFamilies families);
+    void startRollups();
+    void recordSeries(MetricFamilies families);
+
+    TripleBuffer<SystemSnapshot> *m_buffer;
+    HistoryStore *m_history;
+    MetricHistory *m_recent;
+    RollupStore *m_rollupStore;
+    // Open buckets of the stored rollups; null unless the store is writable
+    QScopedPointer<RollupEngine> m_rollups;
+    SharedSnapshotRing *m_shared;
+    QVector<MetricSample> m_samples;
+    QVector<QString> m_coreSeries;
+    // Series names by interface, device, mount point and pid
+    QHash<QString, QVector<QString>> m_interfaceSeries;
+    QHash<QString, QVector<QString>> m_diskSeries;
+    QHash<QString, QVector<QString>> m_mountSeries;
+    QHash<quint32, QVector<QString>> m_processSeries;
+    // Processes with a series, as of the latest process sample
+    QVector<quint32> m_recordedPids;
+    QVector<quint32> m_rankedPids;
+    QVector<QString> m_finishedSeries;
+    QTimer *m_timer;
+    // Runs while nothing is visible and this process writes the shared ring
+    QTimer *m_viewerPoll;
+    quint32 m_viewerGeneration;
+    QElapsedTimer m_clock;
+    // Started with the first replayed frame, to keep real-time replay
+    // from drifting
+    QElapsedTimer m_replayClock;
+    SamplingScheduler m_scheduler;
+    SamplingPolicy m_policy;
+    bool m_viewsVisible;
+    // Wall and process CPU time at the previous policy update
+    QElapsedTimer m_costClock;
+    qint64 m_lastCpuNs;
+    SystemSnapshot m_current;
+    QVector<ProcessInfo> m_processes;
+    QVector<quint32> m_watched;
+};
+
+#endif // SAMPLECOLLECTOR_H
@@ -0,0 +1,120 @@
+#include "samplewriter.h"
+#include "systemmonitor.h"
+
+// Busiest processes written per snapshot
+static constexpr int kWrittenProcessCount = 5;
+
+static void appendField(QByteArray &text, double value, int decimals)
+{
+    text += ' ';
+    text += QByteArray::number(value, 'f', decimals);
+}
+
+static void appendField(QByteArray &text, qint64 value)
+{
+    text += ' ';
+    text += QByteArray::number(value);
+}
+
+// Names may hold anything, even newlines (a process can set its comm)
+static void appendField(QByteArray &text, const QString &value)
+{
+    text += ' ';
+    for (char c : value.toUtf8()) {
+        switch (c) {
+        case ' ': text += "\\040"; break;
+        case '\t': text += "\\011"; break;
+        case '\n': text += "\\012"; break;
+        case '\\': text += "\\134"; break;
+        default: text += c; break;
+        }
+    }
+}
+
+SampleWriter::SampleWriter(const SystemMonitor *monitor, QIODevice *device, QObject *parent)
+    : QObject{parent}
+    , m_monitor(monitor)
+    , m_device(device)
+{
+}
+
+void SampleWriter::writeSnapshot()
+{
+    const SystemSnapshot &snapshot = m_monitor->snapshot();
+    const MetricFamilies families = snapshot.updatedFamilies;
+    const QByteArray timestamp = QByteArray::number(snapshot.timestampMs);
+    QByteArray &text = m_text;
+    text.resize(0);
+
+    if (families & familyBit(CpuFamily)) {
+        const CpuCoreUsage &cpu = snapshot.cpu.total;
+        text += timestamp + " cpu";
+        appendField(text, cpu.usage, 2);
+        appendField(text, cpu.user, 2);
+        appendField(text, cpu.system, 2);
+        appendField(text, cpu.iowait, 2);
+        appendField(text, cpu.irq, 2);
+        appendField(text, cpu.steal, 2);
+        text += '\n';
+    }
+    if (families & familyBit(MemoryFamily)) {
+        const MemoryInfo &memory = snapshot.memory;
+        text += timestamp + " mem";
+        appendField(text, memory.usedPhysical);
+        appendField(text, memory.availablePhysical);
+        appendField(text, memory.cached);
+        appendField(text, memory.totalVirtual - memory.availableVirtual);
+        appendField(text, memory.majorFaultsPerSec, 1);
+        text += '\n';
+    }
+    if (families & familyBit(NetworkFamily)) {
+        for (const InterfaceStats &iface : snapshot.interfaces) {
+            text += timestamp + " net";
+            appendField(text, iface.name);
+            appendField(text, iface.rxBytesPerSec, 0);
+            appendField(text, iface.txBytesPerSec, 0);
+            appendField(text, iface.rxPacketsPerSec, 0);
+            appendField(text, iface.txPacketsPerSec, 0);
+            appendField(text, iface.rxDropsPerSec + iface.txDropsPerSec, 0);
+            appendField(text, iface.rxErrorsPerSec + iface.txErrorsPerSec, 0);
+            text += '\n';
+        }
+    }
+    if (families & familyBit(DiskIoFamily)) {
+        for (const DiskIoStats &disk : snapshot.diskIo) {
+            text += timestamp + " disk";
+            appendField(text, disk.name);
+            appendField(text, disk.readBytesPerSec, 0);
+            appendField(text, disk.writeBytesPerSec, 0);
+            appendField(text, disk.readIops + disk.writeIops, 0);
+            appendField(text, disk.avgLatencyMs, 2);
+            appendField(text, disk.utilization, 1);
+            text += '\n';
+        }
+    }
+    if (families & familyBit(DiskFamily)) {
+        for (const DiskInfo &disk : snapshot.disks) {
+            text += timestamp + " mount";
+            appendField(text, disk.mountPoint);
+            appendField(text, disk.usedSpace);
+            appendField(text, disk.totalSpace);
+            text += '\n';
+        }
+    }
+    if (families & familyBit(ProcessFamily)) {
+        const QVector<ProcessInfo> &top = snapshot.topProcesses[SortByCpu];
+        for (int i = 0; i < qMin(kWrittenProcessCount, top.size()); ++i) {
+            const ProcessInfo &process = top.at(i);
+            text += timestamp + " proc";
+            appendField(text, qint64(process.pid));
+            appendField(text, process.cpuUsage, 2);
+            appendField(text, qint64(process.memoryUsage));
+            appendField(text, process.name);
+            text += '\n';
+        }
+    }
+
+    if (!text.isEmpty()) {
+        m_device->write(text);
+    }
+}
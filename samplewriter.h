@@ -0,0 +1,43 @@
+#ifndef SAMPLEWRITER_H
+#define SAMPLEWRITER_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QObject>
+
+class SystemMonitor;
+
+/**
+ * @brief Writes each snapshot as compact text lines
+ *
+ * One line per sampled item, fields separated by single spaces, only for
+ * the families refreshed in that snapshot:
+ *
+ *   <ms> cpu <usage%> <user%> <system%> <iowait%> <irq%> <steal%>
+ *   <ms> mem <used> <available> <cached> <swap used> <major faults/s>
+ *   <ms> net <interface> <rx B/s> <tx B/s> <rx pkt/s> <tx pkt/s> <drops/s> <errors/s>
+ *   <ms> disk <device> <read B/s> <write B/s> <IOPS> <latency ms> <util%>
+ *   <ms> mount <mount point> <used bytes> <total bytes>
+ *   <ms> proc <pid> <cpu%> <memory bytes> <name>
+ *
+ * <ms> is milliseconds since the epoch. In names, spaces, tabs, newlines
+ * and backslashes are written as octal escapes (\040, \011, \012, \134)
+ * as in /proc/mounts, so every field is one token and every record one
+ * line. Each snapshot goes out in a single write.
+ */
+class SampleWriter : public QObject
+{
+    Q_OBJECT
+public:
+    SampleWriter(const SystemMonitor *monitor, QIODevice *device, QObject *parent = nullptr);
+
+public slots:
+    void writeSnapshot();
+
+private:
+    const SystemMonitor *m_monitor;
+    QIODevice *m_device;
+    QByteArray m_text; // reused between snapshots
+};
+
+#endif // SAMPLEWRITER_H
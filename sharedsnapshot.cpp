@@ -0,0 +1,638 @@
+#include "sharedsnapshot.h"
+#include "systemsnapshot.h"
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr quint32 kMagic = 0x534d5348; // "SMSH"
+static constexpr quint32 kVersion = 1;
+static constexpr int kSlotCount = 4;
+static constexpr int kMaxCores = 512;
+static constexpr int kMaxDisks = 64;
+static constexpr int kMaxDiskIo = 64;
+static constexpr int kMaxInterfaces = 64;
+// How long a reader waits for a writer that has created the object but
+// not sized it yet
+static constexpr int kAttachRetries = 50;
+static constexpr int kAttachRetryUs = 10000;
+
+// Contents of the viewers object
+struct SharedViewers {
+    std::atomic<quint32> generation;
+};
+static_assert(std::atomic<quint32>::is_always_lock_free, "the generation lives in shared memory");
+
+// NUL-padded UTF-8, truncated to fit
+template<int Size>
+struct SharedText {
+    char bytes[Size];
+
+    void store(const QString &text) {
+        const QByteArray utf8 = text.toUtf8();
+        const int length = qMin(utf8.size(), Size - 1);
+        memcpy(bytes, utf8.constData(), length);
+        memset(bytes + length, 0, Size - length);
+    }
+    // Bounded, so a torn read cannot run past the field
+    QString load() const { return QString::fromUtf8(bytes, int(qstrnlen(bytes, Size))); }
+};
+
+struct SharedDisk {
+    SharedText<64> name;
+    SharedText<128> mountPoint;
+    SharedText<32> fileSystem;
+    qint64 totalSpace;
+    qint64 usedSpace;
+    qint64 availableSpace;
+    double usagePercentage;
+};
+
+struct SharedDiskIo {
+    SharedText<32> name;
+    double readBytesPerSec;
+    double writeBytesPerSec;
+    double readIops;
+    double writeIops;
+    double avgQueueDepth;
+    double avgLatencyMs;
+    double utilization;
+};
+
+struct SharedInterface {
+    SharedText<32> name;
+    qint32 index;
+    qint32 up;
+    quint64 rxBytes;
+    quint64 txBytes;
+    double rxBytesPerSec;
+    double txBytesPerSec;
+    double rxPacketsPerSec;
+    double txPacketsPerSec;
+    double rxDropsPerSec;
+    double txDropsPerSec;
+    double rxErrorsPerSec;
+    double txErrorsPerSec;
+};
+
+struct SharedNetworkTotals {
+    SharedText<32> interfaceName;
+    qint64 bytesReceived;
+    qint64 bytesSent;
+    double downloadSpeedKBps;
+    double uploadSpeedKBps;
+    qint64 sessionBytesReceived;
+    qint64 sessionBytesSent;
+};
+
+struct SharedProcess {
+    quint32 pid;
+    quint32 threads;
+    SharedText<64> name;
+    SharedText<16> status;
+    double cpuUsage;
+    qint64 memoryUsage;
+    qint64 ioBytesPerSec;
+};
+
+// SystemSnapshot with every container replaced by a bounded array
+struct SharedSnapshotData {
+    qint64 timestampMs;
+    quint32 updatedFamilies;
+    quint32 coreCount;
+    quint32 diskCount;
+    quint32 diskIoCount;
+    quint32 interfaceCount;
+    quint32 processCounts[ProcessSortKeyCount];
+    CpuCoreUsage total;
+    CpuCoreUsage cores[kMaxCores];
+    MemoryInfo memory;
+    SharedNetworkTotals network;
+    SharedDisk disks[kMaxDisks];
+    SharedDiskIo diskIo[kMaxDiskIo];
+    SharedInterface interfaces[kMaxInterfaces];
+    SharedProcess processes[ProcessSortKeyCount][kRankedProcessCount];
+};
+static_assert(std::is_trivially_copyable<SharedSnapshotData>::value, "slots are shared between processes");
+
+struct alignas(64) SharedSlot {
+    // Odd while the writer is filling data
+    std::atomic<quint64> sequence;
+    SharedSnapshotData data;
+};
+
+struct SharedSnapshotLayout {
+    quint32 magic;
+    quint32 version;
+    // Catches builds whose CpuCoreUsage or MemoryInfo differ
+    quint32 layoutSize;
+    qint32 writerPid;
+    // Snapshots ever published; the newest is in slot (published - 1) % kSlotCount
+    std::atomic<quint64> published;
+    SharedSlot ring[kSlotCount];
+};
+static_assert(std::atomic<quint64>::is_always_lock_free, "sequences live in shared memory");
+
+static void storeSnapshot(const SystemSnapshot &snapshot, SharedSnapshotData &data)
+{
+    data.timestampMs = snapshot.timestampMs;
+    data.updatedFamilies = snapshot.updatedFamilies;
+
+    data.total = snapshot.cpu.total;
+    data.coreCount = quint32(qMin(snapshot.cpu.cores.size(), kMaxCores));
+    memcpy(data.cores, snapshot.cpu.cores.constData(), data.coreCount * sizeof(CpuCoreUsage));
+    data.memory = snapshot.memory;
+
+    const NetworkStats &network = snapshot.network;
+    data.network.interfaceName.store(network.interfaceName);
+    data.network.bytesReceived = network.bytesReceived;
+    data.network.bytesSent = network.bytesSent;
+    data.network.downloadSpeedKBps = network.downloadSpeedKBps;
+    data.network.uploadSpeedKBps = network.uploadSpeedKBps;
+    data.network.sessionBytesReceived = network.sessionBytesReceived;
+    data.network.sessionBytesSent = network.sessionBytesSent;
+
+    data.diskCount = quint32(qMin(snapshot.disks.size(), kMaxDisks));
+    for (quint32 i = 0; i < data.diskCount; ++i) {
+        const DiskInfo &disk = snapshot.disks.at(i);
+        SharedDisk &shared = data.disks[i];
+        shared.name.store(disk.name);
+        shared.mountPoint.store(disk.mountPoint);
+        shared.fileSystem.store(disk.fileSystem);
+        shared.totalSpace = disk.totalSpace;
+        shared.usedSpace = disk.usedSpace;
+        shared.availableSpace = disk.availableSpace;
+        shared.usagePercentage = disk.usagePercentage;
+    }
+
+    data.diskIoCount = quint32(qMin(snapshot.diskIo.size(), kMaxDiskIo));
+    for (quint32 i = 0; i < data.diskIoCount; ++i) {
+        const DiskIoStats &disk = snapshot.diskIo.at(i);
+        SharedDiskIo &shared = data.diskIo[i];
+        shared.name.store(disk.name);
+        shared.readBytesPerSec = disk.readBytesPerSec;
+        shared.writeBytesPerSec = disk.writeBytesPerSec;
+        shared.readIops = disk.readIops;
+        shared.writeIops = disk.writeIops;
+        shared.avgQueueDepth = disk.avgQueueDepth;
+        shared.avgLatencyMs = disk.avgLatencyMs;
+        shared.utilization = disk.utilization;
+    }
+
+    data.interfaceCount = quint32(qMin(snapshot.interfaces.size(), kMaxInterfaces));
+    for (quint32 i = 0; i < data.interfaceCount; ++i) {
+        const InterfaceStats &iface = snapshot.interfaces.at(i);
+        SharedInterface &shared = data.interfaces[i];
+        shared.name.store(iface.name);
+        shared.index = iface.index;
+        shared.up = iface.up;
+        shared.rxBytes = iface.rxBytes;
+        shared.txBytes = iface.txBytes;
+        shared.rxBytesPerSec = iface.rxBytesPerSec;
+        shared.txBytesPerSec = iface.txBytesPerSec;
+        shared.rxPacketsPerSec = iface.rxPacketsPerSec;
+        shared.txPacketsPerSec = iface.txPacketsPerSec;
+        shared.rxDropsPerSec = iface.rxDropsPerSec;
+        shared.txDropsPerSec = iface.txDropsPerSec;
+        shared.rxErrorsPerSec = iface.rxErrorsPerSec;
+        shared.txErrorsPerSec = iface.txErrorsPerSec;
+    }
+
+    for (int key = 0; key < ProcessSortKeyCount; ++key) {
+        const QVector<ProcessInfo> &ranking = snapshot.topProcesses[key];
+        data.processCounts[key] = quint32(qMin(ranking.size(), kRankedProcessCount));
+        for (quint32 i = 0; i < data.processCounts[key]; ++i) {
+            const ProcessInfo &process = ranking.at(i);
+            SharedProcess &shared = data.processes[key][i];
+            shared.pid = process.pid;
+            shared.threads = quint32(qMax(0, process.threads));
+            shared.name.store(process.name);
+            shared.status.store(process.status);
+            shared.cpuUsage = process.cpuUsage;
+            shared.memoryUsage = process.memoryUsage;
+            shared.ioBytesPerSec = process.ioBytesPerSec;
+        }
+    }
+}
+
+// May run while the writer overwrites data; counts are clamped so a torn
+// read stays in bounds, and the caller discards it
+static void loadSnapshot(const SharedSnapshotData &data, SystemSnapshot &snapshot)
+{
+    snapshot.timestampMs = data.timestampMs;
+    snapshot.updatedFamilies = MetricFamilies(data.updatedFamilies);
+
+    snapshot.cpu.total = data.total;
+    const int coreCount = qMin(int(data.coreCount), kMaxCores);
+    snapshot.cpu.cores.resize(coreCount);
+    memcpy(snapshot.cpu.cores.data(), data.cores, coreCount * sizeof(CpuCoreUsage));
+    snapshot.memory = data.memory;
+
+    NetworkStats &network = snapshot.network;
+    network.interfaceName = data.network.interfaceName.load();
+    network.bytesReceived = data.network.bytesReceived;
+    network.bytesSent = data.network.bytesSent;
+    network.downloadSpeedKBps = data.network.downloadSpeedKBps;
+    network.uploadSpeedKBps = data.network.uploadSpeedKBps;
+    network.sessionBytesReceived = data.network.sessionBytesReceived;
+    network.sessionBytesSent = data.network.sessionBytesSent;
+
+    snapshot.disks.resize(qMin(int(data.diskCount), kMaxDisks));
+    for (int i = 0; i < snapshot.disks.size(); ++i) {
+        const SharedDisk &shared = data.disks[i];
+        DiskInfo &disk = snapshot.disks[i];
+        disk.name = shared.name.load();
+        disk.mountPoint = shared.mountPoint.load();
+        disk.fileSystem = shared.fileSystem.load();
+        disk.totalSpace = shared.totalSpace;
+        disk.usedSpace = shared.usedSpace;
+        disk.availableSpace = shared.availableSpace;
+        disk.usagePercentage = shared.usagePercentage;
+    }
+
+    snapshot.diskIo.resize(qMin(int(data.diskIoCount), kMaxDiskIo));
+    for (int i = 0; i < snapshot.diskIo.size(); ++i) {
+        const SharedDiskIo &shared = data.diskIo[i];
+        DiskIoStats &disk = snapshot.diskIo[i];
+        disk.name = shared.name.load();
+        disk.readBytesPerSec = shared.readBytesPerSec;
+        disk.writeBytesPerSec = shared.writeBytesPerSec;
+        disk.readIops = shared.readIops;
+        disk.writeIops = shared.writeIops;
+        disk.avgQueueDepth = shared.avgQueueDepth;
+        disk.avgLatencyMs = shared.avgLatencyMs;
+        disk.utilization = shared.utilization;
+    }
+
+    snapshot.interfaces.resize(qMin(int(data.interfaceCount), kMaxInterfaces));
+    for (int i = 0; i < snapshot.interfaces.size(); ++i) {
+        const SharedInterface &shared = data.interfaces[i];
+        InterfaceStats &iface = snapshot.interfaces[i];
+        iface.name = shared.name.load();
+        iface.index = shared.index;
+        iface.up = shared.up != 0;
+        iface.rxBytes = shared.rxBytes;
+        iface.txBytes = shared.txBytes;
+        iface.rxBytesPerSec = shared.rxBytesPerSec;
+        iface.txBytesPerSec = shared.txBytesPerSec;
+        iface.rxPacketsPerSec = shared.rxPacketsPerSec;
+        iface.txPacketsPerSec = shared.txPacketsPerSec;
+        iface.rxDropsPerSec = shared.rxDropsPerSec;
+        iface.txDropsPerSec = shared.txDropsPerSec;
+        iface.rxErrorsPerSec = shared.rxErrorsPerSec;
+        iface.txErrorsPerSec = shared.txErrorsPerSec;
+    }
+
+    for (int key = 0; key < ProcessSortKeyCount; ++key) {
+        QVector<ProcessInfo> &ranking = snapshot.topProcesses[key];
+        ranking.resize(qMin(int(data.processCounts[key]), kRankedProcessCount));
+        for (int i = 0; i < ranking.size(); ++i) {
+            const SharedProcess &shared = data.processes[key][i];
+            ProcessInfo &process = ranking[i];
+            process.pid = shared.pid;
+            process.threads = int(shared.threads);
+            process.name = shared.name.load();
+            process.status = shared.status.load();
+            process.cpuUsage = shared.cpuUsage;
+            process.memoryUsage = shared.memoryUsage;
+            process.ioBytesPerSec = shared.ioBytesPerSec;
+        }
+    }
+}
+
+SharedSnapshotRing::SharedSnapshotRing()
+    : m_fd(-1)
+    , m_viewersFd(-1)
+    , m_viewers(nullptr)
+    , m_viewing(false)
+    , m_layout(nullptr)
+    , m_role(Detached)
+    , m_lastRead(0)
+{
+}
+
+SharedSnapshotRing::~SharedSnapshotRing()
+{
+    detach();
+}
+
+QString SharedSnapshotRing::defaultName()
+{
+#ifdef Q_OS_UNIX
+    // One collector per user, like the history directory it writes to
+    return QStringLiteral("/systemmonitor-snapshots-%1").arg(::getuid());
+#else
+    return QStringLiteral("/systemmonitor-snapshots");
+#endif
+}
+
+SharedSnapshotRing::Role SharedSnapshotRing::attach(const QString &name)
+{
+    detach();
+    if (attachWriter(name)) {
+        m_role = Writer;
+    } else if (attachReader(name)) {
+        m_role = Reader;
+        // Nobody holds the ring, yet it cannot be written here, e.g. it
+        // was left behind with other permissions: collect without it
+        // rather than wait for a writer that never comes
+        if (!hasWriter()) {
+            detach();
+        }
+    }
+    if (m_role != Detached) {
+        openViewers(name);
+    }
+    return m_role;
+}
+
+#ifdef Q_OS_UNIX
+
+bool SharedSnapshotRing::attachWriter(const QString &name)
+{
+    const QByteArray path = name.toLocal8Bit();
+    const int fd = ::shm_open(path.constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    // Held until detach(), or until the process dies
+    if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (::ftruncate(fd, sizeof(SharedSnapshotLayout)) != 0) {
+        ::close(fd);
+        return false;
+    }
+    void *mapping = ::mmap(nullptr, sizeof(SharedSnapshotLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    m_fd = fd;
+    m_layout = static_cast<SharedSnapshotLayout *>(mapping);
+
+    // A ring left by an earlier writer keeps its published count, so
+    // readers still attached to it never see the count go backwards
+    if (m_layout->magic != kMagic || m_layout->version != kVersion ||
+        m_layout->layoutSize != sizeof(SharedSnapshotLayout)) {
+        memset(static_cast<void *>(m_layout), 0, sizeof(SharedSnapshotLayout));
+        m_layout->magic = kMagic;
+        m_layout->version = kVersion;
+        m_layout->layoutSize = sizeof(SharedSnapshotLayout);
+    }
+    m_layout->writerPid = qint32(::getpid());
+    return true;
+}
+
+bool SharedSnapshotRing::attachReader(const QString &name)
+{
+    const QByteArray path = name.toLocal8Bit();
+    const int fd = ::shm_open(path.constData(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    // A writer between shm_open() and ftruncate() already holds its lock;
+    // wait for it to size the object instead of taking it for no ring
+    struct stat status;
+    for (int attempt = 0;; ++attempt) {
+        if (::fstat(fd, &status) != 0) {
+            ::close(fd);
+            return false;
+        }
+        if (status.st_size == qint64(sizeof(SharedSnapshotLayout))) {
+            break;
+        }
+        const bool writerLocked = ::flock(fd, LOCK_SH | LOCK_NB) != 0;
+        if (!writerLocked) {
+            ::flock(fd, LOCK_UN);
+        }
+        if (!writerLocked || attempt == kAttachRetries) {
+            ::close(fd);
+            return false;
+        }
+        ::usleep(kAttachRetryUs);
+    }
+    void *mapping = ::mmap(nullptr, sizeof(SharedSnapshotLayout), PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    const SharedSnapshotLayout *layout = static_cast<const SharedSnapshotLayout *>(mapping);
+    if (layout->magic != kMagic || layout->version != kVersion ||
+        layout->layoutSize != sizeof(SharedSnapshotLayout)) {
+        ::munmap(mapping, sizeof(SharedSnapshotLayout));
+        ::close(fd);
+        return false;
+    }
+    m_fd = fd;
+    m_layout = static_cast<SharedSnapshotLayout *>(mapping);
+    m_lastRead = 0;
+    return true;
+}
+
+void SharedSnapshotRing::openViewers(const QString &name)
+{
+    const QByteArray path = (name + ".viewers").toLocal8Bit();
+    if (m_role == Writer) {
+        m_viewersFd = ::shm_open(path.constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        struct stat status;
+        if (m_viewersFd >= 0 && ::fstat(m_viewersFd, &status) == 0 &&
+            status.st_size < off_t(sizeof(SharedViewers))) {
+            if (::ftruncate(m_viewersFd, sizeof(SharedViewers)) != 0) {
+                return;
+            }
+        }
+        mapViewers();
+    } else {
+        // Readers write the generation too
+        m_viewersFd = ::shm_open(path.constData(), O_RDWR | O_CLOEXEC, 0);
+        setViewing(m_viewing);
+    }
+}
+
+// A reader may get there before the writer has sized the object; it
+// tries again the next time it starts viewing
+void SharedSnapshotRing::mapViewers()
+{
+    struct stat status;
+    if (m_viewers || m_viewersFd < 0 || ::fstat(m_viewersFd, &status) != 0 ||
+        status.st_size < off_t(sizeof(SharedViewers))) {
+        return;
+    }
+    void *mapping = ::mmap(nullptr, sizeof(SharedViewers), PROT_READ | PROT_WRITE, MAP_SHARED, m_viewersFd, 0);
+    if (mapping != MAP_FAILED) {
+        m_viewers = static_cast<SharedViewers *>(mapping);
+    }
+}
+
+void SharedSnapshotRing::setViewing(bool viewing)
+{
+    m_viewing = viewing;
+    if (m_role == Reader && m_viewersFd >= 0) {
+        ::flock(m_viewersFd, viewing ? LOCK_SH : LOCK_UN);
+        if (viewing) {
+            mapViewers();
+            if (m_viewers) {
+                m_viewers->generation.fetch_add(1, std::memory_order_release);
+            }
+        }
+    }
+}
+
+quint32 SharedSnapshotRing::viewerGeneration() const
+{
+    if (m_role != Writer || !m_viewers) {
+        return 0;
+    }
+    return m_viewers->generation.load(std::memory_order_acquire);
+}
+
+bool SharedSnapshotRing::hasViewers() const
+{
+    if (m_role != Writer || m_viewersFd < 0) {
+        return false;
+    }
+    // Only fails while some reader holds its shared lock
+    if (::flock(m_viewersFd, LOCK_EX | LOCK_NB) == 0) {
+        ::flock(m_viewersFd, LOCK_UN);
+        return false;
+    }
+    return errno == EWOULDBLOCK;
+}
+
+void SharedSnapshotRing::detach()
+{
+    if (m_viewers) {
+        ::munmap(m_viewers, sizeof(SharedViewers));
+        m_viewers = nullptr;
+    }
+    if (m_viewersFd >= 0) {
+        // Also drops this viewer's lock
+        ::close(m_viewersFd);
+        m_viewersFd = -1;
+    }
+    if (m_layout) {
+        ::munmap(m_layout, sizeof(SharedSnapshotLayout));
+        m_layout = nullptr;
+    }
+    if (m_fd >= 0) {
+        // Also releases the writer's lock
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_role = Detached;
+}
+
+bool SharedSnapshotRing::hasWriter() const
+{
+    if (m_role != Reader) {
+        return m_role == Writer;
+    }
+    // Only fails while someone holds the writer's exclusive lock
+    if (::flock(m_fd, LOCK_SH | LOCK_NB) != 0) {
+        return true;
+    }
+    ::flock(m_fd, LOCK_UN);
+    return false;
+}
+
+#else
+
+bool SharedSnapshotRing::attachWriter(const QString &)
+{
+    return false;
+}
+
+bool SharedSnapshotRing::attachReader(const QString &)
+{
+    return false;
+}
+
+void SharedSnapshotRing::openViewers(const QString &)
+{
+}
+
+void SharedSnapshotRing::mapViewers()
+{
+}
+
+void SharedSnapshotRing::setViewing(bool viewing)
+{
+    m_viewing = viewing;
+}
+
+bool SharedSnapshotRing::hasViewers() const
+{
+    return false;
+}
+
+quint32 SharedSnapshotRing::viewerGeneration() const
+{
+    return 0;
+}
+
+void SharedSnapshotRing::detach()
+{
+    m_role = Detached;
+}
+
+bool SharedSnapshotRing::hasWriter() const
+{
+    return m_role == Writer;
+}
+
+#endif
+
+void SharedSnapshotRing::publish(const SystemSnapshot &snapshot)
+{
+    if (m_role != Writer) {
+        return;
+    }
+    const quint64 published = m_layout->published.load(std::memory_order_relaxed);
+    SharedSlot &slot = m_layout->ring[published % kSlotCount];
+
+    // Even, even if a writer died halfway through this slot
+    const quint64 sequence = slot.sequence.load(std::memory_order_relaxed) & ~quint64(1);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    storeSnapshot(snapshot, slot.data);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+
+    m_layout->published.store(published + 1, std::memory_order_release);
+}
+
+bool SharedSnapshotRing::read(SystemSnapshot &out)
+{
+    if (m_role != Reader) {
+        return false;
+    }
+    // The writer moves to another slot for every snapshot, so a retry
+    // only happens when a reader falls a whole ring behind mid-read
+    for (int attempt = 0; attempt < kSlotCount; ++attempt) {
+        const quint64 published = m_layout->published.load(std::memory_order_acquire);
+        if (published == 0 || published == m_lastRead) {
+            return false;
+        }
+        const SharedSlot &slot = m_layout->ring[(published - 1) % kSlotCount];
+        const quint64 before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        loadSnapshot(slot.data, out);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) {
+            m_lastRead = published;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,95 @@
+#ifndef SHAREDSNAPSHOT_H
+#define SHAREDSNAPSHOT_H
+
+#include <QString>
+#include <QtGlobal>
+
+struct SystemSnapshot;
+struct SharedSnapshotLayout;
+struct SharedViewers;
+
+/**
+ * @brief Publishes snapshots to other local processes through shared memory
+ *
+ * A POSIX shared-memory object holds a header and a ring of fixed-layout
+ * slots, each guarded by a seqlock: the writer makes a slot's sequence
+ * odd, fills it, makes it even again, then bumps the published count.
+ * Readers map the object read-only, convert the newest slot straight
+ * from the mapping and retry if its sequence moved meanwhile; they never
+ * block the writer, and the writer never knows how many there are.
+ *
+ * The writer holds an exclusive flock() on the object for as long as it
+ * lives, which is how readers tell that it has gone. The object is left
+ * in place on exit so attached readers keep a valid mapping; the next
+ * writer reuses it. A ring without a live writer that cannot be taken
+ * over leaves attach() Detached, so the caller collects on its own.
+ *
+ * The default name is per user, matching the per-user history the
+ * writer records, and the object is only accessible to that user.
+ *
+ * Visible viewers hold a shared flock() on a second, small object next to
+ * the ring, so the writer can tell whether anyone is looking before it
+ * slows down for want of a view of its own. The object also holds a
+ * generation that a viewer bumps whenever it starts showing snapshots,
+ * which a paused writer can poll cheaply to resume at once.
+ *
+ * Fixed capacities bound what a slot holds: 512 cores, 64 mounts, block
+ * devices and interfaces, and kRankedProcessCount processes per ranking.
+ * Longer strings are truncated. Unix only; elsewhere attach() fails.
+ */
+class SharedSnapshotRing
+{
+public:
+    enum Role {
+        Detached,
+        Writer,
+        Reader
+    };
+
+    SharedSnapshotRing();
+    ~SharedSnapshotRing();
+
+    SharedSnapshotRing(const SharedSnapshotRing &) = delete;
+    SharedSnapshotRing &operator=(const SharedSnapshotRing &) = delete;
+
+    // Becomes the writer if no live process holds name, a reader if one
+    // does, Detached if neither works
+    Role attach(const QString &name = defaultName());
+    void detach();
+    // Only changes in attach() and detach()
+    Role role() const { return m_role; }
+
+    static QString defaultName();
+
+    // Writer side, from the collector thread
+    void publish(const SystemSnapshot &snapshot);
+
+    // Reader side: copies the newest snapshot into out, if one was
+    // published since the last call; false otherwise
+    bool read(SystemSnapshot &out);
+    // Reader side: whether the writer that created the ring is still alive
+    bool hasWriter() const;
+    // Reader side: whether this process currently shows the snapshots;
+    // kept across attach()
+    void setViewing(bool viewing);
+    // Writer side: whether any reader is showing the snapshots
+    bool hasViewers() const;
+    // Writer side: changes whenever a reader starts showing the snapshots
+    quint32 viewerGeneration() const;
+
+private:
+    bool attachWriter(const QString &name);
+    bool attachReader(const QString &name);
+    void openViewers(const QString &name);
+    void mapViewers();
+
+    int m_fd;
+    int m_viewersFd;
+    SharedViewers *m_viewers;
+    bool m_viewing;
+    SharedSnapshotLayout *m_layout;
+    Role m_role;
+    quint64 m_lastRead; // published count at the last successful read()
+};
+
+#endif // SHAREDSNAPSHOT_H
@@ -1,16 +1,56 @@
 #include "systemmonitor.h"
+#include "samplecollector.h"
+#include "utils/instrumentation.h"
+#include "utils/proccapture.h"
 #include <QDateTime>
-#include <algorithm>
+#include <QDebug>
+#include <QStandardPaths>
+
+// Share of one core the collector may use before it backs off, in percent
+static constexpr double kDefaultCpuBudget = 5.0;
+
+// History lives next to the application's other local data
+static QString historyDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/history";
+}
 
 SystemMonitor::SystemMonitor(QObject *parent)
     : QObject{parent}
-    , m_updateTimer(new QTimer(this))
-    , m_cpuUsage(0.0)
-    , m_lastRxBytes(0)
-    , m_lastTxBytes(0)
-    , m_lastUpdateTime(0)
+    , m_snapshot(&m_buffer.front())
+    , m_sharedTimer(new QTimer(this))
+    , m_intervalMs(1000)
+    , m_workerThread(new QThread(this))
+    , m_collector(nullptr)
 {
-    connect(m_updateTimer, &QTimer::timeout, this, &SystemMonitor::updateData);
+    // Recording and replaying always collect here, and leave the ring and
+    // the history files to the host's regular collector; a replay has no
+    // business in this host's history at all
+    const ProcCapture::Mode capture = ProcCapture::mode();
+    const bool viewer = capture == ProcCapture::Off && m_shared.attach() == SharedSnapshotRing::Reader;
+    if (capture != ProcCapture::Replaying) {
+        const bool readOnly = viewer || capture == ProcCapture::Recording;
+        const bool historyOpened = readOnly ? m_history.openReadOnly(historyDirectory())
+                                            : m_history.open(historyDirectory());
+        if (!historyOpened) {
+            qWarning() << "Metric history unavailable in" << historyDirectory();
+        }
+        if (!(readOnly ? m_rollupStore.openReadOnly(historyDirectory())
+                       : m_rollupStore.open(historyDirectory()))) {
+            qWarning() << "Stored rollups unavailable in" << historyDirectory();
+        }
+    }
+    connect(m_sharedTimer, &QTimer::timeout, this, &SystemMonitor::readSharedSnapshot);
+
+    m_collector = new SampleCollector(&m_buffer, &m_history, nullptr, &m_shared);
+    m_collector->setCpuBudget(kDefaultCpuBudget);
+    m_collector->setRollupStore(&m_rollupStore);
+    m_workerThread->setObjectName("SystemMonitor collector");
+    m_collector->moveToThread(m_workerThread);
+    connect(m_workerThread, &QThread::finished, m_collector, &QObject::deleteLater);
+    connect(m_collector, &SampleCollector::snapshotPublished, this, &SystemMonitor::updateData);
+    connect(m_collector, &SampleCollector::replayFinished, this, &SystemMonitor::replayFinished);
+    m_workerThread->start();
 }
 
 void SystemMonitor::startMonitoring(int intervalMs)
@@ -19,82 +59,181 @@ void SystemMonitor::startMonitoring(int intervalMs)
         qWarning() << "Interval too short, using minimum of 100ms";
         intervalMs = 100;
     }
+    m_intervalMs = intervalMs;
 
-    if (!m_updateTimer) {
-        qCritical() << "Failed to create update timer";
+    if (!isCollecting()) {
+        // Checking the ring is one atomic load, so poll well within a period
+        m_sharedTimer->start(qBound(50, intervalMs / 4, 250));
+        qDebug() << "Viewing snapshots from another collector";
         return;
     }
-
-    // Initializing network tracking
-    m_networkStats = SystemInfo::getNetworkStats();
-    m_lastRxBytes = m_networkStats.bytesReceived;
-    m_lastTxBytes = m_networkStats.bytesSent;
-    m_lastUpdateTime = QDateTime::currentMSecsSinceEpoch();
-
-    // Get initial data
-    updateData();
-
-    m_updateTimer->start(intervalMs);
+    QMetaObject::invokeMethod(m_collector, [collector = m_collector, intervalMs]() {
+        collector->start(intervalMs);
+    }, Qt::QueuedConnection);
     qDebug() << "Monitoring started with interval:" << intervalMs << "ms";
 }
 
 void SystemMonitor::stopMonitoring()
 {
-    if (m_updateTimer) {
-        m_updateTimer->stop();
-    }
+    m_sharedTimer->stop();
+    QMetaObject::invokeMethod(m_collector, &SampleCollector::stop, Qt::QueuedConnection);
     qDebug() << "Monitoring stopped";
 }
-void SystemMonitor::updateData()
+
+void SystemMonitor::setSamplingPeriod(MetricFamily family, int periodMs)
 {
-    // Update CPU usage
-    m_cpuUsage = SystemInfo::getCpuUsage();
-    emit cpuUsageChanged(m_cpuUsage);
+    if (periodMs < 100) {
+        qWarning() << "Sampling period too short, using minimum of 100ms";
+        periodMs = 100;
+    }
+    QMetaObject::invokeMethod(m_collector, [collector = m_collector, family, periodMs]() {
+        collector->setPeriod(family, periodMs);
+    }, Qt::QueuedConnection);
+}
 
-    // Update memory info
-    m_memoryInfo = SystemInfo::getMemoryInfo();
-    emit memoryUsageChanged(m_memoryInfo.usedPhysical, m_memoryInfo.totalPhysical);
+void SystemMonitor::setMaxScanThreads(int count)
+{
+    // The process cache is only ever touched from the collector thread
+    QMetaObject::invokeMethod(m_collector, [count]() {
+        SystemInfo::setMaxScanThreads(count);
+    }, Qt::QueuedConnection);
+}
 
-    // Update disk info
-    m_diskInfo = SystemInfo::getDiskInfo();
+void SystemMonitor::setViewsVisible(bool visible)
+{
+    m_shared.setViewing(visible);
+    QMetaObject::invokeMethod(m_collector, [collector = m_collector, visible]() {
+        collector->setViewsVisible(visible);
+    }, Qt::QueuedConnection);
+}
 
-    // Update network stats with speed calculation
-    NetworkStats newStats = SystemInfo::getNetworkStats();
-    qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
-    qint64 timeDelta = currentTime - m_lastUpdateTime;
+void SystemMonitor::setWatchedProcesses(const QVector<quint32> &pids)
+{
+    QMetaObject::invokeMethod(m_collector, [collector = m_collector, pids]() {
+        collector->setWatchedProcesses(pids);
+    }, Qt::QueuedConnection);
+}
 
-    if (timeDelta > 0) {
-        qint64 rxDelta = newStats.bytesReceived - m_lastRxBytes;
-        qint64 txDelta = newStats.bytesSent - m_lastTxBytes;
+void SystemMonitor::setCpuBudget(double percent)
+{
+    QMetaObject::invokeMethod(m_collector, [collector = m_collector, percent]() {
+        collector->setCpuBudget(percent);
+    }, Qt::QueuedConnection);
+}
 
-        // Convert to KB/s
-        newStats.downloadSpeedKBps = (rxDelta / 1024.0) / (timeDelta / 1000.0);
-        newStats.uploadSpeedKBps = (txDelta / 1024.0) / (timeDelta / 1000.0);
+void SystemMonitor::updateData()
+{
+    // Several notifications may be queued for one snapshot
+    if (!m_buffer.acquire()) {
+        return;
+    }
+    m_snapshot = &m_buffer.front();
+    snapshotChanged();
+}
 
-        m_lastRxBytes = newStats.bytesReceived;
-        m_lastTxBytes = newStats.bytesSent;
-        m_lastUpdateTime = currentTime;
+void SystemMonitor::readSharedSnapshot()
+{
+    if (m_shared.read(m_sharedSnapshot)) {
+        m_snapshot = &m_sharedSnapshot;
+        snapshotChanged();
+    } else if (!m_shared.hasWriter()) {
+        takeOverCollection();
     }
+}
 
-    m_networkStats = newStats;
-    emit networkActivityChanged(m_networkStats.downloadSpeedKBps, m_networkStats.uploadSpeedKBps);
+void SystemMonitor::takeOverCollection()
+{
+    m_sharedTimer->stop();
+    // Another viewer may get there first, in which case keep viewing
+    if (m_shared.attach() == SharedSnapshotRing::Reader) {
+        m_sharedTimer->start();
+        return;
+    }
+    qDebug() << "Collector gone, collecting in this process";
+    if (!m_history.open(historyDirectory())) {
+        qWarning() << "Metric history unavailable in" << historyDirectory();
+    }
+    if (!m_rollupStore.open(historyDirectory())) {
+        qWarning() << "Stored rollups unavailable in" << historyDirectory();
+    }
+    // The collector thread has been idle, and only starts after this
+    QMetaObject::invokeMethod(m_collector, [collector = m_collector, intervalMs = m_intervalMs]() {
+        collector->start(intervalMs);
+    }, Qt::QueuedConnection);
+}
 
-    // Update process list
-    m_processes = SystemInfo::getTopProcesses(20);
-    std::sort(m_processes.begin(), m_processes.end());
+void SystemMonitor::snapshotChanged()
+{
+    // Everything the views do with the snapshot counts towards the tick
+    Instrumentation::Scope scope(Instrumentation::UpdateDataProbe);
+    for (int family = 0; m_rollups && family < MetricFamilyCount; ++family) {
+        const MetricFamily metric = static_cast<MetricFamily>(family);
+        if ((m_snapshot->updatedFamilies & familyBit(metric)) && HistoryStore::isRecorded(metric)) {
+            m_rollups->append(metric, SampleCollector::historyRecord(metric, *m_snapshot));
+        }
+    }
 
+    // Only families sampled in this pass; the others would repeat an old
+    // value at a new timestamp
+    const MetricFamilies families = m_snapshot->updatedFamilies;
+    if (families & familyBit(CpuFamily)) {
+        emit cpuUsageChanged(m_snapshot->cpu.total.usage);
+    }
+    if (families & familyBit(MemoryFamily)) {
+        emit memoryUsageChanged(m_snapshot->memory.usedPhysical, m_snapshot->memory.totalPhysical);
+    }
+    if (families & familyBit(NetworkFamily)) {
+        emit networkActivityChanged(m_snapshot->network.downloadSpeedKBps, m_snapshot->network.uploadSpeedKBps);
+    }
     emit dataUpdated();
 }
 
 SystemMonitor::~SystemMonitor()
 {
     stopMonitoring();
+    m_workerThread->quit();
+    m_workerThread->wait();
 }
 
-QVector<ProcessInfo> SystemMonitor::getTopProcesses(int count) const
+QVector<ProcessInfo> SystemMonitor::getTopProcesses(int count, ProcessSortKey key) const
 {
-    if (count <= 0 || count > m_processes.size()) {
-        return m_processes;
+    if (key < 0 || key >= ProcessSortKeyCount) {
+        return {};
     }
-    return m_processes.mid(0, count);
+    const QVector<ProcessInfo> &processes = m_snapshot->topProcesses[key];
+    if (count <= 0 || count > processes.size()) {
+        return processes;
+    }
+    return processes.mid(0, count);
+}
+
+void SystemMonitor::enableRollups()
+{
+    if (m_rollups) {
+        return;
+    }
+    // Start the rollups from the buckets earlier runs stored, then from
+    // the recorded history for the time since
+    m_rollups.reset(new RollupEngine);
+    m_rollups->restore(m_rollupStore);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int family = 0; family < MetricFamilyCount; ++family) {
+        if (HistoryStore::isRecorded(MetricFamily(family))) {
+            m_rollups->backfill(MetricFamily(family), history(MetricFamily(family), 0, now));
+        }
+    }
+}
+
+void SystemMonitor::enableRecentHistory()
+{
+    QMetaObject::invokeMethod(m_collector, [collector = m_collector, recent = &m_recent]() {
+        collector->setRecentHistory(recent);
+    }, Qt::QueuedConnection);
+}
+
+QVector<HistoryRecord> SystemMonitor::history(MetricFamily family, qint64 fromMs, qint64 toMs) const
+{
+    QVector<HistoryRecord> records;
+    m_history.query(family, fromMs, toMs, records);
+    return records;
 }
@@ -2,10 +2,29 @@
 #define SYSTEMMONITOR_H
 
 #include <QObject>
+#include <QScopedPointer>
+#include <QThread>
 #include <QTimer>
 #include <QVector>
+#include "sharedsnapshot.h"
+#include "systemsnapshot.h"
+#include "utils/historystore.h"
+#include "utils/metrichistory.h"
+#include "utils/rollup.h"
+#include "utils/samplingscheduler.h"
 #include "utils/systeminfo.h"
+#include "utils/triplebuffer.h"
 
+class SampleCollector;
+
+/**
+ * @brief Source of snapshots for the views
+ *
+ * The first monitor on a host collects, and publishes every snapshot to a
+ * SharedSnapshotRing; later ones only attach to that ring and read /proc
+ * not at all. A viewer whose collector goes away takes over collection.
+ * While a ProcCapture records or replays, the monitor collects on its own.
+ */
 class SystemMonitor : public QObject
 {
     Q_OBJECT
@@ -13,39 +32,104 @@ public:
     explicit SystemMonitor(QObject *parent = nullptr);
     ~SystemMonitor();
 
+    // CPU, memory, network and disk I/O follow intervalMs; processes and disk
+    // capacity keep their own, slower periods. setSamplingPeriod() called
+    // after starting overrides either.
+    // A viewer polls the shared ring instead, picking up snapshots at the
+    // collecting process's rate.
     void startMonitoring(int intervalMs = 1000);
     void stopMonitoring();
+    void setSamplingPeriod(MetricFamily family, int periodMs);
+
+    // Caps the threads used by the process scan so the monitor never takes
+    // more than a bounded share of the host it is watching
+    void setMaxScanThreads(int count);
+
+    // Whether any view shows the data. While none does, expensive
+    // families pause or slow down; showing one again brings a fresh
+    // snapshot straight away. A viewer passes this on to the collecting
+    // process through the shared ring.
+    void setViewsVisible(bool visible);
+
+    // Processes whose detail fields (uid, lifetime I/O, PSS, command line)
+    // are loaded into SystemSnapshot::processDetails, typically the rows
+    // on screen and the selection. Only the collecting process loads them.
+    void setWatchedProcesses(const QVector<quint32> &pids);
+
+    // Share of one core, in percent, the monitor may use before it backs
+    // off its sampling; 0 disables the budget
+    void setCpuBudget(double percent);
 
-    // Data retrieval methods
-    double getCpuUsage() const { return m_cpuUsage; }
-    MemoryInfo getMemoryInfo() const { return m_memoryInfo; }
-    QVector<DiskInfo> getDiskInfo() const { return m_diskInfo; }
-    NetworkStats getNetworkStats() const { return m_networkStats; }
-    QVector<ProcessInfo> getTopProcesses(int count = 10) const;
+    // Data retrieval methods, reading the latest published snapshot
+    double getCpuUsage() const { return m_snapshot->cpu.total.usage; }
+    CpuInfo getCpuInfo() const { return m_snapshot->cpu; }
+    MemoryInfo getMemoryInfo() const { return m_snapshot->memory; }
+    QVector<DiskInfo> getDiskInfo() const { return m_snapshot->disks; }
+    QVector<DiskIoStats> getDiskIoStats() const { return m_snapshot->diskIo; }
+    NetworkStats getNetworkStats() const { return m_snapshot->network; }
+    QVector<InterfaceStats> getInterfaceStats() const { return m_snapshot->interfaces; }
+    QVector<ProcessInfo> getTopProcesses(int count = 10, ProcessSortKey key = SortByCpu) const;
+    const SystemSnapshot &snapshot() const { return *m_snapshot; }
+
+    // False while snapshots come from another process's collector
+    bool isCollecting() const { return m_shared.role() != SharedSnapshotRing::Reader; }
+
+    // Recorded samples of a family between fromMs and toMs, oldest first;
+    // includes samples from previous runs
+    QVector<HistoryRecord> history(MetricFamily family, qint64 fromMs, qint64 toMs) const;
+
+    // Retained samples of every metric this run has collected, by series
+    // name ("cpu.core0", "net.eth0.rx", "process.1234.cpu", ...). Costs a
+    // few megabytes a day, so it stays empty until enableRecentHistory(),
+    // and while not collecting.
+    void enableRecentHistory();
+    const MetricHistory &recentHistory() const { return m_recent; }
+
+    // Minute and hour aggregates of the main history channels. The
+    // collecting process always stores closed buckets on disk; keeping
+    // them in memory costs a few megabytes, so only views that draw them
+    // enable them. Enabling loads the stored buckets and back-fills the
+    // rest from the recorded history, then every snapshot updates them.
+    void enableRollups();
+    const RollupEngine *rollups() const { return m_rollups.data(); }
 
 signals:
+    // Every snapshot; the per-family signals below only fire when their
+    // family was sampled in it
     void dataUpdated();
     void cpuUsageChanged(double usage);
     void memoryUsageChanged(qint64 used, qint64 total);
     void networkActivityChanged(double downloadKBps, double uploadKBps);
+    // Every frame of the replayed capture has been collected
+    void replayFinished();
 
 private slots:
     void updateData();
+    void readSharedSnapshot();
 
 private:
-    QTimer *m_updateTimer;
-
-    // Cached Data
-    double m_cpuUsage;
-    MemoryInfo m_memoryInfo;
-    QVector<DiskInfo> m_diskInfo;
-    NetworkStats m_networkStats;
-    QVector<ProcessInfo> m_processes;
-
-    // For network speed calculation
-    qint64 m_lastRxBytes;
-    qint64 m_lastTxBytes;
-    qint64 m_lastUpdateTime;
+    void snapshotChanged();
+    void takeOverCollection();
+
+    // Collection runs on m_workerThread and hands snapshots over through
+    // m_buffer; m_snapshot always points at the reader's front buffer.
+    TripleBuffer<SystemSnapshot> m_buffer;
+    const SystemSnapshot *m_snapshot;
+    // Snapshots from another process's collector, while a viewer
+    SharedSnapshotRing m_shared;
+    SystemSnapshot m_sharedSnapshot;
+    QTimer *m_sharedTimer;
+    int m_intervalMs;
+    // Appended to by the collector, queried from the GUI thread; read-only
+    // while a viewer, since the collecting process owns the files
+    HistoryStore m_history;
+    // Written by the collector as rollup buckets close, like m_history
+    RollupStore m_rollupStore;
+    MetricHistory m_recent;
+    // Only touched on the GUI thread; null until enableRollups()
+    QScopedPointer<RollupEngine> m_rollups;
+    QThread *m_workerThread;
+    SampleCollector *m_collector;
 };
 
 #endif // SYSTEMMONITOR_H
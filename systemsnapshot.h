@@ -0,0 +1,33 @@
+#ifndef SYSTEMSNAPSHOT_H
+#define SYSTEMSNAPSHOT_H
+
+#include <QVector>
+#include "utils/samplingscheduler.h"
+#include "utils/systeminfo.h"
+
+// Processes kept in each ranking of a snapshot
+constexpr int kRankedProcessCount = 50;
+
+// Everything collected in one sampling pass
+struct SystemSnapshot {
+    qint64 timestampMs = 0;
+    // Families sampled in this pass; the others carry older values
+    MetricFamilies updatedFamilies = 0;
+    CpuInfo cpu = {};
+    MemoryInfo memory = {};
+    QVector<DiskInfo> disks;
+    QVector<DiskIoStats> diskIo;
+    NetworkStats network = {}; // totals over interfaces
+    QVector<InterfaceStats> interfaces;
+    // Every process at the last process scan, unordered; shares its data
+    // with the collector's list, and is empty while viewing another
+    // collector, since the shared ring only carries the rankings
+    QVector<ProcessInfo> processes;
+    // Best kRankedProcessCount processes per ProcessSortKey, best first
+    QVector<ProcessInfo> topProcesses[ProcessSortKeyCount];
+    // Details of the watched processes only, in no particular order; not
+    // carried by the shared ring
+    QVector<ProcessDetails> processDetails;
+};
+
+#endif // SYSTEMSNAPSHOT_H
@@ -0,0 +1,287 @@
+#include "compressedseries.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+static quint64 doubleBits(double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double bitsDouble(quint64 bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static quint64 lowBits(quint64 bits, int count)
+{
+    return count >= 64 ? bits : bits & ((quint64(1) << count) - 1);
+}
+
+// Encodings of a timestamp delta-of-delta: prefix, prefix length, payload bits
+struct DeltaBucket {
+    quint64 prefix;
+    int prefixBits;
+    int payloadBits;
+};
+static constexpr DeltaBucket kDeltaBuckets[] = {
+    {0x2, 2, 7},  // 10   + [-63, 64]
+    {0x6, 3, 9},  // 110  + [-255, 256]
+    {0xe, 4, 12}, // 1110 + [-2047, 2048]
+};
+// 1111 + the raw 64-bit delta-of-delta
+static constexpr quint64 kRawDeltaPrefix = 0xf;
+
+CompressedSeries::CompressedSeries(int samplesPerBlock)
+    : m_samplesPerBlock(qMax(2, samplesPerBlock))
+    , m_size(0)
+    , m_lastTimestamp(0)
+    , m_lastDelta(0)
+    , m_lastValue(0.0)
+    , m_lastLeading(-1)
+    , m_lastTrailing(0)
+{
+}
+
+void CompressedSeries::writeBits(quint64 bits, int count)
+{
+    Block &block = m_blocks.last();
+    bits = lowBits(bits, count);
+    while (count > 0) {
+        const int offset = block.bitCount & 63;
+        if (offset == 0) {
+            block.words.append(0);
+        }
+        const int take = qMin(64 - offset, count);
+        const quint64 chunk = lowBits(bits >> (count - take), take);
+        block.words.last() |= chunk << (64 - offset - take);
+        count -= take;
+        block.bitCount += take;
+    }
+}
+
+void CompressedSeries::startBlock(qint64 timestampMs, double value)
+{
+    if (!m_blocks.isEmpty()) {
+        m_blocks.last().words.squeeze();
+    }
+    Block block;
+    block.firstTimestamp = timestampMs;
+    block.lastTimestamp = timestampMs;
+    block.count = 1;
+    block.bitCount = 0;
+    // A series that filled a block will likely fill the next one too; the
+    // first block grows as needed, since many series never get that far
+    if (!m_blocks.isEmpty()) {
+        block.words.reserve(m_samplesPerBlock / 16 + 2);
+    }
+    m_blocks.append(block);
+    writeBits(quint64(timestampMs), 64);
+    writeBits(doubleBits(value), 64);
+    m_lastDelta = 0;
+    m_lastLeading = -1;
+}
+
+void CompressedSeries::append(qint64 timestampMs, double value)
+{
+    if (m_size > 0 && timestampMs < m_lastTimestamp) {
+        return;
+    }
+    if (m_blocks.isEmpty() || m_blocks.last().count >= m_samplesPerBlock) {
+        startBlock(timestampMs, value);
+    } else {
+        // Timestamp: delta-of-delta in the smallest bucket that fits
+        const qint64 delta = timestampMs - m_lastTimestamp;
+        const qint64 deltaOfDelta = delta - m_lastDelta;
+        if (deltaOfDelta == 0) {
+            writeBits(0, 1);
+        } else {
+            bool written = false;
+            for (const DeltaBucket &bucket : kDeltaBuckets) {
+                const qint64 bias = (qint64(1) << (bucket.payloadBits - 1)) - 1;
+                if (deltaOfDelta >= -bias && deltaOfDelta <= bias + 1) {
+                    writeBits(bucket.prefix, bucket.prefixBits);
+                    writeBits(quint64(deltaOfDelta + bias), bucket.payloadBits);
+                    written = true;
+                    break;
+                }
+            }
+            if (!written) {
+                writeBits(kRawDeltaPrefix, 4);
+                writeBits(quint64(deltaOfDelta), 64);
+            }
+        }
+        m_lastDelta = delta;
+
+        // Value: XOR with the previous one, reusing its bit window if possible
+        const quint64 xorBits = doubleBits(value) ^ doubleBits(m_lastValue);
+        if (xorBits == 0) {
+            writeBits(0, 1);
+        } else {
+            // Five bits hold the leading zero count
+            const int leading = qMin(31, int(qCountLeadingZeroBits(xorBits)));
+            const int trailing = int(qCountTrailingZeroBits(xorBits));
+            if (m_lastLeading >= 0 && leading >= m_lastLeading && trailing >= m_lastTrailing) {
+                writeBits(0x2, 2);
+                writeBits(xorBits >> m_lastTrailing, 64 - m_lastLeading - m_lastTrailing);
+            } else {
+                const int meaningful = 64 - leading - trailing;
+                writeBits(0x3, 2);
+                writeBits(quint64(leading), 5);
+                writeBits(quint64(meaningful - 1), 6);
+                writeBits(xorBits >> trailing, meaningful);
+                m_lastLeading = leading;
+                m_lastTrailing = trailing;
+            }
+        }
+        Block &block = m_blocks.last();
+        block.lastTimestamp = timestampMs;
+        ++block.count;
+    }
+    m_lastTimestamp = timestampMs;
+    m_lastValue = value;
+    ++m_size;
+}
+
+void CompressedSeries::discardBefore(qint64 timestampMs)
+{
+    // The open block is kept, it carries the encoder state
+    int drop = 0;
+    while (drop < m_blocks.size() - 1 && m_blocks.at(drop).lastTimestamp < timestampMs) {
+        m_size -= m_blocks.at(drop).count;
+        ++drop;
+    }
+    if (drop > 0) {
+        m_blocks.remove(0, drop);
+    }
+}
+
+void CompressedSeries::clear()
+{
+    m_blocks.clear();
+    m_size = 0;
+    m_lastTimestamp = 0;
+    m_lastDelta = 0;
+    m_lastValue = 0.0;
+    m_lastLeading = -1;
+}
+
+qint64 CompressedSeries::firstTimestamp() const
+{
+    return m_blocks.isEmpty() ? 0 : m_blocks.first().firstTimestamp;
+}
+
+qint64 CompressedSeries::byteSize() const
+{
+    qint64 bytes = sizeof(*this);
+    for (const Block &block : m_blocks) {
+        bytes += sizeof(Block) + qint64(block.words.capacity()) * qint64(sizeof(quint64));
+    }
+    return bytes;
+}
+
+CompressedSeries::ConstIterator CompressedSeries::begin() const
+{
+    return ConstIterator(this, 0);
+}
+
+CompressedSeries::ConstIterator CompressedSeries::from(qint64 fromMs) const
+{
+    // Skip whole blocks; the caller skips the remaining older samples
+    int block = 0;
+    while (block < m_blocks.size() - 1 && m_blocks.at(block).lastTimestamp < fromMs) {
+        ++block;
+    }
+    return ConstIterator(this, block);
+}
+
+CompressedSeries::ConstIterator::ConstIterator(const CompressedSeries *series, int block)
+    : m_series(series)
+    , m_block(block)
+    , m_remaining(0)
+    , m_bitPosition(0)
+    , m_first(false)
+    , m_timestamp(0)
+    , m_delta(0)
+    , m_valueBits(0)
+    , m_leading(0)
+    , m_trailing(0)
+{
+    if (m_block < m_series->m_blocks.size()) {
+        enterBlock();
+    }
+}
+
+void CompressedSeries::ConstIterator::enterBlock()
+{
+    m_remaining = m_series->m_blocks.at(m_block).count;
+    m_bitPosition = 0;
+    m_first = true;
+}
+
+quint64 CompressedSeries::ConstIterator::readBits(int count)
+{
+    const QVector<quint64> &words = m_series->m_blocks.at(m_block).words;
+    quint64 result = 0;
+    while (count > 0) {
+        const int offset = m_bitPosition & 63;
+        const int take = qMin(64 - offset, count);
+        const quint64 chunk = (words.at(m_bitPosition >> 6) << offset) >> (64 - take);
+        result = take == 64 ? chunk : (result << take) | chunk;
+        count -= take;
+        m_bitPosition += take;
+    }
+    return result;
+}
+
+bool CompressedSeries::ConstIterator::next(qint64 &timestampMs, double &value)
+{
+    if (m_remaining == 0) {
+        if (m_block + 1 >= m_series->m_blocks.size()) {
+            return false;
+        }
+        ++m_block;
+        enterBlock();
+    }
+    --m_remaining;
+
+    if (m_first) {
+        m_first = false;
+        m_timestamp = qint64(readBits(64));
+        m_valueBits = readBits(64);
+        m_delta = 0;
+    } else {
+        // Timestamp: count the prefix ones, at most four
+        int ones = 0;
+        while (ones < 4 && readBits(1)) {
+            ++ones;
+        }
+        qint64 deltaOfDelta = 0;
+        if (ones == 4) {
+            deltaOfDelta = qint64(readBits(64));
+        } else if (ones > 0) {
+            const DeltaBucket &bucket = kDeltaBuckets[ones - 1];
+            const qint64 bias = (qint64(1) << (bucket.payloadBits - 1)) - 1;
+            deltaOfDelta = qint64(readBits(bucket.payloadBits)) - bias;
+        }
+        m_delta += deltaOfDelta;
+        m_timestamp += m_delta;
+
+        // Value
+        if (readBits(1)) {
+            if (readBits(1)) {
+                m_leading = int(readBits(5));
+                const int meaningful = int(readBits(6)) + 1;
+                m_trailing = 64 - m_leading - meaningful;
+            }
+            const int meaningful = 64 - m_leading - m_trailing;
+            m_valueBits ^= readBits(meaningful) << m_trailing;
+        }
+    }
+    timestampMs = m_timestamp;
+    value = bitsDouble(m_valueBits);
+    return true;
+}
@@ -0,0 +1,99 @@
+#ifndef COMPRESSEDSERIES_H
+#define COMPRESSEDSERIES_H
+
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * @brief Gorilla-style compressed time series of (ms timestamp, double)
+ *
+ * Timestamps are stored as delta-of-delta and values as the XOR with the
+ * previous value, both bit-packed with variable-length prefixes. At a
+ * steady interval a timestamp costs one bit, and so does an unchanged
+ * value: a flat series takes well under a byte per sample. A slowly
+ * changing value takes a few bits to a couple of bytes more, so typical
+ * samples take 1-3 bytes instead of 16.
+ *
+ * Samples live in a chain of blocks. Each block starts with a raw sample,
+ * so iteration can begin at any block and retention drops whole blocks
+ * from the front without re-encoding anything.
+ */
+class CompressedSeries
+{
+public:
+    class ConstIterator;
+
+    explicit CompressedSeries(int samplesPerBlock = 1024);
+
+    // Timestamps must not decrease; older samples are dropped
+    void append(qint64 timestampMs, double value);
+    // Drops the blocks whose samples are all older than timestampMs
+    void discardBefore(qint64 timestampMs);
+    void clear();
+
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    qint64 firstTimestamp() const;
+    qint64 lastTimestamp() const { return m_lastTimestamp; }
+    double lastValue() const { return m_lastValue; }
+    // Encoded size, including block bookkeeping
+    qint64 byteSize() const;
+
+    // Iterates from the oldest sample, or from the block holding fromMs
+    ConstIterator begin() const;
+    ConstIterator from(qint64 fromMs) const;
+
+private:
+    struct Block {
+        qint64 firstTimestamp;
+        qint64 lastTimestamp;
+        int count;
+        int bitCount;
+        QVector<quint64> words;
+    };
+
+    void writeBits(quint64 bits, int count);
+    void startBlock(qint64 timestampMs, double value);
+
+    QVector<Block> m_blocks;
+    int m_samplesPerBlock;
+    int m_size;
+    // Encoder state for the open block
+    qint64 m_lastTimestamp;
+    qint64 m_lastDelta;
+    double m_lastValue;
+    int m_lastLeading;
+    int m_lastTrailing;
+};
+
+/**
+ * @brief Forward iterator decoding one sample at a time
+ *
+ * The series must not be modified while an iterator is in use.
+ */
+class CompressedSeries::ConstIterator
+{
+public:
+    // Advances to the next sample; false at the end
+    bool next(qint64 &timestampMs, double &value);
+
+private:
+    friend class CompressedSeries;
+    ConstIterator(const CompressedSeries *series, int block);
+
+    quint64 readBits(int count);
+    void enterBlock();
+
+    const CompressedSeries *m_series;
+    int m_block;
+    int m_remaining; // samples left in the current block
+    int m_bitPosition;
+    bool m_first;
+    qint64 m_timestamp;
+    qint64 m_delta;
+    quint64 m_valueBits;
+    int m_leading;
+    int m_trailing;
+};
+
+#endif // COMPRESSEDSERIES_H
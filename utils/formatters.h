@@ -40,6 +40,18 @@ namespace Formatters {
         return QString::number(percentage, 'f', 1) + "%";
     }
 
+    inline QString formatDuration(double ns) {
+        if (ns >= 1e9) {
+            return QString::number(ns / 1e9, 'f', 2) + " s";
+        } else if (ns >= 1e6) {
+            return QString::number(ns / 1e6, 'f', 2) + " ms";
+        } else if (ns >= 1e3) {
+            return QString::number(ns / 1e3, 'f', 1) + " µs";
+        } else {
+            return QString::number(ns, 'f', 0) + " ns";
+        }
+    }
+
     inline QColor getUsageColor(double percentage) {
         if (percentage < 60.0) {
             return QColor("#4CAF50"); // Green
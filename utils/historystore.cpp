@@ -0,0 +1,307 @@
+#include "historystore.h"
+#include <QDebug>
+#include <QDir>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/file.h>
+#endif
+
+static constexpr quint32 kMagic = 0x53484d53; // "SMHS"
+static constexpr quint32 kVersion = 1;
+
+// Backward clock steps past this start a new epoch instead of dropping
+// records until the clock catches up
+static constexpr qint64 kClockStepMs = 60000;
+
+// File names of the recorded families, indexed by MetricFamily
+static const char *const kFamilyFiles[MetricFamilyCount] = {
+    "cpu.ring", "memory.ring", "network.ring", nullptr, nullptr, "diskio.ring", nullptr
+};
+
+// Only one process writes a ring; the lock goes with the file handle
+static bool lockForWriting(QFile &file)
+{
+#ifdef Q_OS_WIN
+    // A byte far past the end, so reads of the file are never blocked
+    OVERLAPPED overlapped = {};
+    overlapped.OffsetHigh = 0x7fffffff;
+    const HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()));
+    return LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &overlapped);
+#elif defined(Q_OS_UNIX)
+    return ::flock(file.handle(), LOCK_EX | LOCK_NB) == 0;
+#else
+    Q_UNUSED(file);
+    return true;
+#endif
+}
+
+HistoryRing::HistoryRing()
+    : m_header(nullptr)
+    , m_records(nullptr)
+    , m_capacity(0)
+    , m_lastTimestampMs(0)
+    , m_readOnly(false)
+{
+}
+
+HistoryRing::~HistoryRing()
+{
+    close();
+}
+
+bool HistoryRing::open(const QString &path, quint32 tag, int capacity)
+{
+    close();
+    if (capacity <= 0) {
+        return false;
+    }
+    const qint64 fileSize = qint64(sizeof(Header)) + qint64(capacity) * qint64(sizeof(HistoryRecord));
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    if (!lockForWriting(m_file)) {
+        // Closing drops nothing of the other writer's
+        m_file.close();
+        qWarning() << path << "is written by another process, opening it read-only";
+        return openReadOnly(path, tag);
+    }
+
+    bool valid = m_file.size() == fileSize;
+    if (valid) {
+        Header existing;
+        valid = m_file.read(reinterpret_cast<char *>(&existing), sizeof(existing)) == sizeof(existing) &&
+                existing.magic == kMagic && existing.version == kVersion && existing.tag == tag &&
+                existing.recordSize == sizeof(HistoryRecord) && existing.capacity == quint32(capacity);
+    }
+    if (!valid) {
+        // Write every byte once so later appends never hit an unallocated page
+        m_file.resize(0);
+        m_file.seek(0);
+        Header header = {};
+        header.magic = kMagic;
+        header.version = kVersion;
+        header.tag = tag;
+        header.recordSize = sizeof(HistoryRecord);
+        header.capacity = quint32(capacity);
+        m_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        const QByteArray zeros(64 * 1024, '\0');
+        for (qint64 remaining = fileSize - qint64(sizeof(header)); remaining > 0; remaining -= zeros.size()) {
+            if (m_file.write(zeros.constData(), qMin<qint64>(remaining, zeros.size())) < 0) {
+                m_file.close();
+                return false;
+            }
+        }
+        m_file.flush();
+    }
+
+    m_readOnly = false;
+    return map(fileSize);
+}
+
+bool HistoryRing::openReadOnly(const QString &path, quint32 tag)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    Header existing;
+    if (m_file.read(reinterpret_cast<char *>(&existing), sizeof(existing)) != sizeof(existing) ||
+        existing.magic != kMagic || existing.version != kVersion || existing.tag != tag ||
+        existing.recordSize != sizeof(HistoryRecord) || existing.capacity == 0 ||
+        m_file.size() != qint64(sizeof(Header)) + qint64(existing.capacity) * qint64(sizeof(HistoryRecord))) {
+        m_file.close();
+        return false;
+    }
+    m_readOnly = true;
+    return map(m_file.size());
+}
+
+bool HistoryRing::map(qint64 fileSize)
+{
+    uchar *mapping = m_file.map(0, fileSize);
+    if (!mapping) {
+        m_file.close();
+        return false;
+    }
+    m_header = reinterpret_cast<Header *>(mapping);
+    m_records = reinterpret_cast<HistoryRecord *>(mapping + sizeof(Header));
+    m_capacity = int((fileSize - qint64(sizeof(Header))) / qint64(sizeof(HistoryRecord)));
+    const quint64 appended = m_header->appended.load(std::memory_order_relaxed);
+    m_lastTimestampMs = appended > 0 ? slot(appended - 1).timestampMs : 0;
+    return true;
+}
+
+void HistoryRing::close()
+{
+    if (m_header) {
+        m_file.unmap(reinterpret_cast<uchar *>(m_header));
+        m_header = nullptr;
+        m_records = nullptr;
+        m_capacity = 0;
+    }
+    m_file.close();
+}
+
+int HistoryRing::size() const
+{
+    if (!m_header) {
+        return 0;
+    }
+    return int(qMin<quint64>(m_header->appended.load(std::memory_order_acquire), quint64(m_capacity)));
+}
+
+void HistoryRing::append(const HistoryRecord &record)
+{
+    if (!m_header || m_readOnly) {
+        return;
+    }
+    const quint64 appended = m_header->appended.load(std::memory_order_relaxed);
+    if (record.timestampMs < m_lastTimestampMs) {
+        if (m_lastTimestampMs - record.timestampMs <= kClockStepMs) {
+            return;
+        }
+        qWarning() << "Clock stepped back" << (m_lastTimestampMs - record.timestampMs)
+                   << "ms, starting a new history epoch in" << m_file.fileName();
+        // Readers that see the new start also see the previous one
+        m_header->previousEpochStart.store(m_header->epochStart.load(std::memory_order_relaxed),
+                                           std::memory_order_relaxed);
+        m_header->epochStart.store(appended, std::memory_order_release);
+    }
+    std::memcpy(&m_records[appended % m_capacity], &record, sizeof(record));
+    m_header->appended.store(appended + 1, std::memory_order_release);
+    m_lastTimestampMs = record.timestampMs;
+}
+
+void HistoryRing::query(qint64 fromMs, qint64 toMs, QVector<HistoryRecord> &out) const
+{
+    if (!m_header || fromMs > toMs) {
+        return;
+    }
+    const quint64 appended = m_header->appended.load(std::memory_order_acquire);
+    const quint64 epochStart = qMin(m_header->epochStart.load(std::memory_order_acquire), appended);
+    const quint64 previousEpochStart = m_header->previousEpochStart.load(std::memory_order_relaxed);
+    // The writer may already be overwriting the oldest slot with record
+    // number appended, so the searches start one past it
+    const quint64 oldest = appended >= quint64(m_capacity) ? appended - m_capacity + 1 : 0;
+
+    // Each epoch is in time order; the previous one only counts up to
+    // where the current one begins, which keeps the result in order
+    quint64 previousBegin = qMax(oldest, previousEpochStart);
+    quint64 previousEnd = qMax(previousBegin, epochStart);
+    if (previousBegin < previousEnd && epochStart < appended) {
+        search(fromMs, qMin(toMs, slot(epochStart).timestampMs - 1), previousBegin, previousEnd);
+    } else if (previousBegin < previousEnd) {
+        search(fromMs, toMs, previousBegin, previousEnd);
+    }
+    quint64 begin = qMax(oldest, epochStart);
+    quint64 end = appended;
+    search(fromMs, toMs, begin, end);
+    const int previousCount = int(previousEnd - previousBegin);
+    if (previousCount == 0 && begin == end) {
+        return;
+    }
+
+    const int start = out.size();
+    out.resize(start + previousCount + int(end - begin));
+    for (quint64 i = previousBegin; i < previousEnd; ++i) {
+        out[start + int(i - previousBegin)] = slot(i);
+    }
+    for (quint64 i = begin; i < end; ++i) {
+        out[start + previousCount + int(i - begin)] = slot(i);
+    }
+
+    // The writer may have lapped the oldest records while they were copied;
+    // besides those it has finished, the slot of record number now may be
+    // half written. Both ranges were copied oldest first.
+    const quint64 now = m_header->appended.load(std::memory_order_acquire);
+    const quint64 stale = now + 1 > quint64(m_capacity) ? now + 1 - m_capacity : 0;
+    int dropped = 0;
+    if (stale > previousBegin) {
+        dropped += int(qMin(stale, previousEnd) - previousBegin);
+    }
+    if (stale > begin) {
+        dropped += int(qMin(stale, end) - begin);
+    }
+    out.remove(start, dropped);
+}
+
+void HistoryRing::search(qint64 fromMs, qint64 toMs, quint64 &begin, quint64 &end) const
+{
+    // Records are in time order, so both ends are binary searches
+    quint64 low = begin;
+    quint64 high = end;
+    while (low < high) {
+        const quint64 mid = low + (high - low) / 2;
+        if (slot(mid).timestampMs < fromMs) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    begin = low;
+    high = end;
+    while (low < high) {
+        const quint64 mid = low + (high - low) / 2;
+        if (slot(mid).timestampMs <= toMs) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    end = low;
+}
+
+bool HistoryStore::open(const QString &directory, int capacity)
+{
+    if (!QDir().mkpath(directory)) {
+        return false;
+    }
+    bool opened = true;
+    for (int family = 0; family < MetricFamilyCount; ++family) {
+        if (kFamilyFiles[family]) {
+            opened &= m_rings[family].open(QDir(directory).filePath(kFamilyFiles[family]),
+                                           quint32(family), capacity);
+        }
+    }
+    return opened;
+}
+
+bool HistoryStore::openReadOnly(const QString &directory)
+{
+    bool opened = false;
+    for (int family = 0; family < MetricFamilyCount; ++family) {
+        if (kFamilyFiles[family]) {
+            opened |= m_rings[family].openReadOnly(QDir(directory).filePath(kFamilyFiles[family]),
+                                                   quint32(family));
+        }
+    }
+    return opened;
+}
+
+void HistoryStore::close()
+{
+    for (HistoryRing &ring : m_rings) {
+        ring.close();
+    }
+}
+
+bool HistoryStore::isRecorded(MetricFamily family)
+{
+    return kFamilyFiles[family] != nullptr;
+}
+
+void HistoryStore::append(MetricFamily family, const HistoryRecord &record)
+{
+    m_rings[family].append(record);
+}
+
+void HistoryStore::query(MetricFamily family, qint64 fromMs, qint64 toMs, QVector<HistoryRecord> &out) const
+{
+    m_rings[family].query(fromMs, toMs, out);
+}
@@ -0,0 +1,142 @@
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+#include <atomic>
+#include "samplingscheduler.h"
+
+// Values stored per record; each recorded family defines its channels below
+constexpr int kHistoryChannels = 7;
+
+enum CpuHistoryChannel {
+    CpuUsageChannel, CpuUserChannel, CpuSystemChannel, CpuIowaitChannel,
+    CpuIrqChannel, CpuStealChannel, CpuHottestCoreChannel
+};
+enum MemoryHistoryChannel {
+    MemoryUsageChannel, MemoryUsedChannel, MemoryAvailableChannel, MemoryCachedChannel,
+    MemorySwapUsedChannel, MemorySwapPagesChannel, MemoryMajorFaultsChannel
+};
+enum NetworkHistoryChannel {
+    NetworkRxBytesChannel, NetworkTxBytesChannel, NetworkRxPacketsChannel,
+    NetworkTxPacketsChannel, NetworkDropsChannel, NetworkErrorsChannel
+};
+enum DiskIoHistoryChannel {
+    DiskReadBytesChannel, DiskWriteBytesChannel, DiskReadIopsChannel, DiskWriteIopsChannel,
+    DiskLatencyChannel, DiskQueueDepthChannel, DiskUtilizationChannel
+};
+
+// One sample of a family; unused channels are zero
+struct HistoryRecord {
+    qint64 timestampMs;
+    float values[kHistoryChannels];
+};
+
+/**
+ * @brief Fixed-size sample records in a memory-mapped ring file
+ *
+ * The file is a 64-byte header followed by capacity records and is fully
+ * allocated when created, so append() is a memcpy into the mapping and one
+ * atomic store of the record count: no syscalls per sample. The kernel
+ * writes dirty pages back on its own. Reopening an existing file only
+ * validates the header, so history is readable immediately after restart.
+ *
+ * One thread appends; query() may run concurrently on another thread and
+ * drops any records that were overwritten while it was copying them. Only
+ * one process writes a file: open() takes an exclusive lock on it and
+ * falls back to read-only mapping while another process holds the lock.
+ *
+ * Records are kept in time order. When the wall clock steps back by more
+ * than a minute, a new epoch starts with the next record; the epoch
+ * before it stays queryable up to where the new one begins, older ones
+ * are dropped. Smaller steps back drop the records until the clock has
+ * caught up again.
+ */
+class HistoryRing
+{
+public:
+    HistoryRing();
+    ~HistoryRing();
+
+    HistoryRing(const HistoryRing &) = delete;
+    HistoryRing &operator=(const HistoryRing &) = delete;
+
+    // Maps path, creating or recreating it if its layout does not match;
+    // read-only if another process is writing it
+    bool open(const QString &path, quint32 tag, int capacity);
+    // Maps an existing file for queries only, whatever its capacity
+    bool openReadOnly(const QString &path, quint32 tag);
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+    bool isReadOnly() const { return m_readOnly; }
+
+    int capacity() const { return m_capacity; }
+    int size() const;
+
+    // Records must arrive in time order; see the class doc for older ones
+    void append(const HistoryRecord &record);
+
+    // Appends the records with fromMs <= timestamp <= toMs to out, oldest first
+    void query(qint64 fromMs, qint64 toMs, QVector<HistoryRecord> &out) const;
+
+private:
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint32 tag;
+        quint32 recordSize;
+        quint32 capacity;
+        quint32 reserved;
+        // Records ever appended; the next one goes to slot appended % capacity
+        std::atomic<quint64> appended;
+        // First records of the current and the previous epoch
+        std::atomic<quint64> epochStart;
+        std::atomic<quint64> previousEpochStart;
+        char padding[16];
+    };
+    static_assert(sizeof(Header) == 64, "the file header layout is fixed");
+    static_assert(std::atomic<quint64>::is_always_lock_free, "the record count lives in shared memory");
+
+    const HistoryRecord &slot(quint64 index) const { return m_records[index % m_capacity]; }
+    bool map(qint64 fileSize);
+    // Narrows [begin, end) to the records with fromMs <= timestamp <= toMs;
+    // the records in it must be in time order
+    void search(qint64 fromMs, qint64 toMs, quint64 &begin, quint64 &end) const;
+
+    QFile m_file;
+    Header *m_header;
+    HistoryRecord *m_records;
+    int m_capacity;
+    qint64 m_lastTimestampMs;
+    bool m_readOnly;
+};
+
+/**
+ * @brief One HistoryRing per recorded metric family, under one directory
+ *
+ * CPU, memory, network and disk I/O are recorded; the process table and
+ * disk capacity have no fixed-size representation and are not.
+ */
+class HistoryStore
+{
+public:
+    // A day at one sample per second
+    static constexpr int kDefaultCapacity = 86400;
+
+    bool open(const QString &directory, int capacity = kDefaultCapacity);
+    // For tools reading another process's history; never modifies the files
+    bool openReadOnly(const QString &directory);
+    void close();
+
+    static bool isRecorded(MetricFamily family);
+
+    void append(MetricFamily family, const HistoryRecord &record);
+    void query(MetricFamily family, qint64 fromMs, qint64 toMs, QVector<HistoryRecord> &out) const;
+
+private:
+    HistoryRing m_rings[MetricFamilyCount];
+};
+
+#endif // HISTORYSTORE_H
@@ -0,0 +1,213 @@
+#include "instrumentation.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace Instrumentation {
+    std::atomic<bool> active(false);
+
+    static ProbeStats probes[ProbeCount];
+    // Set by reset(), cleared by the probe's writer once it has reset
+    static std::atomic<bool> resetPending[ProbeCount];
+
+    // Heap allocations of the current thread while enabled; plain data, so
+    // that touching it from inside operator new needs no TLS initialisation
+    static thread_local quint64 allocationCount = 0;
+    // CPU time helper threads reported for the current thread, in ns
+    static thread_local qint64 helperCpuNs = 0;
+
+    static inline void countAllocation() {
+        if (active.load(std::memory_order_relaxed)) {
+            ++allocationCount;
+        }
+    }
+
+    static qint64 wallNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    qint64 threadCpuNs() {
+#ifdef Q_OS_WIN
+        FILETIME creation, exit, kernel, user;
+        if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+            return 0;
+        }
+        // 100 ns units
+        const quint64 kernelTicks = (quint64(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+        const quint64 userTicks = (quint64(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+        return qint64(kernelTicks + userTicks) * 100;
+#else
+        struct timespec now;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) {
+            return 0;
+        }
+        return qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif
+    }
+
+    qint64 processCpuNs() {
+#ifdef Q_OS_WIN
+        FILETIME creation, exit, kernel, user;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+            return 0;
+        }
+        const quint64 kernelTicks = (quint64(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+        const quint64 userTicks = (quint64(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+        return qint64(kernelTicks + userTicks) * 100;
+#else
+        struct timespec now;
+        if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now) != 0) {
+            return 0;
+        }
+        return qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif
+    }
+
+    void addHelperCpuNs(qint64 ns) {
+        helperCpuNs += ns;
+    }
+
+    void setEnabled(bool enabled) {
+        active.store(enabled, std::memory_order_relaxed);
+    }
+
+    void reset() {
+        for (std::atomic<bool> &pending : resetPending) {
+            pending.store(true, std::memory_order_release);
+        }
+    }
+
+    const char *probeName(Probe probe) {
+        static const char *const names[ProbeCount] = {
+            "getCpuInfo", "getMemoryInfo", "getDiskInfo", "getDiskIoStats", "getInterfaceStats",
+            "getProcesses", "rankProcesses", "getProcessDetails", "collect", "updateData"
+        };
+        return names[probe];
+    }
+
+    const ProbeStats &stats(Probe probe) {
+        return probes[probe];
+    }
+
+    static QJsonObject histogramJson(const LogHistogram &histogram) {
+        QJsonObject result;
+        result["mean"] = histogram.mean();
+        result["min"] = double(histogram.min());
+        result["p50"] = double(histogram.percentile(50.0));
+        result["p90"] = double(histogram.percentile(90.0));
+        result["p99"] = double(histogram.percentile(99.0));
+        result["max"] = double(histogram.max());
+        return result;
+    }
+
+    QJsonObject toJson() {
+        QJsonObject probeObjects;
+        for (int i = 0; i < ProbeCount; ++i) {
+            const ProbeStats &probe = probes[i];
+            QJsonObject object;
+            object["count"] = double(probe.wallNs.count());
+            object["wall_ns"] = histogramJson(probe.wallNs);
+            object["cpu_ns"] = histogramJson(probe.cpuNs);
+            object["operator_new_calls"] = histogramJson(probe.allocations);
+            probeObjects[probeName(Probe(i))] = object;
+        }
+        QJsonObject report;
+        report["enabled"] = isEnabled();
+        report["operator_new_counted"] = countsAllocations();
+        report["probes"] = probeObjects;
+        return report;
+    }
+
+    bool writeJson(const QString &path) {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            return false;
+        }
+        const QByteArray json = QJsonDocument(toJson()).toJson();
+        return file.write(json) == json.size();
+    }
+
+    void Scope::begin() {
+        m_allocations = allocationCount;
+        m_helperCpuNs = helperCpuNs;
+        m_cpuNs = threadCpuNs();
+        m_wallNs = wallNs();
+    }
+
+    void Scope::end() {
+        const qint64 wall = wallNs() - m_wallNs;
+        const qint64 cpu = threadCpuNs() - m_cpuNs + helperCpuNs - m_helperCpuNs;
+        ProbeStats &probe = probes[m_probe];
+        std::atomic<bool> &pending = resetPending[m_probe];
+        if (pending.load(std::memory_order_relaxed) && pending.exchange(false, std::memory_order_acquire)) {
+            probe.wallNs.reset();
+            probe.cpuNs.reset();
+            probe.allocations.reset();
+        }
+        probe.wallNs.record(quint64(qMax<qint64>(0, wall)));
+        probe.cpuNs.record(quint64(qMax<qint64>(0, cpu)));
+        if (countsAllocations()) {
+            probe.allocations.record(allocationCount - m_allocations);
+        }
+    }
+} // namespace Instrumentation
+
+#ifdef SYSTEMMONITOR_COUNT_ALLOCATIONS
+// Replaces the global allocation functions of every binary linking the
+// core, so only builds that ask for it get them. Deletes are replaced
+// alongside, so every pair stays on malloc() and free(); the aligned
+// forms are left to the library as a pair of their own.
+void *operator new(std::size_t size)
+{
+    Instrumentation::countAllocation();
+    if (void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    Instrumentation::countAllocation();
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+    return ::operator new(size, tag);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
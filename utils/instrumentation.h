@@ -0,0 +1,119 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+#include "loghistogram.h"
+
+/**
+ * @brief What the monitor itself costs, per collector and per tick
+ *
+ * A Scope around a collector call records its wall time, its CPU time and
+ * the number of operator new calls the calling thread made into one
+ * LogHistogram each. The CPU time is the calling thread's plus whatever
+ * helper threads reported for it through addHelperCpuNs(), as the
+ * parallel process scan does.
+ *
+ * operator new calls are only counted in builds configured with
+ * SYSTEMMONITOR_COUNT_ALLOCATIONS, which replaces the global operator new
+ * and delete. They are not all heap allocations: Qt's containers and
+ * strings allocate with malloc() and are not included, and neither are
+ * the calls made on the process scan's worker threads.
+ *
+ * Every probe's histograms have a single writer, the thread its Scopes
+ * run on. reset() only flags them; each writer clears its own before it
+ * next records.
+ *
+ * Instrumentation starts disabled. While disabled, a Scope costs one
+ * relaxed load and a predictable branch, and so does every counted
+ * allocation.
+ */
+namespace Instrumentation {
+    enum Probe {
+        CpuProbe,
+        MemoryProbe,
+        DiskProbe,
+        DiskIoProbe,
+        InterfaceProbe,
+        ProcessProbe,
+        RankProbe,          // top-N selection over the process table
+        ProcessDetailProbe, // detail fields of the watched processes
+        CollectProbe,       // a whole SampleCollector pass, publishing included
+        UpdateDataProbe,    // a snapshot reaching the views, on the GUI thread
+        ProbeCount
+    };
+
+    struct ProbeStats {
+        LogHistogram wallNs;
+        LogHistogram cpuNs;
+        LogHistogram allocations;
+    };
+
+    extern std::atomic<bool> active;
+    inline bool isEnabled() { return active.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+    // From any thread; takes effect at each probe's next record
+    void reset();
+    // Whether this build counts allocations at all
+    constexpr bool countsAllocations() {
+#ifdef SYSTEMMONITOR_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // CPU time of the whole process, all threads, in ns; 0 if unavailable
+    qint64 processCpuNs();
+    // CPU time of the calling thread in ns; 0 if unavailable
+    qint64 threadCpuNs();
+    // Adds CPU time that helper threads spent on the calling thread's
+    // behalf to the Scopes open on it
+    void addHelperCpuNs(qint64 ns);
+
+    const char *probeName(Probe probe);
+    const ProbeStats &stats(Probe probe);
+
+    // Every probe's count, mean, min, max and p50/p90/p99, in ns for the
+    // times
+    QJsonObject toJson();
+    bool writeJson(const QString &path);
+
+    // Records the enclosed block into probe's histograms
+    class Scope
+    {
+    public:
+        explicit Scope(Probe probe)
+            : m_probe(probe)
+            , m_active(isEnabled())
+        {
+            if (m_active) {
+                begin();
+            }
+        }
+        ~Scope()
+        {
+            if (m_active) {
+                end();
+            }
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        void begin();
+        void end();
+
+        Probe m_probe;
+        bool m_active;
+        qint64 m_wallNs = 0;
+        qint64 m_cpuNs = 0;
+        qint64 m_helperCpuNs = 0;
+        quint64 m_allocations = 0;
+    };
+}
+
+#endif // INSTRUMENTATION_H
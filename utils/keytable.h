@@ -0,0 +1,95 @@
+#ifndef KEYTABLE_H
+#define KEYTABLE_H
+
+#include <QtGlobal>
+
+namespace KeyTableDetail {
+    constexpr quint32 hash(const char *key, int length, quint32 seed) {
+        // FNV-1a, seeded so the table can search for a collision-free variant
+        quint32 h = 2166136261u ^ seed;
+        for (int i = 0; i < length; ++i) {
+            h ^= static_cast<quint8>(key[i]);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    constexpr int length(const char *key) {
+        int n = 0;
+        while (key[n] != '\0') {
+            ++n;
+        }
+        return n;
+    }
+}
+
+/**
+ * @brief Perfect hash table over a fixed set of keys, built at compile time
+ *
+ * The constructor searches for a seed under which every key lands in its
+ * own slot, so a lookup is one hash and one slot probe. Slots store the
+ * full 32-bit hash and the key length, which is enough to reject keys
+ * that are not in the table without comparing strings.
+ *
+ * Use it as a constexpr object and static_assert(table.isValid()).
+ */
+template <int KeyCount, int SlotCount>
+class KeyTable
+{
+    static_assert((SlotCount & (SlotCount - 1)) == 0, "SlotCount must be a power of two");
+    static_assert(SlotCount >= KeyCount, "SlotCount must fit every key");
+
+public:
+    constexpr explicit KeyTable(const char *const (&keys)[KeyCount])
+        : m_seed(kNoSeed)
+        , m_slots{}
+    {
+        for (quint32 seed = 0; seed < kMaxSeed && m_seed == kNoSeed; ++seed) {
+            if (fill(keys, seed)) {
+                m_seed = seed;
+            }
+        }
+    }
+
+    constexpr bool isValid() const { return m_seed != kNoSeed; }
+
+    // Index of the key in the constructor's array, or -1
+    constexpr int find(const char *key, int length) const {
+        const quint32 h = KeyTableDetail::hash(key, length, m_seed);
+        const Slot &slot = m_slots[h & (SlotCount - 1)];
+        return slot.id != 0 && slot.hash == h && slot.length == length ? slot.id - 1 : -1;
+    }
+
+private:
+    struct Slot {
+        quint32 hash = 0;
+        int length = 0;
+        int id = 0; // key index + 1, 0 for an empty slot
+    };
+
+    static constexpr quint32 kNoSeed = 0xffffffffu;
+    static constexpr quint32 kMaxSeed = 4096;
+
+    constexpr bool fill(const char *const (&keys)[KeyCount], quint32 seed) {
+        for (Slot &slot : m_slots) {
+            slot = Slot();
+        }
+        for (int i = 0; i < KeyCount; ++i) {
+            const int length = KeyTableDetail::length(keys[i]);
+            const quint32 h = KeyTableDetail::hash(keys[i], length, seed);
+            Slot &slot = m_slots[h & (SlotCount - 1)];
+            if (slot.id != 0) {
+                return false;
+            }
+            slot.hash = h;
+            slot.length = length;
+            slot.id = i + 1;
+        }
+        return true;
+    }
+
+    quint32 m_seed;
+    Slot m_slots[SlotCount];
+};
+
+#endif // KEYTABLE_H
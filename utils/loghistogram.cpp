@@ -0,0 +1,88 @@
+#include "loghistogram.h"
+#include <QtAlgorithms>
+
+LogHistogram::LogHistogram()
+{
+    reset();
+}
+
+int LogHistogram::bucketOf(quint64 value)
+{
+    if (value < quint64(kSubBucketCount)) {
+        return int(value);
+    }
+    // Keep the top kSubBucketBits bits; the leading one is implied
+    const int shift = (63 - int(qCountLeadingZeroBits(value))) - (kSubBucketBits - 1);
+    return kSubBucketCount + (shift - 1) * kHalfCount + int((value >> shift) - kHalfCount);
+}
+
+quint64 LogHistogram::bucketUpperBound(int bucket)
+{
+    if (bucket < kSubBucketCount) {
+        return quint64(bucket);
+    }
+    const int shift = (bucket - kSubBucketCount) / kHalfCount + 1;
+    const quint64 sub = quint64((bucket - kSubBucketCount) % kHalfCount + kHalfCount);
+    // For the last bucket this wraps to exactly the top of the range
+    return ((sub + 1) << shift) - 1;
+}
+
+void LogHistogram::record(quint64 value)
+{
+    // Single writer: plain load and store are enough, and cheaper than
+    // read-modify-write instructions
+    std::atomic<quint32> &bucket = m_buckets[bucketOf(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_sum.store(m_sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if (value < m_min.load(std::memory_order_relaxed)) {
+        m_min.store(value, std::memory_order_relaxed);
+    }
+    if (value > m_max.load(std::memory_order_relaxed)) {
+        m_max.store(value, std::memory_order_relaxed);
+    }
+}
+
+void LogHistogram::reset()
+{
+    for (std::atomic<quint32> &bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(~quint64(0), std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+quint64 LogHistogram::min() const
+{
+    return count() > 0 ? m_min.load(std::memory_order_relaxed) : 0;
+}
+
+double LogHistogram::mean() const
+{
+    const quint64 n = count();
+    return n > 0 ? double(m_sum.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+quint64 LogHistogram::percentile(double percent) const
+{
+    // Totals from the buckets themselves, so a concurrent record() cannot
+    // push the rank past the end
+    quint64 total = 0;
+    for (const std::atomic<quint32> &bucket : m_buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const quint64 rank = qMax<quint64>(1, quint64(qBound(0.0, percent, 100.0) / 100.0 * total + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return qMin(bucketUpperBound(i), max());
+        }
+    }
+    return max();
+}
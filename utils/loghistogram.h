@@ -0,0 +1,51 @@
+#ifndef LOGHISTOGRAM_H
+#define LOGHISTOGRAM_H
+
+#include <QtGlobal>
+#include <atomic>
+
+/**
+ * @brief Fixed-size log-linear histogram in the style of HdrHistogram
+ *
+ * Values below 32 get a bucket each; above that every power of two is
+ * split into 16 linear buckets, so any recorded value is known to within
+ * about 6% over the whole 64-bit range, in under 4 KB. Recording is a
+ * count-leading-zeros, a shift and a few relaxed atomic stores and never
+ * allocates.
+ *
+ * One thread records, any number of threads may read; readers see a
+ * consistent enough picture for percentiles, not an exact snapshot.
+ */
+class LogHistogram
+{
+public:
+    static constexpr int kSubBucketBits = 5;
+    static constexpr int kSubBucketCount = 1 << kSubBucketBits;
+    static constexpr int kHalfCount = kSubBucketCount / 2;
+    static constexpr int kBucketCount = kSubBucketCount + (64 - kSubBucketBits) * kHalfCount;
+
+    LogHistogram();
+
+    void record(quint64 value);
+    void reset();
+
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    quint64 min() const;
+    quint64 max() const { return m_max.load(std::memory_order_relaxed); }
+    double mean() const;
+    // Value at or below which percent (0-100) of the recorded values lie,
+    // as the upper end of its bucket, never above max()
+    quint64 percentile(double percent) const;
+
+    static int bucketOf(quint64 value);
+    static quint64 bucketUpperBound(int bucket);
+
+private:
+    std::atomic<quint32> m_buckets[kBucketCount];
+    std::atomic<quint64> m_count;
+    std::atomic<quint64> m_sum;
+    std::atomic<quint64> m_min;
+    std::atomic<quint64> m_max;
+};
+
+#endif // LOGHISTOGRAM_H
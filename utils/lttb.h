@@ -0,0 +1,76 @@
+#ifndef LTTB_H
+#define LTTB_H
+
+#include <QPointF>
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * @brief Largest-Triangle-Three-Buckets downsampling
+ *
+ * Reduces the points source(first) .. source(last - 1) to at most
+ * threshold points. The first and last points are kept; in between, each
+ * bucket contributes the point that forms the largest triangle with the
+ * previously chosen point and the average of the next bucket, which keeps
+ * spikes that plain averaging or striding would drop.
+ *
+ * source is any callable mapping an index to a QPointF with increasing x.
+ */
+template <typename Source>
+void decimateLttb(const Source &source, int first, int last, int threshold, QVector<QPointF> &out)
+{
+    out.resize(0);
+    const int count = last - first;
+    if (count <= 0) {
+        return;
+    }
+    if (threshold < 3 || count <= threshold) {
+        out.reserve(count);
+        for (int i = first; i < last; ++i) {
+            out.append(source(i));
+        }
+        return;
+    }
+
+    out.reserve(threshold);
+    // Interior points are split into threshold - 2 buckets
+    const double bucketSize = double(count - 2) / (threshold - 2);
+    QPointF selected = source(first);
+    out.append(selected);
+
+    for (int bucket = 0; bucket < threshold - 2; ++bucket) {
+        const int begin = first + 1 + int(bucket * bucketSize);
+        const int end = first + 1 + int((bucket + 1) * bucketSize);
+
+        // Average of the following bucket, or the last point for the final one
+        const int nextBegin = end;
+        const int nextEnd = qMin(first + 1 + int((bucket + 2) * bucketSize), last - 1);
+        QPointF average;
+        if (nextBegin < nextEnd) {
+            for (int i = nextBegin; i < nextEnd; ++i) {
+                average += source(i);
+            }
+            average /= nextEnd - nextBegin;
+        } else {
+            average = source(last - 1);
+        }
+
+        double largestArea = -1.0;
+        int chosen = begin;
+        for (int i = begin; i < end; ++i) {
+            const QPointF point = source(i);
+            // Twice the triangle area; only the ordering matters
+            const double area = qAbs((selected.x() - average.x()) * (point.y() - selected.y()) -
+                                     (selected.x() - point.x()) * (average.y() - selected.y()));
+            if (area > largestArea) {
+                largestArea = area;
+                chosen = i;
+            }
+        }
+        selected = source(chosen);
+        out.append(selected);
+    }
+    out.append(source(last - 1));
+}
+
+#endif // LTTB_H
@@ -0,0 +1,96 @@
+#include "metrichistory.h"
+#include <QMutexLocker>
+
+// How often expired blocks and series are looked for
+static constexpr qint64 kDiscardIntervalMs = 60 * 1000;
+
+MetricHistory::MetricHistory(qint64 retentionMs)
+    : m_retentionMs(retentionMs)
+    , m_lastDiscardMs(0)
+{
+}
+
+void MetricHistory::setRetention(qint64 retentionMs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_retentionMs = retentionMs;
+    m_lastDiscardMs = 0;
+}
+
+void MetricHistory::append(qint64 timestampMs, const QVector<MetricSample> &samples)
+{
+    QMutexLocker locker(&m_mutex);
+    for (const MetricSample &sample : samples) {
+        m_series[sample.series].append(timestampMs, sample.value);
+    }
+    if (timestampMs - m_lastDiscardMs >= kDiscardIntervalMs) {
+        discardExpired(timestampMs);
+        m_lastDiscardMs = timestampMs;
+    }
+}
+
+void MetricHistory::remove(const QVector<QString> &series)
+{
+    QMutexLocker locker(&m_mutex);
+    for (const QString &name : series) {
+        m_series.remove(name);
+    }
+}
+
+void MetricHistory::discardExpired(qint64 nowMs)
+{
+    const qint64 cutoff = nowMs - m_retentionMs;
+    for (auto it = m_series.begin(); it != m_series.end();) {
+        if (it.value().lastTimestamp() < cutoff) {
+            it = m_series.erase(it);
+        } else {
+            it.value().discardBefore(cutoff);
+            ++it;
+        }
+    }
+}
+
+QVector<QPointF> MetricHistory::query(const QString &series, qint64 fromMs, qint64 toMs) const
+{
+    QVector<QPointF> points;
+    QMutexLocker locker(&m_mutex);
+    const auto found = m_series.constFind(series);
+    if (found == m_series.constEnd()) {
+        return points;
+    }
+    CompressedSeries::ConstIterator it = found.value().from(fromMs);
+    qint64 timestampMs;
+    double value;
+    while (it.next(timestampMs, value) && timestampMs <= toMs) {
+        if (timestampMs >= fromMs) {
+            points.append(QPointF(timestampMs, value));
+        }
+    }
+    return points;
+}
+
+QStringList MetricHistory::seriesNames() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_series.keys();
+}
+
+int MetricHistory::sampleCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    int count = 0;
+    for (const CompressedSeries &series : m_series) {
+        count += series.size();
+    }
+    return count;
+}
+
+qint64 MetricHistory::byteSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 bytes = 0;
+    for (auto it = m_series.constBegin(); it != m_series.constEnd(); ++it) {
+        bytes += it.value().byteSize() + it.key().size() * qint64(sizeof(QChar));
+    }
+    return bytes;
+}
@@ -0,0 +1,59 @@
+#ifndef METRICHISTORY_H
+#define METRICHISTORY_H
+
+#include <QHash>
+#include <QMutex>
+#include <QPointF>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "compressedseries.h"
+
+// One value of a named series, e.g. "cpu.core3" or "net.eth0.rx"
+struct MetricSample {
+    QString series;
+    double value;
+};
+
+/**
+ * @brief In-memory retained history of every sampled metric
+ *
+ * Each named series is a CompressedSeries, so a day of 1 Hz samples for
+ * hundreds of series fits in a few megabytes. Series that stop receiving
+ * samples (an interface goes away) are dropped once their newest sample
+ * falls out of the retention window; series known to be finished, such
+ * as those of a process that left the ranking, are removed right away.
+ *
+ * The collector appends from its thread while the GUI queries from its
+ * own; both take the same mutex, held for one batch or one query.
+ */
+class MetricHistory
+{
+public:
+    static constexpr qint64 kDefaultRetentionMs = 24 * 3600 * 1000LL;
+
+    explicit MetricHistory(qint64 retentionMs = kDefaultRetentionMs);
+
+    void setRetention(qint64 retentionMs);
+
+    // Appends one sample per entry, all taken at timestampMs
+    void append(qint64 timestampMs, const QVector<MetricSample> &samples);
+    void remove(const QVector<QString> &series);
+
+    // Samples of series with fromMs <= x <= toMs; x is ms since epoch
+    QVector<QPointF> query(const QString &series, qint64 fromMs, qint64 toMs) const;
+    QStringList seriesNames() const;
+
+    int sampleCount() const;
+    qint64 byteSize() const;
+
+private:
+    void discardExpired(qint64 nowMs);
+
+    mutable QMutex m_mutex;
+    QHash<QString, CompressedSeries> m_series;
+    qint64 m_retentionMs;
+    qint64 m_lastDiscardMs;
+};
+
+#endif // METRICHISTORY_H
@@ -0,0 +1,44 @@
+#ifndef MOUNTTABLE_H
+#define MOUNTTABLE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "procreader.h"
+
+/**
+ * @brief Filtered list of real filesystems, rebuilt only when mounts change
+ *
+ * /proc/self/mounts stays open and is polled for POLLPRI, which the kernel
+ * raises whenever the mount namespace changes. Pseudo filesystems,
+ * read-only and empty mounts and further mounts of an already listed
+ * filesystem (bind mounts) are dropped once per rebuild, so a sample only
+ * has to statvfs() the mounts that survive.
+ */
+class MountTable
+{
+public:
+    struct Mount {
+        QByteArray path; // mount point under ProcReader::root(), for statvfs()
+        QString device;
+        QString mountPoint;
+        QString fileSystem;
+    };
+
+    MountTable();
+
+    // Rebuilds the table if the kernel reported a change; true if it did
+    bool refresh();
+
+    const QVector<Mount> &mounts() const { return m_mounts; }
+
+private:
+    bool changed();
+    void rebuild();
+
+    ProcFile m_file;
+    bool m_built;
+    QVector<Mount> m_mounts;
+};
+
+#endif // MOUNTTABLE_H
@@ -0,0 +1,114 @@
+#ifdef __linux__
+
+#include "mounttable.h"
+#include "proccapture.h"
+#include <QSet>
+#include <poll.h>
+#include <sys/statvfs.h>
+
+// Undoes the octal escaping (\040 for space etc.) of /proc/self/mounts
+static QByteArray unescapeMountField(const char *begin, int length)
+{
+    QByteArray result;
+    result.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        if (begin[i] == '\\' && i + 3 < length) {
+            result.append(static_cast<char>(((begin[i + 1] - '0') << 6) |
+                                            ((begin[i + 2] - '0') << 3) |
+                                            (begin[i + 3] - '0')));
+            i += 3;
+        } else {
+            result.append(begin[i]);
+        }
+    }
+    return result;
+}
+
+// Filesystems that never hold user data
+static bool isPseudoFileSystem(const char *fsType, int length)
+{
+    const QByteArray fs = QByteArray::fromRawData(fsType, length);
+    return fs.startsWith("tmpfs") || fs.startsWith("devtmpfs") ||
+           fs.startsWith("proc") || fs.startsWith("sys");
+}
+
+MountTable::MountTable()
+    : m_file("/proc/self/mounts")
+    , m_built(false)
+{
+}
+
+bool MountTable::refresh()
+{
+    if (m_built && !changed()) {
+        return false;
+    }
+    rebuild();
+    return true;
+}
+
+bool MountTable::changed()
+{
+    // The file is only in a frame when the recorded table rebuilt
+    if (ProcCapture::isReplaying()) {
+        return ProcCapture::contains(m_file.name());
+    }
+    if (m_file.descriptor() < 0) {
+        return true;
+    }
+    // The kernel flags POLLPRI (and POLLERR) once per mount namespace
+    // change; polling acknowledges it
+    struct pollfd pfd = { m_file.descriptor(), POLLPRI, 0 };
+    if (::poll(&pfd, 1, 0) <= 0) {
+        return false;
+    }
+    return pfd.revents & (POLLPRI | POLLERR);
+}
+
+void MountTable::rebuild()
+{
+    m_mounts.resize(0);
+    m_built = m_file.read();
+    if (!m_built) {
+        return;
+    }
+
+    // Bind mounts and repeated mounts of one filesystem share an fsid
+    QSet<quint64> seenFileSystems;
+    // Each line: device mountpoint fstype options dump pass
+    ProcScanner scanner(m_file.data(), m_file.size());
+    for (; !scanner.atEnd(); scanner.nextLine()) {
+        const char *device, *mountPoint, *fsType;
+        int deviceLength, mountPointLength, fsTypeLength;
+        if (!scanner.readToken(device, deviceLength) ||
+            !scanner.readToken(mountPoint, mountPointLength) ||
+            !scanner.readToken(fsType, fsTypeLength)) {
+            continue;
+        }
+        if (isPseudoFileSystem(fsType, fsTypeLength)) {
+            continue;
+        }
+        Mount mount;
+        const QByteArray mountPath = unescapeMountField(mountPoint, mountPointLength);
+        mount.path = QByteArray(ProcReader::root()) + mountPath;
+        struct statvfs vfs;
+        if (!ProcReader::statFileSystem(mount.path, vfs) || (vfs.f_flag & ST_RDONLY) ||
+            vfs.f_blocks == 0) {
+            continue;
+        }
+        // Some filesystems report no fsid at all, those are always kept
+        const quint64 fsid = vfs.f_fsid;
+        if (fsid != 0) {
+            if (seenFileSystems.contains(fsid)) {
+                continue;
+            }
+            seenFileSystems.insert(fsid);
+        }
+        mount.device = QString::fromUtf8(unescapeMountField(device, deviceLength));
+        mount.mountPoint = QString::fromUtf8(mountPath);
+        mount.fileSystem = QString::fromLatin1(fsType, fsTypeLength);
+        m_mounts.append(mount);
+    }
+}
+
+#endif // __linux__
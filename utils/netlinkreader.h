@@ -0,0 +1,53 @@
+#ifndef NETLINKREADER_H
+#define NETLINKREADER_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QtGlobal>
+
+// Raw counters of one network interface, as reported by the kernel
+struct LinkCounters {
+    int index;
+    bool loopback;
+    bool up;
+    char name[16]; // IFNAMSIZ, NUL terminated
+    quint64 rxBytes;
+    quint64 txBytes;
+    quint64 rxPackets;
+    quint64 txPackets;
+    quint64 rxErrors;
+    quint64 txErrors;
+    quint64 rxDropped;
+    quint64 txDropped;
+};
+
+/**
+ * @brief Dumps interface counters over rtnetlink
+ *
+ * Sends one RTM_GETLINK dump request per call on a socket that stays open
+ * and reads IFLA_STATS64 straight out of the binary replies, so there is
+ * no text to parse and the counters are always 64 bits wide.
+ */
+class NetlinkReader
+{
+public:
+    NetlinkReader();
+    ~NetlinkReader();
+
+    NetlinkReader(const NetlinkReader &) = delete;
+    NetlinkReader &operator=(const NetlinkReader &) = delete;
+
+    // Replaces links with the current counters; false if netlink is unusable
+    bool dumpLinks(QVector<LinkCounters> &links);
+
+private:
+    bool requestLinks(QVector<LinkCounters> &links);
+    bool open();
+    void close();
+
+    int m_fd;
+    quint32 m_sequence;
+    QByteArray m_buffer;
+};
+
+#endif // NETLINKREADER_H
@@ -0,0 +1,157 @@
+#ifdef __linux__
+
+#include "netlinkreader.h"
+#include "proccapture.h"
+#include <cerrno>
+#include <cstring>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Large enough for a few hundred interfaces per recv()
+static constexpr int kReceiveBufferSize = 64 * 1024;
+
+NetlinkReader::NetlinkReader()
+    : m_fd(-1)
+    , m_sequence(0)
+{
+}
+
+NetlinkReader::~NetlinkReader()
+{
+    close();
+}
+
+bool NetlinkReader::open()
+{
+    if (m_fd >= 0) {
+        return true;
+    }
+    m_fd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (m_fd < 0) {
+        return false;
+    }
+    struct sockaddr_nl local = {};
+    local.nl_family = AF_NETLINK;
+    if (::bind(m_fd, reinterpret_cast<struct sockaddr *>(&local), sizeof(local)) != 0) {
+        close();
+        return false;
+    }
+    m_buffer.resize(kReceiveBufferSize);
+    return true;
+}
+
+void NetlinkReader::close()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+// Captures hold the parsed counters, not the netlink messages
+static const QByteArray kLinksKey("netlink:links");
+
+bool NetlinkReader::dumpLinks(QVector<LinkCounters> &links)
+{
+    if (ProcCapture::isReplaying()) {
+        QByteArray data;
+        const bool ok = ProcCapture::replay(kLinksKey, data);
+        links.resize(data.size() / int(sizeof(LinkCounters)));
+        std::memcpy(links.data(), data.constData(), links.size() * sizeof(LinkCounters));
+        return ok;
+    }
+    const bool ok = requestLinks(links);
+    if (ProcCapture::isRecording()) {
+        ProcCapture::record(kLinksKey, ok, reinterpret_cast<const char *>(links.constData()),
+                            ok ? links.size() * int(sizeof(LinkCounters)) : 0);
+    }
+    return ok;
+}
+
+bool NetlinkReader::requestLinks(QVector<LinkCounters> &links)
+{
+    links.resize(0);
+    if (!open()) {
+        return false;
+    }
+
+    struct {
+        struct nlmsghdr header;
+        struct ifinfomsg info;
+    } request = {};
+    request.header.nlmsg_len = sizeof(request);
+    request.header.nlmsg_type = RTM_GETLINK;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++m_sequence;
+    request.info.ifi_family = AF_UNSPEC;
+    if (::send(m_fd, &request, sizeof(request), 0) < 0) {
+        close();
+        return false;
+    }
+
+    for (;;) {
+        const ssize_t received = ::recv(m_fd, m_buffer.data(), m_buffer.size(), 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Leave the socket in a clean state for the next dump
+            close();
+            return false;
+        }
+        int remaining = static_cast<int>(received);
+        for (const struct nlmsghdr *header = reinterpret_cast<const struct nlmsghdr *>(m_buffer.constData());
+             NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_seq != m_sequence) {
+                continue; // Left over from an interrupted dump
+            }
+            if (header->nlmsg_type == NLMSG_DONE) {
+                return true;
+            }
+            if (header->nlmsg_type == NLMSG_ERROR) {
+                close();
+                return false;
+            }
+            if (header->nlmsg_type != RTM_NEWLINK) {
+                continue;
+            }
+
+            const struct ifinfomsg *info = static_cast<const struct ifinfomsg *>(NLMSG_DATA(header));
+            LinkCounters link = {};
+            link.index = info->ifi_index;
+            link.loopback = info->ifi_flags & IFF_LOOPBACK;
+            link.up = info->ifi_flags & IFF_UP;
+            bool hasStats = false;
+            int attributeLength = IFLA_PAYLOAD(header);
+            for (const struct rtattr *attribute = IFLA_RTA(info); RTA_OK(attribute, attributeLength);
+                 attribute = RTA_NEXT(attribute, attributeLength)) {
+                if (attribute->rta_type == IFLA_IFNAME) {
+                    qstrncpy(link.name, static_cast<const char *>(RTA_DATA(attribute)), sizeof(link.name));
+                } else if (attribute->rta_type == IFLA_STATS64 &&
+                           RTA_PAYLOAD(attribute) >= static_cast<int>(sizeof(struct rtnl_link_stats64))) {
+                    // Attribute payloads are only 4-byte aligned
+                    struct rtnl_link_stats64 stats;
+                    std::memcpy(&stats, RTA_DATA(attribute), sizeof(stats));
+                    link.rxBytes = stats.rx_bytes;
+                    link.txBytes = stats.tx_bytes;
+                    link.rxPackets = stats.rx_packets;
+                    link.txPackets = stats.tx_packets;
+                    link.rxErrors = stats.rx_errors;
+                    link.txErrors = stats.tx_errors;
+                    link.rxDropped = stats.rx_dropped;
+                    link.txDropped = stats.tx_dropped;
+                    hasStats = true;
+                }
+            }
+            if (hasStats) {
+                links.append(link);
+            }
+        }
+    }
+}
+
+#endif // __linux__
@@ -0,0 +1,273 @@
+#include "proccapture.h"
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+#include <QtEndian>
+#include <chrono>
+
+namespace ProcCapture {
+    Mode currentMode = Off;
+
+    static constexpr quint32 kMagic = 0x41434d53; // "SMCA" on disk
+    static constexpr quint32 kVersion = 1;
+
+    struct FrameHeader {
+        qint64 wallMs = 0;
+        qint64 monotonicNs = 0;
+        quint32 families = 0;
+        quint32 size = 0; // of the compressed entries that follow
+    };
+    static constexpr int kFrameHeaderSize = 8 + 8 + 4 + 4;
+
+    // Every value one key returned within a frame, in read order
+    struct KeyEntries {
+        QVector<QPair<bool, QByteArray>> reads;
+        int next = 0;
+    };
+
+    // Reads come from the process scan's worker threads too
+    static QMutex mutex;
+    static QFile file;
+    static QString error;
+    static ReplaySpeed replaySpeed = RealTime;
+    static int frames = 0;
+
+    // Recording: the open frame
+    static FrameHeader recordHeader;
+    static QByteArray recordPayload;
+    static bool frameOpen = false;
+
+    // Replaying: the current frame, whose entries point into replayPayload,
+    // and the header of the one after it
+    static FrameHeader replayHeader;
+    static FrameHeader upcomingHeader;
+    static bool hasUpcoming = false;
+    static qint64 firstFrameNs = 0;
+    static QByteArray replayPayload;
+    static QHash<QByteArray, KeyEntries> replayEntries;
+
+    static qint64 steadyNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    template <typename T>
+    static void appendValue(QByteArray &out, T value) {
+        const T encoded = qToLittleEndian(value);
+        out.append(reinterpret_cast<const char *>(&encoded), sizeof(encoded));
+    }
+
+    template <typename T>
+    static bool takeValue(const char *&pos, const char *end, T &value) {
+        if (end - pos < static_cast<qptrdiff>(sizeof(T))) {
+            return false;
+        }
+        value = qFromLittleEndian<T>(pos);
+        pos += sizeof(T);
+        return true;
+    }
+
+    static bool takeBytes(const char *&pos, const char *end, QByteArray &bytes) {
+        quint32 length = 0;
+        if (!takeValue(pos, end, length) || quint32(end - pos) < length) {
+            return false;
+        }
+        // The payload outlives the frame's entries
+        bytes = QByteArray::fromRawData(pos, int(length));
+        pos += length;
+        return true;
+    }
+
+    static bool readHeader(FrameHeader &header) {
+        char bytes[kFrameHeaderSize];
+        if (file.read(bytes, kFrameHeaderSize) != kFrameHeaderSize) {
+            return false;
+        }
+        const char *pos = bytes;
+        const char *end = bytes + kFrameHeaderSize;
+        return takeValue(pos, end, header.wallMs) && takeValue(pos, end, header.monotonicNs) &&
+               takeValue(pos, end, header.families) && takeValue(pos, end, header.size);
+    }
+
+    static void reset() {
+        file.close();
+        frameOpen = false;
+        recordPayload.clear();
+        hasUpcoming = false;
+        replayEntries.clear();
+        replayPayload.clear();
+        replayHeader = FrameHeader();
+        currentMode = Off;
+    }
+
+    bool startRecording(const QString &path) {
+        QMutexLocker locker(&mutex);
+        reset();
+        frames = 0;
+        file.setFileName(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            error = file.errorString();
+            return false;
+        }
+        QByteArray header;
+        appendValue(header, kMagic);
+        appendValue(header, kVersion);
+        if (file.write(header) != header.size()) {
+            error = file.errorString();
+            file.close();
+            return false;
+        }
+        currentMode = Recording;
+        return true;
+    }
+
+    bool startReplay(const QString &path, ReplaySpeed speed) {
+        QMutexLocker locker(&mutex);
+        reset();
+        frames = 0;
+        file.setFileName(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            error = file.errorString();
+            return false;
+        }
+        const QByteArray header = file.read(8);
+        const char *pos = header.constData();
+        quint32 magic = 0, version = 0;
+        if (!takeValue(pos, pos + header.size(), magic) || !takeValue(pos, pos + header.size(), version) ||
+            magic != kMagic || version != kVersion) {
+            error = QString("%1 is not a capture file").arg(path);
+            file.close();
+            return false;
+        }
+        hasUpcoming = readHeader(upcomingHeader);
+        firstFrameNs = upcomingHeader.monotonicNs;
+        replaySpeed = speed;
+        currentMode = Replaying;
+        return true;
+    }
+
+    void stop() {
+        QMutexLocker locker(&mutex);
+        reset();
+    }
+
+    QString errorString() {
+        QMutexLocker locker(&mutex);
+        return error;
+    }
+
+    int frameCount() {
+        QMutexLocker locker(&mutex);
+        return frames;
+    }
+
+    void beginFrame(qint64 wallMs, MetricFamilies families) {
+        QMutexLocker locker(&mutex);
+        recordHeader.wallMs = wallMs;
+        recordHeader.monotonicNs = steadyNs();
+        recordHeader.families = quint32(families);
+        // Keeps its capacity from the previous frame
+        recordPayload.resize(0);
+        frameOpen = true;
+    }
+
+    void endFrame() {
+        QMutexLocker locker(&mutex);
+        if (!frameOpen) {
+            return;
+        }
+        frameOpen = false;
+        const QByteArray compressed = qCompress(recordPayload);
+        recordHeader.size = quint32(compressed.size());
+        QByteArray header;
+        appendValue(header, recordHeader.wallMs);
+        appendValue(header, recordHeader.monotonicNs);
+        appendValue(header, recordHeader.families);
+        appendValue(header, recordHeader.size);
+        // Flushed per frame, so a capture of a host that falls over is
+        // complete up to its last sample
+        if (file.write(header) != header.size() || file.write(compressed) != compressed.size() ||
+            !file.flush()) {
+            error = file.errorString();
+            reset();
+            return;
+        }
+        ++frames;
+    }
+
+    bool nextFrame(MetricFamilies &families) {
+        QMutexLocker locker(&mutex);
+        replayEntries.clear();
+        if (!hasUpcoming) {
+            return false;
+        }
+        replayHeader = upcomingHeader;
+        replayPayload = qUncompress(file.read(replayHeader.size));
+        const char *pos = replayPayload.constData();
+        const char *end = pos + replayPayload.size();
+        while (pos < end) {
+            QByteArray key, data;
+            quint8 ok = 0;
+            if (!takeBytes(pos, end, key) || !takeValue(pos, end, ok) || !takeBytes(pos, end, data)) {
+                error = QString("Frame %1 is truncated").arg(frames + 1);
+                hasUpcoming = false;
+                return false;
+            }
+            replayEntries[key].reads.append(qMakePair(ok != 0, data));
+        }
+        hasUpcoming = readHeader(upcomingHeader);
+        families = MetricFamilies(replayHeader.families);
+        ++frames;
+        return true;
+    }
+
+    qint64 frameWallMs() {
+        return replayHeader.wallMs;
+    }
+
+    qint64 nextFrameOffsetMs() {
+        QMutexLocker locker(&mutex);
+        if (replaySpeed == AsFastAsPossible || !hasUpcoming) {
+            return 0;
+        }
+        return (upcomingHeader.monotonicNs - firstFrameNs) / 1000000;
+    }
+
+    void record(const QByteArray &key, bool ok, const char *data, int size) {
+        QMutexLocker locker(&mutex);
+        if (!frameOpen) {
+            return; // a read outside a sampling pass
+        }
+        appendValue(recordPayload, quint32(key.size()));
+        recordPayload.append(key);
+        appendValue(recordPayload, quint8(ok ? 1 : 0));
+        appendValue(recordPayload, quint32(size));
+        recordPayload.append(data, size);
+    }
+
+    bool replay(const QByteArray &key, QByteArray &data) {
+        QMutexLocker locker(&mutex);
+        const auto it = replayEntries.find(key);
+        if (it == replayEntries.end()) {
+            data.clear();
+            return false;
+        }
+        // Reads beyond those recorded see the last value again
+        KeyEntries &entries = it.value();
+        const QPair<bool, QByteArray> &read = entries.reads.at(qMin(entries.next, entries.reads.size() - 1));
+        ++entries.next;
+        data = read.second;
+        return read.first;
+    }
+
+    bool contains(const QByteArray &key) {
+        QMutexLocker locker(&mutex);
+        return replayEntries.contains(key);
+    }
+
+    qint64 clockNs() {
+        return currentMode == Replaying ? replayHeader.monotonicNs : steadyNs();
+    }
+} // namespace ProcCapture
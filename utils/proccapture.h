@@ -0,0 +1,93 @@
+#ifndef PROCCAPTURE_H
+#define PROCCAPTURE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+#include "samplingscheduler.h"
+
+/**
+ * @brief Records the raw input of the collectors, and plays it back
+ *
+ * While recording, every /proc and /sys read, PID listing, statvfs() and
+ * rtnetlink dump of one sampling pass is gathered into a frame, which is
+ * compressed with qCompress() and appended to the capture file with the
+ * pass's wall-clock and monotonic timestamps. While replaying, the same
+ * calls are answered from the current frame instead of the system, and
+ * SampleClock runs on the recorded time, so parsing, rates and everything
+ * after SampleCollector behave exactly as they did on the recorded host.
+ *
+ * File layout, little endian: "SMCA" magic and version, then per frame
+ * wall ms, monotonic ns, families and compressed size, followed by the
+ * compressed entries (key, success, bytes). A key is the path read, or a
+ * name such as "netlink:links" for what is not a file.
+ *
+ * The mode is chosen once, before collection starts. While it is Off,
+ * each hook in the readers costs one predictable branch.
+ */
+namespace ProcCapture {
+    enum Mode {
+        Off,
+        Recording,
+        Replaying
+    };
+
+    enum ReplaySpeed {
+        RealTime,         // frames are spaced as they were recorded
+        AsFastAsPossible  // the next frame follows as soon as one is done
+    };
+
+    extern Mode currentMode;
+    inline Mode mode() { return currentMode; }
+    inline bool isRecording() { return currentMode == Recording; }
+    inline bool isReplaying() { return currentMode == Replaying; }
+
+    // Truncates or opens path; false with errorString() set on failure
+    bool startRecording(const QString &path);
+    bool startReplay(const QString &path, ReplaySpeed speed = RealTime);
+    // Closes the file and returns to Off
+    void stop();
+    QString errorString();
+    // Frames written or replayed since the last start; kept after stop()
+    int frameCount();
+
+    // Recording: brackets one sampling pass; endFrame() appends it
+    void beginFrame(qint64 wallMs, MetricFamilies families);
+    void endFrame();
+
+    // Replaying: loads the next frame, false at the end of the capture
+    bool nextFrame(MetricFamilies &families);
+    qint64 frameWallMs();
+    // When the following frame is due, in ms after the first one; 0 when
+    // replaying as fast as possible
+    qint64 nextFrameOffsetMs();
+
+    // Hooks for the readers. record() keeps what a read of key returned;
+    // replay() hands it back in the same order and returns the recorded
+    // success, or false if key was not read in this frame.
+    void record(const QByteArray &key, bool ok, const char *data, int size);
+    bool replay(const QByteArray &key, QByteArray &data);
+    bool contains(const QByteArray &key);
+
+    // Monotonic nanoseconds; the current frame's while replaying
+    qint64 clockNs();
+}
+
+/**
+ * @brief Interval timer for rate calculations, replayable
+ *
+ * The QElapsedTimer subset the collectors use, on ProcCapture::clockNs(),
+ * so that rates come out the same when a capture is replayed at any speed.
+ */
+class SampleClock
+{
+public:
+    void start() { m_startNs = ProcCapture::clockNs(); }
+    bool isValid() const { return m_startNs >= 0; }
+    qint64 nsecsElapsed() const { return ProcCapture::clockNs() - m_startNs; }
+
+private:
+    qint64 m_startNs = -1;
+};
+
+#endif // PROCCAPTURE_H
@@ -0,0 +1,98 @@
+#ifndef PROCESSCACHE_H
+#define PROCESSCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <atomic>
+#include "proccapture.h"
+#include "procreader.h"
+#include "systeminfo.h"
+
+/**
+ * @brief Per-PID state carried from one process scan to the next
+ *
+ * Entries are keyed by PID and validated against the process start time,
+ * so a recycled PID starts over instead of inheriting the CPU ticks of
+ * the process that used it before. Only /proc/[pid]/stat and io are read
+ * per process; the name is decoded again only when comm actually changes.
+ *
+ * The expensive fields (uid, lifetime I/O, PSS, command line) are a
+ * second tier: readDetails() loads them for the few PIDs a view shows,
+ * caching each for a while. That cache only ever holds the PIDs of the
+ * latest request.
+ *
+ * PIDs are split into shards by PID. Each shard owns its part of the
+ * cache and its own read buffer, so on large hosts shards are scanned in
+ * parallel without any locking and merged once all of them are done.
+ */
+class ProcessCache
+{
+public:
+    ProcessCache();
+    ~ProcessCache();
+
+    // Rescans /proc and fills processes with every live process.
+    // cpuUsage is the share of one core used since the previous scan.
+    void scan(QVector<ProcessInfo> &processes);
+
+    // Upper bound on threads used for one scan, including the caller
+    void setMaxThreads(int count);
+    int maxThreads() const { return m_maxThreads; }
+
+    // Fills details with the detail fields of those pids seen by the
+    // latest scan; cached details younger than maxAgeMs are reused
+    void readDetails(const QVector<quint32> &pids, int maxAgeMs, QVector<ProcessDetails> &details);
+
+    int size() const;
+
+private:
+    struct Entry {
+        quint64 startTime = 0;  // clock ticks after boot, tells PID reuse apart
+        quint64 cpuTicks = 0;   // utime + stime at the previous scan
+        quint64 ioBytes = 0;    // read_bytes + write_bytes at the previous scan
+        quint64 generation = 0; // last scan that saw this PID
+        QByteArray comm;    // raw comm bytes, to detect renames cheaply
+        QString name;
+    };
+
+    struct Shard {
+        QHash<quint32, Entry> entries;
+        QVector<quint32> pids;
+        QVector<ProcessInfo> processes;
+        ProcBuffer buffer;
+    };
+
+    struct DetailEntry {
+        quint64 startTime = 0;
+        qint64 readNs = 0;      // m_detailClock time of the last read
+        quint64 generation = 0; // last readDetails() that asked for this PID
+        ProcessDetails details;
+    };
+
+    void scanShards(double elapsedTicks);
+    void scanShard(Shard &shard, double elapsedTicks);
+    bool readProcess(Shard &shard, quint32 pid, double elapsedTicks, ProcessInfo &proc);
+    bool readDetail(quint32 pid, ProcessDetails &details);
+
+    QVector<Shard> m_shards;
+    quint64 m_generation;
+    SampleClock m_clock;
+    QVector<quint32> m_pids;
+    long m_ticksPerSecond;
+    long m_pageSize;
+
+    // Detail tier, only touched by readDetails() on the calling thread
+    QHash<quint32, DetailEntry> m_details;
+    quint64 m_detailGeneration;
+    SampleClock m_detailClock;
+    ProcBuffer m_detailBuffer;
+
+    int m_maxThreads;
+    QThreadPool m_pool;
+    std::atomic<int> m_nextShard;
+};
+
+#endif // PROCESSCACHE_H
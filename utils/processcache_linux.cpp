@@ -0,0 +1,386 @@
+#ifdef __linux__
+
+#include "processcache.h"
+#include "instrumentation.h"
+#include <QRunnable>
+#include <QThread>
+#include <climits>
+#include <cstring>
+#include <unistd.h>
+
+// Fields of /proc/[pid]/stat we need, numbered as in proc(5)
+static constexpr int kStatState = 3;
+static constexpr int kStatUtime = 14;
+static constexpr int kStatStime = 15;
+static constexpr int kStatThreads = 20;
+static constexpr int kStatStartTime = 22;
+static constexpr int kStatRss = 24;
+
+// PIDs are spread over this many shards; more shards than threads keeps
+// the threads busy when some shards turn out slower than others
+static constexpr int kShardCount = 64;
+// Below this many processes the scan stays on the calling thread
+static constexpr int kParallelThreshold = 2048;
+
+// ProcessInfo::status for a state letter of /proc/[pid]/stat; shared
+// strings, so filling it in never allocates
+static const QString &processStatus(char state)
+{
+    static const QString running = QStringLiteral("Running");
+    static const QString sleeping = QStringLiteral("Sleeping");
+    static const QString diskSleep = QStringLiteral("Disk sleep");
+    static const QString stopped = QStringLiteral("Stopped");
+    static const QString tracing = QStringLiteral("Tracing stop");
+    static const QString zombie = QStringLiteral("Zombie");
+    static const QString dead = QStringLiteral("Dead");
+    static const QString idle = QStringLiteral("Idle");
+    static const QString unknown = QStringLiteral("Unknown");
+    switch (state) {
+    case 'R': return running;
+    case 'S': return sleeping;
+    case 'D': return diskSleep;
+    case 'T': return stopped;
+    case 't': return tracing;
+    case 'Z': return zombie;
+    case 'X':
+    case 'x': return dead;
+    case 'I': return idle;
+    default: return unknown;
+    }
+}
+
+ProcessCache::ProcessCache()
+    : m_shards(kShardCount)
+    , m_generation(0)
+    , m_ticksPerSecond(sysconf(_SC_CLK_TCK))
+    , m_pageSize(sysconf(_SC_PAGESIZE))
+    , m_detailGeneration(0)
+    , m_maxThreads(1)
+    , m_nextShard(0)
+{
+    // By default take at most a quarter of the machine being watched
+    setMaxThreads(qBound(1, QThread::idealThreadCount() / 4, 4));
+}
+
+ProcessCache::~ProcessCache()
+{
+    m_pool.waitForDone();
+}
+
+void ProcessCache::setMaxThreads(int count)
+{
+    m_maxThreads = qMax(1, count);
+    // The calling thread always takes part in the scan
+    m_pool.setMaxThreadCount(qMax(1, m_maxThreads - 1));
+}
+
+int ProcessCache::size() const
+{
+    int total = 0;
+    for (const Shard &shard : m_shards) {
+        total += shard.entries.size();
+    }
+    return total;
+}
+
+void ProcessCache::scan(QVector<ProcessInfo> &processes)
+{
+    ++m_generation;
+
+    // CPU% is measured against the wall time between two scans
+    double elapsedTicks = 0.0;
+    if (m_clock.isValid()) {
+        elapsedTicks = m_clock.nsecsElapsed() / 1e9 * m_ticksPerSecond;
+    }
+    m_clock.start();
+
+    ProcReader::listPids(m_pids);
+    for (Shard &shard : m_shards) {
+        shard.pids.resize(0);
+    }
+    for (quint32 pid : m_pids) {
+        m_shards[pid % kShardCount].pids.append(pid);
+    }
+
+    scanShards(elapsedTicks);
+
+    // Merge once every shard is done; shards never share results
+    processes.resize(0);
+    processes.reserve(m_pids.size());
+    for (const Shard &shard : m_shards) {
+        processes += shard.processes;
+    }
+}
+
+void ProcessCache::scanShards(double elapsedTicks)
+{
+    const int helpers = m_pids.size() < kParallelThreshold ? 0 : m_maxThreads - 1;
+    if (helpers <= 0) {
+        for (Shard &shard : m_shards) {
+            scanShard(shard, elapsedTicks);
+        }
+        return;
+    }
+
+    // Threads pull the next unclaimed shard until none are left, so a
+    // thread that finishes early takes over work the others have not
+    // started yet
+    m_nextShard.store(0, std::memory_order_relaxed);
+    Shard *shards = m_shards.data();
+    auto worker = [this, shards, elapsedTicks]() {
+        for (int i = m_nextShard.fetch_add(1, std::memory_order_relaxed); i < kShardCount;
+             i = m_nextShard.fetch_add(1, std::memory_order_relaxed)) {
+            scanShard(shards[i], elapsedTicks);
+        }
+    };
+    // The helpers' CPU time belongs to the scan measured on this thread
+    const bool measured = Instrumentation::isEnabled();
+    std::atomic<qint64> helperCpuNs(0);
+    auto helper = [&worker, &helperCpuNs, measured]() {
+        const qint64 startNs = measured ? Instrumentation::threadCpuNs() : 0;
+        worker();
+        if (measured) {
+            helperCpuNs.fetch_add(Instrumentation::threadCpuNs() - startNs, std::memory_order_relaxed);
+        }
+    };
+    for (int i = 0; i < helpers; ++i) {
+        m_pool.start(QRunnable::create(helper));
+    }
+    worker();
+    m_pool.waitForDone();
+    if (measured) {
+        Instrumentation::addHelperCpuNs(helperCpuNs.load(std::memory_order_relaxed));
+    }
+}
+
+void ProcessCache::scanShard(Shard &shard, double elapsedTicks)
+{
+    shard.processes.resize(0);
+    for (quint32 pid : shard.pids) {
+        ProcessInfo proc;
+        if (readProcess(shard, pid, elapsedTicks, proc)) {
+            shard.processes.append(proc);
+        }
+    }
+
+    // Evict processes that have exited since the previous scan
+    for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+        if (it.value().generation != m_generation) {
+            it = shard.entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool ProcessCache::readProcess(Shard &shard, quint32 pid, double elapsedTicks, ProcessInfo &proc)
+{
+    char path[PATH_MAX];
+    qsnprintf(path, sizeof(path), "%s/proc/%u/stat", ProcReader::root(), pid);
+    if (!ProcReader::readFile(path, shard.buffer) || shard.buffer.isEmpty()) {
+        return false; // Exited between listing and reading
+    }
+
+    // "pid (comm) state ppid ..." where comm may itself contain spaces or ')'
+    const char *data = shard.buffer.data();
+    const char *end = data + shard.buffer.size();
+    const char *commBegin = static_cast<const char *>(std::memchr(data, '(', shard.buffer.size()));
+    const char *commEnd = end;
+    while (commEnd > data && *--commEnd != ')') {
+    }
+    if (!commBegin || commEnd <= commBegin) {
+        return false;
+    }
+    ++commBegin;
+    const int commLength = static_cast<int>(commEnd - commBegin);
+
+    // Walk fields 3 (state) through 24 (rss); some of them may be negative
+    quint64 utime = 0, stime = 0, threads = 0, startTime = 0, rssPages = 0;
+    char state = '?';
+    ProcScanner scanner(commEnd + 1, static_cast<int>(end - commEnd - 1));
+    for (int field = kStatState; field <= kStatRss; ++field) {
+        quint64 *target = nullptr;
+        switch (field) {
+        case kStatUtime: target = &utime; break;
+        case kStatThreads: target = &threads; break;
+        case kStatStime: target = &stime; break;
+        case kStatStartTime: target = &startTime; break;
+        case kStatRss: target = &rssPages; break;
+        default: break;
+        }
+        if (target) {
+            if (!scanner.readNumber(*target)) {
+                return false;
+            }
+        } else {
+            const char *token;
+            int length;
+            if (!scanner.readToken(token, length)) {
+                return false;
+            }
+            if (field == kStatState) {
+                state = *token;
+            }
+        }
+    }
+    const quint64 cpuTicks = utime + stime;
+
+    Entry &entry = shard.entries[pid];
+    const bool fresh = entry.generation == 0 || entry.startTime != startTime;
+    if (fresh) {
+        // First sighting, or the PID was recycled by a new process
+        entry.startTime = startTime;
+        entry.cpuTicks = cpuTicks;
+        entry.comm = QByteArray(commBegin, commLength);
+        entry.name = QString::fromUtf8(commBegin, commLength);
+        proc.cpuUsage = 0.0;
+    } else {
+        const quint64 delta = cpuTicks >= entry.cpuTicks ? cpuTicks - entry.cpuTicks : 0;
+        proc.cpuUsage = elapsedTicks > 0.0 ? delta * 100.0 / elapsedTicks : 0.0;
+        entry.cpuTicks = cpuTicks;
+        // Threads may rename themselves with prctl(PR_SET_NAME)
+        if (entry.comm.size() != commLength ||
+            std::memcmp(entry.comm.constData(), commBegin, commLength) != 0) {
+            entry.comm = QByteArray(commBegin, commLength);
+            entry.name = QString::fromUtf8(commBegin, commLength);
+        }
+    }
+    entry.generation = m_generation;
+
+    // Storage I/O from /proc/[pid]/io; other users' processes are not
+    // readable without privileges and simply report no I/O.
+    // This reuses the buffer, so comm is no longer valid past this point.
+    proc.ioBytesPerSec = 0;
+    quint64 ioBytes = 0;
+    qsnprintf(path, sizeof(path), "%s/proc/%u/io", ProcReader::root(), pid);
+    if (ProcReader::readFile(path, shard.buffer)) {
+        ProcScanner io(shard.buffer.data(), shard.buffer.size());
+        for (; !io.atEnd(); io.nextLine()) {
+            if (io.startsWith("read_bytes:", 11) || io.startsWith("write_bytes:", 12)) {
+                io.skipPast(':');
+                ioBytes += io.number();
+            }
+        }
+    }
+    if (!fresh && ioBytes >= entry.ioBytes && elapsedTicks > 0.0) {
+        proc.ioBytesPerSec = static_cast<qint64>((ioBytes - entry.ioBytes) * m_ticksPerSecond / elapsedTicks);
+    }
+    entry.ioBytes = ioBytes;
+
+    proc.pid = pid;
+    proc.name = entry.name;
+    proc.memoryUsage = static_cast<qint64>(rssPages) * m_pageSize;
+    proc.threads = static_cast<int>(threads);
+    proc.status = processStatus(state);
+    return !proc.name.isEmpty();
+}
+
+void ProcessCache::readDetails(const QVector<quint32> &pids, int maxAgeMs, QVector<ProcessDetails> &details)
+{
+    ++m_detailGeneration;
+    if (!m_detailClock.isValid()) {
+        m_detailClock.start();
+    }
+    const qint64 nowNs = m_detailClock.nsecsElapsed();
+    const qint64 maxAgeNs = qint64(maxAgeMs) * 1000000;
+
+    details.resize(0);
+    for (quint32 pid : pids) {
+        // Only processes the latest scan saw; their start time tells a
+        // recycled PID apart from the one whose details are cached
+        const Shard &shard = m_shards[pid % kShardCount];
+        const auto scanned = shard.entries.constFind(pid);
+        if (scanned == shard.entries.constEnd()) {
+            continue;
+        }
+        DetailEntry &entry = m_details[pid];
+        const bool stale = entry.generation == 0 || entry.startTime != scanned->startTime
+                           || nowNs - entry.readNs >= maxAgeNs;
+        entry.generation = m_detailGeneration;
+        if (stale) {
+            if (!readDetail(pid, entry.details)) {
+                m_details.remove(pid);
+                continue;
+            }
+            entry.startTime = scanned->startTime;
+            entry.readNs = nowNs;
+        }
+        details.append(entry.details);
+    }
+
+    // Forget the processes nobody looks at any more
+    for (auto it = m_details.begin(); it != m_details.end();) {
+        if (it.value().generation != m_detailGeneration) {
+            it = m_details.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool ProcessCache::readDetail(quint32 pid, ProcessDetails &details)
+{
+    details = ProcessDetails();
+    details.pid = pid;
+    details.readBytes = -1;
+    details.writeBytes = -1;
+    details.pssBytes = -1;
+
+    // The real uid is the first of four on the Uid: line; status is
+    // readable for every process, so failing here means it has exited
+    char path[PATH_MAX];
+    qsnprintf(path, sizeof(path), "%s/proc/%u/status", ProcReader::root(), pid);
+    if (!ProcReader::readFile(path, m_detailBuffer)) {
+        return false;
+    }
+    for (ProcScanner status(m_detailBuffer.data(), m_detailBuffer.size()); !status.atEnd(); status.nextLine()) {
+        if (status.startsWith("Uid:", 4)) {
+            status.advance(4);
+            details.uid = static_cast<quint32>(status.number());
+            break;
+        }
+    }
+
+    // Lifetime storage I/O and PSS need privileges for other users'
+    // processes and stay -1 without them
+    qsnprintf(path, sizeof(path), "%s/proc/%u/io", ProcReader::root(), pid);
+    if (ProcReader::readFile(path, m_detailBuffer)) {
+        for (ProcScanner io(m_detailBuffer.data(), m_detailBuffer.size()); !io.atEnd(); io.nextLine()) {
+            if (io.startsWith("read_bytes:", 11)) {
+                io.advance(11);
+                details.readBytes = static_cast<qint64>(io.number());
+            } else if (io.startsWith("write_bytes:", 12)) {
+                io.advance(12);
+                details.writeBytes = static_cast<qint64>(io.number());
+            }
+        }
+    }
+
+    // smaps_rollup sums smaps in the kernel (Linux 4.14+), far cheaper
+    // than walking every mapping; values are in kB
+    qsnprintf(path, sizeof(path), "%s/proc/%u/smaps_rollup", ProcReader::root(), pid);
+    if (ProcReader::readFile(path, m_detailBuffer)) {
+        for (ProcScanner smaps(m_detailBuffer.data(), m_detailBuffer.size()); !smaps.atEnd(); smaps.nextLine()) {
+            if (smaps.startsWith("Pss:", 4)) {
+                smaps.advance(4);
+                details.pssBytes = static_cast<qint64>(smaps.number()) * 1024;
+                break;
+            }
+        }
+    }
+
+    // Arguments are NUL-separated, with a trailing NUL; kernel threads
+    // have none
+    qsnprintf(path, sizeof(path), "%s/proc/%u/cmdline", ProcReader::root(), pid);
+    if (ProcReader::readFile(path, m_detailBuffer) && !m_detailBuffer.isEmpty()) {
+        QByteArray arguments(m_detailBuffer.data(), m_detailBuffer.size());
+        while (arguments.endsWith('\0')) {
+            arguments.chop(1);
+        }
+        arguments.replace('\0', ' ');
+        details.commandLine = QString::fromUtf8(arguments);
+    }
+    return true;
+}
+
+#endif // __linux__
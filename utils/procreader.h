@@ -0,0 +1,174 @@
+#ifndef PROCREADER_H
+#define PROCREADER_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QtGlobal>
+#include <sys/statvfs.h>
+
+/**
+ * @brief Reusable read buffer for /proc files
+ *
+ * The buffer only ever grows, so after the first few samples reading a
+ * file no longer allocates.
+ */
+class ProcBuffer
+{
+public:
+    const char *data() const { return m_data.constData(); }
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+    // Reads the whole file behind fd starting at offset 0 with pread()
+    bool readFrom(int fd);
+    // Replaces the content with a copy of data, e.g. a replayed read
+    void assign(const QByteArray &data);
+
+private:
+    QByteArray m_data;
+    int m_size = 0;
+};
+
+/**
+ * @brief A /proc file that stays open between samples
+ *
+ * Files like /proc/stat regenerate their content on every read from
+ * offset 0, so keeping the descriptor pinned saves an open/close pair
+ * per tick. The path is resolved under ProcReader::root() when the
+ * ProcFile is constructed.
+ */
+class ProcFile
+{
+public:
+    explicit ProcFile(const char *path);
+    ~ProcFile();
+
+    ProcFile(const ProcFile &) = delete;
+    ProcFile &operator=(const ProcFile &) = delete;
+
+    // Re-reads the file, reopening it if it was never opened successfully
+    bool read();
+
+    const char *data() const { return m_buffer.data(); }
+    int size() const { return m_buffer.size(); }
+
+    // Open descriptor, e.g. for poll(); -1 until the first successful read
+    int descriptor() const { return m_fd; }
+    // Path as given, without root(); the file's ProcCapture key
+    const QByteArray &name() const { return m_name; }
+
+private:
+    QByteArray m_name;
+    QByteArray m_path;
+    int m_fd;
+    ProcBuffer m_buffer;
+};
+
+/**
+ * @brief In-place tokenizer over a /proc buffer
+ *
+ * Works on raw bytes and never creates QStrings; callers pull numbers and
+ * tokens off the current position.
+ */
+class ProcScanner
+{
+public:
+    ProcScanner(const char *data, int size) : m_pos(data), m_end(data + size) {}
+
+    bool atEnd() const { return m_pos >= m_end; }
+    const char *position() const { return m_pos; }
+
+    void skipSpaces() {
+        while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\t')) {
+            ++m_pos;
+        }
+    }
+
+    // Moves past the next newline
+    void nextLine() {
+        while (m_pos < m_end && *m_pos++ != '\n') {
+        }
+    }
+
+    // Moves past the next occurrence of c on the current line
+    bool skipPast(char c) {
+        while (m_pos < m_end && *m_pos != '\n') {
+            if (*m_pos++ == c) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool startsWith(const char *prefix, int length) const {
+        return m_end - m_pos >= length && qstrncmp(m_pos, prefix, length) == 0;
+    }
+
+    bool atDigit() const { return m_pos < m_end && *m_pos >= '0' && *m_pos <= '9'; }
+
+    // Parses an unsigned decimal after optional spaces, false if there is none
+    bool readNumber(quint64 &value) {
+        skipSpaces();
+        if (!atDigit()) {
+            return false;
+        }
+        quint64 result = 0;
+        while (atDigit()) {
+            result = result * 10 + static_cast<quint64>(*m_pos++ - '0');
+        }
+        value = result;
+        return true;
+    }
+
+    quint64 number() {
+        quint64 value = 0;
+        readNumber(value);
+        return value;
+    }
+
+    // Returns the next whitespace-delimited token on the current line
+    bool readToken(const char *&begin, int &length) {
+        skipSpaces();
+        begin = m_pos;
+        while (m_pos < m_end && *m_pos != ' ' && *m_pos != '\t' && *m_pos != '\n') {
+            ++m_pos;
+        }
+        length = static_cast<int>(m_pos - begin);
+        return length > 0;
+    }
+
+    void advance(int count) { m_pos = qMin(m_pos + count, m_end); }
+
+private:
+    const char *m_pos;
+    const char *m_end;
+};
+
+namespace ProcReader {
+    // Directory that /proc and /sys paths are resolved under, "" for the
+    // real ones. Collectors keep their files open, so set it before the
+    // first sample; rtnetlink is skipped while a root is set, since it
+    // would report the host's interfaces.
+    void setRoot(const QByteArray &root);
+    const char *root();
+    bool hasRoot();
+
+    // One-shot read of a short-lived file such as /proc/[pid]/statm; path
+    // must already include root()
+    bool readFile(const char *path, ProcBuffer &buffer);
+
+    // Numeric entries of <root>/proc, reusing the vector's storage
+    void listPids(QVector<quint32> &pids);
+
+    // statvfs() and access(F_OK) for the collectors, so that captures
+    // include them; path must already include root()
+    bool statFileSystem(const QByteArray &path, struct statvfs &vfs);
+    bool exists(const QByteArray &path);
+    // Whether the directory holds anything besides . and ..
+    bool hasEntries(const QByteArray &directory);
+
+    // Captures are keyed by paths without root(), so they replay anywhere
+    QByteArray captureKey(const char *path);
+}
+
+#endif // PROCREADER_H
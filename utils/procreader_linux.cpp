@@ -0,0 +1,214 @@
+#ifdef __linux__
+
+#include "procreader.h"
+#include "proccapture.h"
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static constexpr int kInitialBufferSize = 4096;
+
+bool ProcBuffer::readFrom(int fd)
+{
+    if (m_data.size() < kInitialBufferSize) {
+        m_data.resize(kInitialBufferSize);
+    }
+    qint64 total = 0;
+    for (;;) {
+        const ssize_t n = ::pread(fd, m_data.data() + total, m_data.size() - total, total);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            m_size = 0;
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += n;
+        // Buffer full, the file may have more to give
+        if (total == m_data.size()) {
+            m_data.resize(m_data.size() * 2);
+        }
+    }
+    m_size = static_cast<int>(total);
+    return true;
+}
+
+void ProcBuffer::assign(const QByteArray &data)
+{
+    if (m_data.size() < data.size()) {
+        m_data.resize(data.size());
+    }
+    std::memcpy(m_data.data(), data.constData(), data.size());
+    m_size = data.size();
+}
+
+// Answers a read from the capture being replayed
+static bool replayInto(const QByteArray &key, ProcBuffer &buffer)
+{
+    QByteArray data;
+    const bool ok = ProcCapture::replay(key, data);
+    buffer.assign(data);
+    return ok;
+}
+
+ProcFile::ProcFile(const char *path)
+    : m_name(path)
+    , m_path(QByteArray(ProcReader::root()) + path)
+    , m_fd(-1)
+{
+}
+
+ProcFile::~ProcFile()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+bool ProcFile::read()
+{
+    if (ProcCapture::isReplaying()) {
+        return replayInto(m_name, m_buffer);
+    }
+    if (m_fd < 0) {
+        m_fd = ::open(m_path.constData(), O_RDONLY | O_CLOEXEC);
+    }
+    const bool ok = m_fd >= 0 && m_buffer.readFrom(m_fd);
+    if (ProcCapture::isRecording()) {
+        ProcCapture::record(m_name, ok, m_buffer.data(), ok ? m_buffer.size() : 0);
+    }
+    return ok;
+}
+
+namespace ProcReader {
+    static QByteArray procRoot;
+
+    void setRoot(const QByteArray &root) {
+        procRoot = root;
+        // "/" and "dir/" would otherwise double the separator
+        while (procRoot.endsWith('/')) {
+            procRoot.chop(1);
+        }
+    }
+
+    const char *root() {
+        return procRoot.constData();
+    }
+
+    bool hasRoot() {
+        return !procRoot.isEmpty();
+    }
+
+    QByteArray captureKey(const char *path) {
+        return QByteArray(path + qMin(procRoot.size(), int(qstrlen(path))));
+    }
+
+    bool readFile(const char *path, ProcBuffer &buffer) {
+        if (ProcCapture::isReplaying()) {
+            return replayInto(captureKey(path), buffer);
+        }
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        const bool ok = fd >= 0 && buffer.readFrom(fd);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        if (ProcCapture::isRecording()) {
+            ProcCapture::record(captureKey(path), ok, buffer.data(), ok ? buffer.size() : 0);
+        }
+        return ok;
+    }
+
+    // Recorded as the raw array of PIDs
+    static const QByteArray kPidsKey("pids");
+
+    void listPids(QVector<quint32> &pids) {
+        pids.resize(0);
+        if (ProcCapture::isReplaying()) {
+            QByteArray data;
+            ProcCapture::replay(kPidsKey, data);
+            pids.resize(data.size() / int(sizeof(quint32)));
+            std::memcpy(pids.data(), data.constData(), pids.size() * sizeof(quint32));
+            return;
+        }
+        DIR *dir = ::opendir((procRoot + "/proc").constData());
+        if (!dir) {
+            return;
+        }
+        while (struct dirent *entry = ::readdir(dir)) {
+            const char *name = entry->d_name;
+            if (name[0] < '1' || name[0] > '9') {
+                continue;
+            }
+            quint32 pid = 0;
+            for (; *name >= '0' && *name <= '9'; ++name) {
+                pid = pid * 10 + static_cast<quint32>(*name - '0');
+            }
+            if (*name == '\0') {
+                pids.append(pid);
+            }
+        }
+        ::closedir(dir);
+        if (ProcCapture::isRecording()) {
+            ProcCapture::record(kPidsKey, true, reinterpret_cast<const char *>(pids.constData()),
+                                pids.size() * int(sizeof(quint32)));
+        }
+    }
+
+    bool statFileSystem(const QByteArray &path, struct statvfs &vfs) {
+        if (ProcCapture::isReplaying()) {
+            QByteArray data;
+            if (!ProcCapture::replay("statvfs:" + captureKey(path.constData()), data) ||
+                data.size() != int(sizeof(vfs))) {
+                return false;
+            }
+            std::memcpy(&vfs, data.constData(), sizeof(vfs));
+            return true;
+        }
+        const bool ok = ::statvfs(path.constData(), &vfs) == 0;
+        if (ProcCapture::isRecording()) {
+            ProcCapture::record("statvfs:" + captureKey(path.constData()), ok,
+                                reinterpret_cast<const char *>(&vfs), ok ? int(sizeof(vfs)) : 0);
+        }
+        return ok;
+    }
+
+    bool exists(const QByteArray &path) {
+        if (ProcCapture::isReplaying()) {
+            QByteArray data;
+            return ProcCapture::replay("exists:" + captureKey(path.constData()), data);
+        }
+        const bool ok = ::access(path.constData(), F_OK) == 0;
+        if (ProcCapture::isRecording()) {
+            ProcCapture::record("exists:" + captureKey(path.constData()), ok, nullptr, 0);
+        }
+        return ok;
+    }
+
+    bool hasEntries(const QByteArray &directory) {
+        if (ProcCapture::isReplaying()) {
+            QByteArray data;
+            return ProcCapture::replay("entries:" + captureKey(directory.constData()), data);
+        }
+        bool found = false;
+        if (DIR *dir = ::opendir(directory.constData())) {
+            while (struct dirent *entry = ::readdir(dir)) {
+                if (std::strcmp(entry->d_name, ".") != 0 && std::strcmp(entry->d_name, "..") != 0) {
+                    found = true;
+                    break;
+                }
+            }
+            ::closedir(dir);
+        }
+        if (ProcCapture::isRecording()) {
+            ProcCapture::record("entries:" + captureKey(directory.constData()), found, nullptr, 0);
+        }
+        return found;
+    }
+} // namespace ProcReader
+
+#endif // __linux__
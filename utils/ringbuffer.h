@@ -0,0 +1,61 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * @brief Fixed-capacity FIFO that overwrites its oldest element when full
+ *
+ * The capacity is rounded up to a power of two so wrapping an index is a
+ * mask instead of a division. append() is O(1) no matter how much history
+ * is retained; at(0) is the oldest element and at(size() - 1) the newest.
+ */
+template <typename T>
+class RingBuffer
+{
+public:
+    explicit RingBuffer(int capacity = 1024) { setCapacity(capacity); }
+
+    // Drops the contents
+    void setCapacity(int capacity) {
+        int rounded = 1;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        m_items.fill(T(), rounded);
+        m_mask = rounded - 1;
+        m_head = 0;
+        m_size = 0;
+    }
+
+    int capacity() const { return m_mask + 1; }
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+    void append(const T &item) {
+        m_items[(m_head + m_size) & m_mask] = item;
+        if (m_size <= m_mask) {
+            ++m_size;
+        } else {
+            m_head = (m_head + 1) & m_mask;
+        }
+    }
+
+    const T &at(int i) const { return m_items.at((m_head + i) & m_mask); }
+    const T &first() const { return at(0); }
+    const T &last() const { return at(m_size - 1); }
+
+    void clear() {
+        m_head = 0;
+        m_size = 0;
+    }
+
+private:
+    QVector<T> m_items;
+    int m_mask;
+    int m_head;
+    int m_size;
+};
+
+#endif // RINGBUFFER_H
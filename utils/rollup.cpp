@@ -0,0 +1,385 @@
+#include "rollup.h"
+#include "rollupkernels.h"
+#include <QDir>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+// Closed buckets kept per level: about eleven days of minutes, a year of hours
+static constexpr int kLevelCapacity[RollupLevelCount] = {16384, 8192};
+static constexpr qint64 kNoBucket = std::numeric_limits<qint64>::min();
+
+// Channels rolled up by RollupEngine, in the order of its series
+static const struct {
+    MetricFamily family;
+    int channel;
+    const char *file; // RollupStore file name, without the level
+} kRolledUp[] = {
+    {CpuFamily, CpuUsageChannel, "rollup-cpu"},
+    {MemoryFamily, MemoryUsageChannel, "rollup-memory"},
+    {NetworkFamily, NetworkRxBytesChannel, "rollup-netrx"},
+    {NetworkFamily, NetworkTxBytesChannel, "rollup-nettx"},
+    {DiskIoFamily, DiskReadBytesChannel, "rollup-diskread"},
+    {DiskIoFamily, DiskWriteBytesChannel, "rollup-diskwrite"},
+};
+static_assert(sizeof(kRolledUp) / sizeof(kRolledUp[0]) == kRollupSeriesCount, "kRollupSeriesCount is out of date");
+
+static const char *const kLevelSuffix[RollupLevelCount] = {".minute.ring", ".hour.ring"};
+
+// HistoryRing tags of the stored buckets, clear of the MetricFamily tags
+static quint32 storeTag(int series, RollupLevel level)
+{
+    return 0x100 + quint32(series) * RollupLevelCount + quint32(level);
+}
+
+static QString storePath(const QString &directory, int series, RollupLevel level)
+{
+    return QDir(directory).filePath(QString::fromLatin1(kRolledUp[series].file) + QString::fromLatin1(kLevelSuffix[level]));
+}
+
+// Buckets are stored as history records: min, max, avg, p95, count
+static HistoryRecord toRecord(const RollupBucket &bucket)
+{
+    HistoryRecord record = {};
+    record.timestampMs = bucket.startMs;
+    record.values[0] = bucket.min;
+    record.values[1] = bucket.max;
+    record.values[2] = bucket.avg;
+    record.values[3] = bucket.p95;
+    record.values[4] = float(bucket.count);
+    return record;
+}
+
+static RollupBucket toBucket(const HistoryRecord &record)
+{
+    RollupBucket bucket;
+    bucket.startMs = record.timestampMs;
+    bucket.min = record.values[0];
+    bucket.max = record.values[1];
+    bucket.avg = record.values[2];
+    bucket.p95 = record.values[3];
+    bucket.count = int(record.values[4]);
+    return bucket;
+}
+
+// 95th percentile by nearest rank; reorders values
+static float percentile95(QVector<float> &values)
+{
+    const int rank = qMax(0, int(std::ceil(values.size() * 0.95)) - 1);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values.at(rank);
+}
+
+static qint64 bucketStart(qint64 timestampMs, qint64 widthMs)
+{
+    // Floor division, correct for timestamps before the epoch too
+    const qint64 bucket = timestampMs / widthMs - (timestampMs % widthMs < 0 ? 1 : 0);
+    return bucket * widthMs;
+}
+
+RollupSeries::RollupSeries()
+    : m_lastTimestampMs(kNoBucket)
+    , m_store(nullptr)
+    , m_storeIndex(-1)
+{
+    for (int level = 0; level < RollupLevelCount; ++level) {
+        m_levels[level].closed.setCapacity(kLevelCapacity[level]);
+        m_levels[level].skipBeforeMs = kNoBucket;
+        m_levels[level].openStartMs = kNoBucket;
+        m_levels[level].openP95 = 0.0f;
+        m_levels[level].openP95Count = 0;
+    }
+}
+
+qint64 RollupSeries::bucketWidthMs(RollupLevel level)
+{
+    return level == MinuteRollup ? 60 * 1000 : 3600 * 1000;
+}
+
+void RollupSeries::append(qint64 timestampMs, float value)
+{
+    appendBulk(&timestampMs, &value, 1);
+}
+
+void RollupSeries::appendBulk(const qint64 *timestampsMs, const float *values, int count)
+{
+    // A viewer back-fills the writer's newest record and then receives the
+    // same snapshot live, so a repeated timestamp is a repeated sample
+    int begin = 0;
+    while (begin < count && m_lastTimestampMs != kNoBucket && timestampsMs[begin] <= m_lastTimestampMs) {
+        ++begin;
+    }
+    if (begin == count) {
+        return;
+    }
+    for (int id = 0; id < RollupLevelCount; ++id) {
+        const qint64 width = bucketWidthMs(RollupLevel(id));
+        // Each run of samples sharing a bucket is aggregated in one call
+        int runStart = begin;
+        while (runStart < count && timestampsMs[runStart] < m_levels[id].skipBeforeMs) {
+            ++runStart;
+        }
+        while (runStart < count) {
+            const qint64 start = bucketStart(timestampsMs[runStart], width);
+            int runEnd = runStart + 1;
+            while (runEnd < count && timestampsMs[runEnd] < start + width) {
+                ++runEnd;
+            }
+            appendRun(RollupLevel(id), start, values + runStart, runEnd - runStart);
+            runStart = runEnd;
+        }
+    }
+    m_lastTimestampMs = timestampsMs[count - 1];
+}
+
+void RollupSeries::appendRun(RollupLevel id, qint64 bucketStartMs, const float *values, int count)
+{
+    Level &level = m_levels[id];
+    if (level.openStartMs != bucketStartMs) {
+        if (level.openStartMs != kNoBucket) {
+            closeBucket(id);
+        }
+        level.openStartMs = bucketStartMs;
+        level.openValues.resize(0);
+        level.openP95Count = 0;
+        level.openMin = std::numeric_limits<float>::max();
+        level.openMax = std::numeric_limits<float>::lowest();
+        level.openSum = 0.0;
+    }
+    const RollupAggregate aggregate = RollupKernels::aggregate(values, count);
+    level.openMin = qMin(level.openMin, aggregate.min);
+    level.openMax = qMax(level.openMax, aggregate.max);
+    level.openSum += aggregate.sum;
+    const int size = level.openValues.size();
+    level.openValues.resize(size + count);
+    std::copy(values, values + count, level.openValues.begin() + size);
+}
+
+RollupBucket RollupSeries::openBucket(const Level &level)
+{
+    RollupBucket bucket;
+    bucket.startMs = level.openStartMs;
+    bucket.min = level.openMin;
+    bucket.max = level.openMax;
+    bucket.count = level.openValues.size();
+    bucket.avg = bucket.count > 0 ? float(level.openSum / bucket.count) : 0.0f;
+    // Charts query far more often than a minute bucket fills
+    if (level.openP95Count != bucket.count) {
+        level.openP95 = bucket.count > 0 ? percentile95(level.openValues) : 0.0f;
+        level.openP95Count = bucket.count;
+    }
+    bucket.p95 = level.openP95;
+    return bucket;
+}
+
+void RollupSeries::closeBucket(RollupLevel id)
+{
+    Level &level = m_levels[id];
+    if (level.openValues.isEmpty()) {
+        return;
+    }
+    RollupBucket bucket;
+    bucket.startMs = level.openStartMs;
+    bucket.min = level.openMin;
+    bucket.max = level.openMax;
+    bucket.count = level.openValues.size();
+    bucket.avg = float(level.openSum / bucket.count);
+    bucket.p95 = percentile95(level.openValues);
+    if (m_store) {
+        m_store->append(m_storeIndex, id, bucket);
+    } else {
+        level.closed.append(bucket);
+    }
+}
+
+void RollupSeries::persistTo(RollupStore *store, int index)
+{
+    m_store = store;
+    m_storeIndex = index;
+    QVector<RollupBucket> stored;
+    for (int id = 0; id < RollupLevelCount; ++id) {
+        Level &level = m_levels[id];
+        // Nothing is read back from memory, the store keeps the buckets
+        level.closed = RingBuffer<RollupBucket>(1);
+        store->query(index, RollupLevel(id), stored);
+        if (!stored.isEmpty()) {
+            level.skipBeforeMs = stored.last().startMs + bucketWidthMs(RollupLevel(id));
+        }
+    }
+}
+
+void RollupSeries::restore(const RollupStore &store, int index)
+{
+    QVector<RollupBucket> stored;
+    for (int id = 0; id < RollupLevelCount; ++id) {
+        Level &level = m_levels[id];
+        store.query(index, RollupLevel(id), stored);
+        for (const RollupBucket &bucket : std::as_const(stored)) {
+            level.closed.append(bucket);
+        }
+        if (!stored.isEmpty()) {
+            level.skipBeforeMs = stored.last().startMs + bucketWidthMs(RollupLevel(id));
+        }
+    }
+}
+
+bool RollupSeries::isEmpty() const
+{
+    return m_lastTimestampMs == kNoBucket;
+}
+
+qint64 RollupSeries::oldestTimestamp() const
+{
+    qint64 oldest = m_lastTimestampMs;
+    for (const Level &level : m_levels) {
+        if (!level.closed.isEmpty()) {
+            oldest = qMin(oldest, level.closed.first().startMs);
+        } else if (level.openStartMs != kNoBucket) {
+            oldest = qMin(oldest, level.openStartMs);
+        }
+    }
+    return oldest;
+}
+
+void RollupSeries::query(RollupLevel level, qint64 fromMs, qint64 toMs, QVector<RollupBucket> &out) const
+{
+    out.resize(0);
+    const Level &source = m_levels[level];
+    const qint64 width = bucketWidthMs(level);
+
+    // First closed bucket ending after fromMs
+    int low = 0;
+    int high = source.closed.size();
+    while (low < high) {
+        const int mid = (low + high) / 2;
+        if (source.closed.at(mid).startMs + width <= fromMs) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    for (int i = low; i < source.closed.size() && source.closed.at(i).startMs <= toMs; ++i) {
+        out.append(source.closed.at(i));
+    }
+    if (source.openStartMs != kNoBucket && !source.openValues.isEmpty() &&
+        source.openStartMs + width > fromMs && source.openStartMs <= toMs) {
+        out.append(openBucket(source));
+    }
+}
+
+int RollupEngine::indexOf(MetricFamily family, int channel) const
+{
+    for (int i = 0; i < kRollupSeriesCount; ++i) {
+        if (kRolledUp[i].family == family && kRolledUp[i].channel == channel) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const RollupSeries *RollupEngine::series(MetricFamily family, int channel) const
+{
+    const int index = indexOf(family, channel);
+    return index >= 0 ? &m_series[index] : nullptr;
+}
+
+void RollupEngine::append(MetricFamily family, const HistoryRecord &record)
+{
+    for (int i = 0; i < kRollupSeriesCount; ++i) {
+        if (kRolledUp[i].family == family) {
+            m_series[i].append(record.timestampMs, record.values[kRolledUp[i].channel]);
+        }
+    }
+}
+
+void RollupEngine::backfill(MetricFamily family, const QVector<HistoryRecord> &records)
+{
+    // Transpose into contiguous columns so the kernels can stream them
+    QVector<qint64> timestamps(records.size());
+    QVector<float> values(records.size());
+    for (int i = 0; i < records.size(); ++i) {
+        timestamps[i] = records.at(i).timestampMs;
+    }
+    for (int i = 0; i < kRollupSeriesCount; ++i) {
+        if (kRolledUp[i].family != family) {
+            continue;
+        }
+        for (int r = 0; r < records.size(); ++r) {
+            values[r] = records.at(r).values[kRolledUp[i].channel];
+        }
+        m_series[i].appendBulk(timestamps.constData(), values.constData(), records.size());
+    }
+}
+
+void RollupEngine::persistTo(RollupStore *store)
+{
+    for (int i = 0; i < kRollupSeriesCount; ++i) {
+        m_series[i].persistTo(store, i);
+    }
+}
+
+void RollupEngine::restore(const RollupStore &store)
+{
+    for (int i = 0; i < kRollupSeriesCount; ++i) {
+        m_series[i].restore(store, i);
+    }
+}
+
+bool RollupStore::open(const QString &directory)
+{
+    if (!QDir().mkpath(directory)) {
+        return false;
+    }
+    bool opened = true;
+    for (int i = 0; i < kRollupSeriesCount; ++i) {
+        for (int level = 0; level < RollupLevelCount; ++level) {
+            const RollupLevel id = RollupLevel(level);
+            opened &= m_rings[i][level].open(storePath(directory, i, id), storeTag(i, id), kLevelCapacity[level]);
+        }
+    }
+    return opened;
+}
+
+bool RollupStore::openReadOnly(const QString &directory)
+{
+    bool opened = false;
+    for (int i = 0; i < kRollupSeriesCount; ++i) {
+        for (int level = 0; level < RollupLevelCount; ++level) {
+            const RollupLevel id = RollupLevel(level);
+            opened |= m_rings[i][level].openReadOnly(storePath(directory, i, id), storeTag(i, id));
+        }
+    }
+    return opened;
+}
+
+void RollupStore::close()
+{
+    for (auto &rings : m_rings) {
+        for (HistoryRing &ring : rings) {
+            ring.close();
+        }
+    }
+}
+
+bool RollupStore::isWritable() const
+{
+    const HistoryRing &ring = m_rings[0][MinuteRollup];
+    return ring.isOpen() && !ring.isReadOnly();
+}
+
+void RollupStore::append(int series, RollupLevel level, const RollupBucket &bucket)
+{
+    m_rings[series][level].append(toRecord(bucket));
+}
+
+void RollupStore::query(int series, RollupLevel level, QVector<RollupBucket> &out) const
+{
+    out.resize(0);
+    QVector<HistoryRecord> records;
+    m_rings[series][level].query(std::numeric_limits<qint64>::min(), std::numeric_limits<qint64>::max(), records);
+    out.reserve(records.size());
+    for (const HistoryRecord &record : std::as_const(records)) {
+        out.append(toBucket(record));
+    }
+}
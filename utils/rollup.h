@@ -0,0 +1,146 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <QVector>
+#include <QtGlobal>
+#include "historystore.h"
+#include "ringbuffer.h"
+#include "samplingscheduler.h"
+
+// Aggregates of the samples whose timestamps fall in [startMs, startMs + width)
+struct RollupBucket {
+    qint64 startMs;
+    float min;
+    float max;
+    float avg;
+    float p95;
+    int count;
+};
+
+enum RollupLevel {
+    MinuteRollup,
+    HourRollup,
+    RollupLevelCount
+};
+
+// Channels RollupEngine rolls up
+constexpr int kRollupSeriesCount = 6;
+
+class RollupStore;
+
+/**
+ * @brief Minute and hour rollups of one series, maintained as samples arrive
+ *
+ * Each level accumulates its open bucket and moves it into a ring of
+ * closed buckets once a sample lands in a later bucket. Minute buckets
+ * are kept for about eleven days and hour buckets for about a year.
+ *
+ * With a RollupStore attached, closed buckets are written there instead
+ * of being kept, and samples falling in buckets the store already holds
+ * are skipped, so re-reading the raw history after a restart does not
+ * aggregate them twice.
+ */
+class RollupSeries
+{
+public:
+    RollupSeries();
+
+    static qint64 bucketWidthMs(RollupLevel level);
+
+    // Timestamps must increase; older and repeated ones are ignored
+    void append(qint64 timestampMs, float value);
+    // Same as appending each sample in turn, aggregating runs in bulk
+    void appendBulk(const qint64 *timestampsMs, const float *values, int count);
+
+    bool isEmpty() const;
+    qint64 oldestTimestamp() const;
+
+    // Buckets of level overlapping [fromMs, toMs], oldest first; the last
+    // one may be the still open bucket. Not safe alongside other calls.
+    void query(RollupLevel level, qint64 fromMs, qint64 toMs, QVector<RollupBucket> &out) const;
+
+    // Closed buckets go to store as series index from now on
+    void persistTo(RollupStore *store, int index);
+    // Loads the closed buckets store holds for series index
+    void restore(const RollupStore &store, int index);
+
+private:
+    struct Level {
+        RingBuffer<RollupBucket> closed;
+        // Samples before this belong to buckets already stored
+        qint64 skipBeforeMs;
+        qint64 openStartMs;
+        // Kept for the percentile, in no particular order: queries reorder
+        // them in place instead of copying
+        mutable QVector<float> openValues;
+        // p95 of the open bucket at the size it was last queried at
+        mutable float openP95;
+        mutable int openP95Count;
+        float openMin;
+        float openMax;
+        double openSum;
+    };
+
+    void appendRun(RollupLevel id, qint64 bucketStartMs, const float *values, int count);
+    void closeBucket(RollupLevel id);
+    static RollupBucket openBucket(const Level &level);
+
+    Level m_levels[RollupLevelCount];
+    qint64 m_lastTimestampMs;
+    RollupStore *m_store;
+    int m_storeIndex;
+};
+
+/**
+ * @brief Closed rollup buckets of every rolled-up channel, on disk
+ *
+ * One HistoryRing per channel and level, next to the raw history, each as
+ * long as the in-memory ring of its level. The collecting process writes
+ * them as buckets close; views restore from them, so long spans survive a
+ * restart although the raw history only covers a day.
+ */
+class RollupStore
+{
+public:
+    bool open(const QString &directory);
+    bool openReadOnly(const QString &directory);
+    void close();
+    bool isWritable() const;
+
+    void append(int series, RollupLevel level, const RollupBucket &bucket);
+    // Every stored bucket, oldest first
+    void query(int series, RollupLevel level, QVector<RollupBucket> &out) const;
+
+private:
+    HistoryRing m_rings[kRollupSeriesCount][RollupLevelCount];
+};
+
+/**
+ * @brief Rollups of the history channels shown at long time spans
+ *
+ * Fed one HistoryRecord per recorded family and sample, and back-filled
+ * at startup from the stored buckets, then from the on-disk history for
+ * the time after them.
+ */
+class RollupEngine
+{
+public:
+    // Null for channels that are not rolled up
+    const RollupSeries *series(MetricFamily family, int channel) const;
+
+    void append(MetricFamily family, const HistoryRecord &record);
+    void backfill(MetricFamily family, const QVector<HistoryRecord> &records);
+
+    // For the collecting process: closed buckets are written to store,
+    // which must stay open while this engine lives
+    void persistTo(RollupStore *store);
+    // For views: starts from the buckets store holds
+    void restore(const RollupStore &store);
+
+private:
+    int indexOf(MetricFamily family, int channel) const;
+
+    RollupSeries m_series[kRollupSeriesCount];
+};
+
+#endif // ROLLUP_H
@@ -0,0 +1,181 @@
+#include "rollupkernels.h"
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ROLLUP_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang compile the wide kernels for their instruction set only;
+// MSVC accepts the intrinsics anywhere
+#if defined(ROLLUP_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ROLLUP_TARGET(isa) __attribute__((target(isa)))
+#else
+#define ROLLUP_TARGET(isa)
+#endif
+
+namespace RollupKernels {
+
+static RollupAggregate emptyAggregate()
+{
+    return {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(), 0.0, 0};
+}
+
+// Folds values[begin, count) into result
+static void aggregateTail(const float *values, int begin, int count, RollupAggregate &result)
+{
+    for (int i = begin; i < count; ++i) {
+        result.min = qMin(result.min, values[i]);
+        result.max = qMax(result.max, values[i]);
+        result.sum += values[i];
+    }
+    result.count = count;
+}
+
+RollupAggregate aggregateScalar(const float *values, int count)
+{
+    RollupAggregate result = emptyAggregate();
+    aggregateTail(values, 0, count, result);
+    return result;
+}
+
+#ifdef ROLLUP_X86
+
+ROLLUP_TARGET("sse2")
+RollupAggregate aggregateSse2(const float *values, int count)
+{
+    RollupAggregate result = emptyAggregate();
+    __m128 minimum = _mm_set1_ps(result.min);
+    __m128 maximum = _mm_set1_ps(result.max);
+    // Sums are kept in double, a day of samples would lose precision in float
+    __m128d sumLow = _mm_setzero_pd();
+    __m128d sumHigh = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 v = _mm_loadu_ps(values + i);
+        minimum = _mm_min_ps(minimum, v);
+        maximum = _mm_max_ps(maximum, v);
+        sumLow = _mm_add_pd(sumLow, _mm_cvtps_pd(v));
+        sumHigh = _mm_add_pd(sumHigh, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, minimum);
+    result.min = qMin(qMin(lanes[0], lanes[1]), qMin(lanes[2], lanes[3]));
+    _mm_store_ps(lanes, maximum);
+    result.max = qMax(qMax(lanes[0], lanes[1]), qMax(lanes[2], lanes[3]));
+    alignas(16) double sums[2];
+    _mm_store_pd(sums, _mm_add_pd(sumLow, sumHigh));
+    result.sum = sums[0] + sums[1];
+    aggregateTail(values, i, count, result);
+    return result;
+}
+
+ROLLUP_TARGET("avx2")
+RollupAggregate aggregateAvx2(const float *values, int count)
+{
+    RollupAggregate result = emptyAggregate();
+    __m256 minimum = _mm256_set1_ps(result.min);
+    __m256 maximum = _mm256_set1_ps(result.max);
+    __m256d sumLow = _mm256_setzero_pd();
+    __m256d sumHigh = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 v = _mm256_loadu_ps(values + i);
+        minimum = _mm256_min_ps(minimum, v);
+        maximum = _mm256_max_ps(maximum, v);
+        sumLow = _mm256_add_pd(sumLow, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+        sumHigh = _mm256_add_pd(sumHigh, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, minimum);
+    for (float lane : lanes) {
+        result.min = qMin(result.min, lane);
+    }
+    _mm256_store_ps(lanes, maximum);
+    for (float lane : lanes) {
+        result.max = qMax(result.max, lane);
+    }
+    alignas(32) double sums[4];
+    _mm256_store_pd(sums, _mm256_add_pd(sumLow, sumHigh));
+    result.sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    aggregateTail(values, i, count, result);
+    return result;
+}
+
+static bool hasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    // AVX state must be enabled by the OS, not just present in the CPU
+    const bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return osSavesAvx && (info[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool hasSse2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+    return true; // Part of the x86-64 baseline
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return info[3] & (1 << 26);
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+#else
+
+RollupAggregate aggregateSse2(const float *values, int count)
+{
+    return aggregateScalar(values, count);
+}
+
+RollupAggregate aggregateAvx2(const float *values, int count)
+{
+    return aggregateScalar(values, count);
+}
+
+static bool hasAvx2() { return false; }
+static bool hasSse2() { return false; }
+
+#endif // ROLLUP_X86
+
+typedef RollupAggregate (*AggregateKernel)(const float *, int);
+
+struct Dispatch {
+    AggregateKernel kernel;
+    const char *name;
+};
+
+static const Dispatch &dispatch()
+{
+    static const Dispatch chosen = hasAvx2()   ? Dispatch{aggregateAvx2, "avx2"}
+                                   : hasSse2() ? Dispatch{aggregateSse2, "sse2"}
+                                               : Dispatch{aggregateScalar, "scalar"};
+    return chosen;
+}
+
+RollupAggregate aggregate(const float *values, int count)
+{
+    // Short runs are not worth the horizontal reductions
+    if (count < 16) {
+        return aggregateScalar(values, count);
+    }
+    return dispatch().kernel(values, count);
+}
+
+const char *activeKernel()
+{
+    return dispatch().name;
+}
+
+} // namespace RollupKernels
@@ -0,0 +1,34 @@
+#ifndef ROLLUPKERNELS_H
+#define ROLLUPKERNELS_H
+
+#include <QtGlobal>
+
+// Min, max and sum over a run of samples
+struct RollupAggregate {
+    float min;
+    float max;
+    double sum;
+    int count;
+};
+
+/**
+ * @brief Bulk aggregation kernels for the rollup engine
+ *
+ * aggregate() picks the widest implementation the CPU supports the first
+ * time it is called: AVX2, then SSE2 on x86, else a scalar loop. Samples
+ * arriving one at a time do not need this; it pays off when back-filling
+ * or re-bucketing thousands of samples at once.
+ */
+namespace RollupKernels {
+    RollupAggregate aggregate(const float *values, int count);
+
+    // The individual implementations, for benchmarks and tests
+    RollupAggregate aggregateScalar(const float *values, int count);
+    RollupAggregate aggregateSse2(const float *values, int count);
+    RollupAggregate aggregateAvx2(const float *values, int count);
+
+    // Name of the implementation aggregate() dispatches to
+    const char *activeKernel();
+}
+
+#endif // ROLLUPKERNELS_H
@@ -0,0 +1,85 @@
+#include "samplingpolicy.h"
+
+// Host CPU usage below which a sample counts as idle, in percent
+static constexpr double kIdleThreshold = 5.0;
+// Process table slowdown while the host is idle
+static constexpr int kIdleFactor = 2;
+// Floors of the periods while no view is visible, in ms
+static constexpr int kHiddenCheapPeriodMs = 5000;
+static constexpr int kHiddenDiskPeriodMs = 60000;
+// Wall time the cost is averaged over before the backoff changes
+static constexpr qint64 kCostWindowNs = 10000000000LL;
+static constexpr int kMaxBackoff = 16;
+
+SamplingPolicy::SamplingPolicy()
+    : m_visible(true)
+    , m_cpuBudget(0.0)
+    , m_backoff(1)
+    , m_idleSamples(0)
+    , m_windowCpuNs(0)
+    , m_windowWallNs(0)
+{
+    for (int &period : m_basePeriods) {
+        period = 1000;
+    }
+}
+
+void SamplingPolicy::setBasePeriod(MetricFamily family, int periodMs)
+{
+    m_basePeriods[family] = qMax(1, periodMs);
+}
+
+void SamplingPolicy::setCpuBudget(double percent)
+{
+    m_cpuBudget = qMax(0.0, percent);
+    if (m_cpuBudget == 0.0) {
+        m_backoff = 1;
+    }
+    m_windowCpuNs = 0;
+    m_windowWallNs = 0;
+}
+
+void SamplingPolicy::addCost(qint64 cpuNs, qint64 wallNs)
+{
+    if (m_cpuBudget == 0.0 || wallNs <= 0) {
+        return;
+    }
+    m_windowCpuNs += qMax<qint64>(0, cpuNs);
+    m_windowWallNs += wallNs;
+    if (m_windowWallNs < kCostWindowNs) {
+        return;
+    }
+    const double usage = 100.0 * double(m_windowCpuNs) / double(m_windowWallNs);
+    if (usage > m_cpuBudget) {
+        m_backoff = qMin(kMaxBackoff, m_backoff * 2);
+    } else if (usage < m_cpuBudget / 2) {
+        m_backoff = qMax(1, m_backoff / 2);
+    }
+    m_windowCpuNs = 0;
+    m_windowWallNs = 0;
+}
+
+void SamplingPolicy::addHostCpuUsage(double percent)
+{
+    if (percent < kIdleThreshold) {
+        m_idleSamples = qMin(kIdleSamples, m_idleSamples + 1);
+    } else {
+        m_idleSamples = 0;
+    }
+}
+
+int SamplingPolicy::period(MetricFamily family) const
+{
+    int periodMs = m_basePeriods[family];
+    if (family == ProcessFamily || family == ProcessDetailFamily) {
+        if (!m_visible) {
+            return 0;
+        }
+        if (family == ProcessFamily && isHostIdle()) {
+            periodMs *= kIdleFactor;
+        }
+    } else if (!m_visible) {
+        periodMs = qMax(periodMs, family == DiskFamily ? kHiddenDiskPeriodMs : kHiddenCheapPeriodMs);
+    }
+    return periodMs * m_backoff;
+}
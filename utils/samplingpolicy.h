@@ -0,0 +1,62 @@
+#ifndef SAMPLINGPOLICY_H
+#define SAMPLINGPOLICY_H
+
+#include <QtGlobal>
+#include "samplingscheduler.h"
+
+/**
+ * @brief Decides how often each metric family is actually sampled
+ *
+ * The base periods are what the user asked for. The effective period
+ * stretches them when nobody is looking or the monitor costs too much:
+ *
+ * - While no view is visible the process table and its details are
+ *   paused, disk capacity slows to once a minute and the cheap counters
+ *   to every few seconds, so history keeps filling in at a lower
+ *   resolution.
+ * - While the host has been idle for several samples in a row the
+ *   process table is sampled at half its rate; it returns to full rate
+ *   on the first busy sample.
+ * - When the monitor's own CPU time over the last window exceeds the
+ *   budget, every period is doubled, up to a limit; once the cost drops
+ *   below half the budget the backoff is halved again.
+ *
+ * A period of 0 means the family is paused.
+ */
+class SamplingPolicy
+{
+public:
+    SamplingPolicy();
+
+    void setBasePeriod(MetricFamily family, int periodMs);
+    int basePeriod(MetricFamily family) const { return m_basePeriods[family]; }
+
+    void setVisible(bool visible) { m_visible = visible; }
+    bool isVisible() const { return m_visible; }
+
+    // Percent of one core the monitor may use; 0 disables the budget
+    void setCpuBudget(double percent);
+    double cpuBudget() const { return m_cpuBudget; }
+
+    // CPU time the monitor used over wallNs of wall time
+    void addCost(qint64 cpuNs, qint64 wallNs);
+    // Aggregate host CPU usage of the latest sample, in percent
+    void addHostCpuUsage(double percent);
+
+    int period(MetricFamily family) const;
+    int backoff() const { return m_backoff; }
+    bool isHostIdle() const { return m_idleSamples >= kIdleSamples; }
+
+private:
+    static constexpr int kIdleSamples = 5;
+
+    int m_basePeriods[MetricFamilyCount];
+    bool m_visible;
+    double m_cpuBudget;
+    int m_backoff;
+    int m_idleSamples;
+    qint64 m_windowCpuNs;
+    qint64 m_windowWallNs;
+};
+
+#endif // SAMPLINGPOLICY_H
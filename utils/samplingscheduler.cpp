@@ -0,0 +1,69 @@
+#include "samplingscheduler.h"
+
+// Families are allowed to fire this early to share a wakeup, as a
+// fraction of their period and capped in absolute terms
+static constexpr int kSlackDivisor = 8;
+static constexpr qint64 kMaxSlackMs = 50;
+// Wakeup interval while every family is paused
+static constexpr qint64 kPausedWakeupMs = 60000;
+
+SamplingScheduler::SamplingScheduler()
+{
+    for (Slot &slot : m_slots) {
+        slot.periodMs = 1000;
+        slot.nextDueMs = 0;
+    }
+}
+
+void SamplingScheduler::setPeriod(MetricFamily family, int periodMs)
+{
+    Slot &slot = m_slots[family];
+    periodMs = qMax(0, periodMs);
+    // Pull the deadline in if the new period is shorter; a paused family
+    // keeps its old deadline, which has passed by the time it resumes
+    if (periodMs > 0) {
+        slot.nextDueMs = qMin(slot.nextDueMs, slot.nextDueMs - slot.periodMs + periodMs);
+    }
+    slot.periodMs = periodMs;
+}
+
+void SamplingScheduler::reset(qint64 nowMs)
+{
+    for (Slot &slot : m_slots) {
+        slot.nextDueMs = nowMs;
+    }
+}
+
+qint64 SamplingScheduler::slack(const Slot &slot)
+{
+    return qMin<qint64>(slot.periodMs / kSlackDivisor, kMaxSlackMs);
+}
+
+MetricFamilies SamplingScheduler::takeDue(qint64 nowMs)
+{
+    MetricFamilies due = 0;
+    for (int family = 0; family < MetricFamilyCount; ++family) {
+        Slot &slot = m_slots[family];
+        if (slot.periodMs == 0 || slot.nextDueMs - slack(slot) > nowMs) {
+            continue;
+        }
+        due |= familyBit(static_cast<MetricFamily>(family));
+        // Skip missed periods instead of firing a burst to catch up
+        slot.nextDueMs += slot.periodMs;
+        if (slot.nextDueMs <= nowMs) {
+            slot.nextDueMs += ((nowMs - slot.nextDueMs) / slot.periodMs + 1) * slot.periodMs;
+        }
+    }
+    return due;
+}
+
+qint64 SamplingScheduler::msUntilNext(qint64 nowMs) const
+{
+    qint64 next = nowMs + kPausedWakeupMs;
+    for (const Slot &slot : m_slots) {
+        if (slot.periodMs > 0) {
+            next = qMin(next, slot.nextDueMs);
+        }
+    }
+    return qMax<qint64>(0, next - nowMs);
+}
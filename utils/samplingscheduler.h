@@ -0,0 +1,61 @@
+#ifndef SAMPLINGSCHEDULER_H
+#define SAMPLINGSCHEDULER_H
+
+#include <QtGlobal>
+
+// Groups of metrics that are sampled together
+enum MetricFamily {
+    CpuFamily,
+    MemoryFamily,
+    NetworkFamily,
+    ProcessFamily,
+    DiskFamily,
+    DiskIoFamily,
+    ProcessDetailFamily, // detail fields of the watched processes
+    MetricFamilyCount
+};
+
+// Bit set of (1 << MetricFamily)
+typedef int MetricFamilies;
+
+constexpr MetricFamilies familyBit(MetricFamily family) { return 1 << family; }
+constexpr MetricFamilies kAllFamilies = (1 << MetricFamilyCount) - 1;
+
+/**
+ * @brief Deadline bookkeeping for metric families sampled at different rates
+ *
+ * Every family has its own period. takeDue() returns all families whose
+ * deadline has passed or falls within a small slack window, so families
+ * that would have fired a few milliseconds apart share one wakeup. A
+ * family with a period of 0 is paused; it becomes due at once when it
+ * gets a period again.
+ */
+class SamplingScheduler
+{
+public:
+    SamplingScheduler();
+
+    void setPeriod(MetricFamily family, int periodMs);
+    int period(MetricFamily family) const { return m_slots[family].periodMs; }
+
+    // Makes every family due at nowMs
+    void reset(qint64 nowMs);
+
+    // Families due at nowMs; their deadlines move on by whole periods
+    MetricFamilies takeDue(qint64 nowMs);
+
+    // Milliseconds from nowMs until the next deadline, never negative
+    qint64 msUntilNext(qint64 nowMs) const;
+
+private:
+    struct Slot {
+        int periodMs;
+        qint64 nextDueMs;
+    };
+
+    static qint64 slack(const Slot &slot);
+
+    Slot m_slots[MetricFamilyCount];
+};
+
+#endif // SAMPLINGSCHEDULER_H
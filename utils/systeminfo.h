@@ -10,20 +10,70 @@ struct ProcessInfo {
     QString name;
     double cpuUsage;
     qint64 memoryUsage; // bytes
-    QString status;
+    qint64 ioBytesPerSec; // storage reads + writes
+    int threads;
+    QString status; // from the scheduler state: "Running", "Sleeping", ...
 
     bool operator<(const ProcessInfo &other) const {
         return cpuUsage > other.cpuUsage; //Sort descending
     }
 };
 
+// Fields that cost one or more file reads per process each, so they are
+// only loaded for the processes a view shows
+struct ProcessDetails {
+    quint32 pid;
+    quint32 uid;         // real user id
+    qint64 readBytes;    // storage bytes over the process lifetime, -1 if unreadable
+    qint64 writeBytes;
+    qint64 pssBytes;     // proportional set size, -1 if unreadable
+    QString commandLine; // arguments separated by spaces; empty for kernel threads
+};
+
+// Rankings kept for the process list
+enum ProcessSortKey {
+    SortByCpu,
+    SortByMemory,
+    SortByIo,
+    ProcessSortKeyCount
+};
+
+// CPU time breakdown over the last sampling interval, in percent
+struct CpuCoreUsage {
+    double usage;   // everything except idle and iowait
+    double user;    // user + nice
+    double system;
+    double iowait;
+    double irq;     // irq + softirq
+    double steal;   // time taken by the hypervisor
+};
+
+struct CpuInfo {
+    CpuCoreUsage total;
+    QVector<CpuCoreUsage> cores; // indexed by cpu number
+};
+
 struct MemoryInfo {
     qint64 totalPhysical;
-    qint64 availablePhysical;
-    qint64 usedPhysical;
+    qint64 availablePhysical; // what can be allocated without swapping
+    qint64 usedPhysical;      // total - available, page cache not included
     qint64 totalVirtual;
     qint64 availableVirtual;
     double usagePercentage;
+    // Breakdown, in bytes; zero where the platform does not report it
+    qint64 freePhysical;
+    qint64 buffers;
+    qint64 cached;
+    qint64 dirty;
+    qint64 writeback;
+    qint64 slab;
+    qint64 slabReclaimable;
+    qint64 shmem;
+    // Paging activity over the last sampling interval
+    double swapInPagesPerSec;
+    double swapOutPagesPerSec;
+    double pageFaultsPerSec;
+    double majorFaultsPerSec;
 };
 
 struct DiskInfo {
@@ -36,6 +86,18 @@ struct DiskInfo {
     QString fileSystem;
 };
 
+// Block device activity over the last sampling interval
+struct DiskIoStats {
+    QString name;
+    double readBytesPerSec;
+    double writeBytesPerSec;
+    double readIops;
+    double writeIops;
+    double avgQueueDepth;
+    double avgLatencyMs;  // average time per completed request (await)
+    double utilization;   // percent of time with requests in flight
+};
+
 struct NetworkStats {
     QString interfaceName;
     qint64 bytesReceived;
@@ -47,13 +109,41 @@ struct NetworkStats {
     qint64 sessionBytesSent;
 };
 
+// One network interface; rates cover the last sampling interval
+struct InterfaceStats {
+    QString name;
+    int index;
+    bool up;
+    quint64 rxBytes; // since the interface came up
+    quint64 txBytes;
+    double rxBytesPerSec;
+    double txBytesPerSec;
+    double rxPacketsPerSec;
+    double txPacketsPerSec;
+    double rxDropsPerSec;
+    double txDropsPerSec;
+    double rxErrorsPerSec;
+    double txErrorsPerSec;
+};
+
 // Platform-specific system information functions
 namespace SystemInfo {
     double getCpuUsage();
+    CpuInfo getCpuInfo();
     MemoryInfo getMemoryInfo();
     QVector<DiskInfo> getDiskInfo();
+    QVector<DiskIoStats> getDiskIoStats();
     NetworkStats getNetworkStats();
-    QVector<ProcessInfo> getTopProcesses(int count = 10);
+    QVector<InterfaceStats> getInterfaceStats(); // loopback excluded
+    QVector<ProcessInfo> getTopProcesses(int count = 10); // by memory usage
+    QVector<ProcessInfo> getProcesses(); // every process, unordered
+    // Details of those pids that were alive at the last getProcesses();
+    // details younger than maxAgeMs are served from a cache that only
+    // keeps the pids asked for last
+    QVector<ProcessDetails> getProcessDetails(const QVector<quint32> &pids, int maxAgeMs);
+
+    // Bounds the threads a process scan may use, including the caller
+    void setMaxScanThreads(int count);
 }
 
 #endif // SYSTEMINFO_H
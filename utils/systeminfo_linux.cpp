@@ -1,107 +1,212 @@
 #ifdef __linux__
 
 #include "systeminfo.h"
-#include <QFile>
-#include <QTextStream>
-#include <QDir>
-#include <QStorageInfo>
-#include <QDebug>
-#include <QRegularExpression>
+#include "procreader.h"
+#include "proccapture.h"
+#include "mounttable.h"
+#include "netlinkreader.h"
+#include "processcache.h"
+#include "topk.h"
+#include "keytable.h"
+#include <QHash>
+#include <net/if.h>
 #include <unistd.h>
-#include <sys/sysinfo.h>
-#include <algorithm>
+#include <sys/statvfs.h>
 
 namespace SystemInfo {
-    // Static variables for system-wide CPU calculation
-    // Tracks total CPU time across all cores from /proc/stat
-    static unsigned long long lastTotalUser = 0, lastTotalUserLow = 0, lastTotalSys =
-                                                                       0, lastTotalIdle = 0;
-    static bool cpuInitialized = false;
+    // Fields of a cpu line in /proc/stat, in kernel order
+    enum CpuField {
+        CpuUser, CpuNice, CpuSystem, CpuIdle, CpuIowait,
+        CpuIrq, CpuSoftirq, CpuSteal, CpuGuest, CpuGuestNice,
+        CpuFieldCount
+    };
+
+    // Previous tick counters of every cpu line, flattened row by row:
+    // row 0 is the aggregate "cpu" line, row n + 1 is "cpuN".
+    static QVector<quint64> lastCpuTicks;
+    static QVector<quint64> cpuTicks;
+
+    static CpuCoreUsage cpuUsageFromDelta(const quint64 *current, const quint64 *last) {
+        CpuCoreUsage usage = {};
+        quint64 delta[CpuFieldCount];
+        for (int i = 0; i < CpuFieldCount; ++i) {
+            // Counters may go backwards when a cpu is hot-plugged
+            delta[i] = current[i] >= last[i] ? current[i] - last[i] : 0;
+        }
+        // guest and guest_nice are already accounted in user and nice
+        quint64 total = 0;
+        for (int i = CpuUser; i <= CpuSteal; ++i) {
+            total += delta[i];
+        }
+        if (total == 0) {
+            return usage;
+        }
+        const quint64 idle = delta[CpuIdle] + delta[CpuIowait];
+        const double scale = 100.0 / total;
+        usage.usage = (total - idle) * scale;
+        usage.user = (delta[CpuUser] + delta[CpuNice]) * scale;
+        usage.system = delta[CpuSystem] * scale;
+        usage.iowait = delta[CpuIowait] * scale;
+        usage.irq = (delta[CpuIrq] + delta[CpuSoftirq]) * scale;
+        usage.steal = delta[CpuSteal] * scale;
+        return usage;
+    }
+
+    CpuInfo getCpuInfo() {
+        CpuInfo info = {};
+        static ProcFile statFile("/proc/stat");
+        if (!statFile.read()) {
+            return info;
+        }
+
+        // Parse every cpu line in one pass into a flat table
+        QVector<quint64> &ticks = cpuTicks;
+        ticks.fill(0);
+        ProcScanner scanner(statFile.data(), statFile.size());
+        while (scanner.startsWith("cpu", 3)) {
+            scanner.advance(3);
+            int row = 0;
+            if (scanner.atDigit()) {
+                row = static_cast<int>(scanner.number()) + 1;
+            }
+            if (ticks.size() < (row + 1) * CpuFieldCount) {
+                ticks.resize((row + 1) * CpuFieldCount);
+            }
+            quint64 *fields = ticks.data() + row * CpuFieldCount;
+            // Older kernels report fewer fields, the rest stay zero
+            for (int i = 0; i < CpuFieldCount && scanner.readNumber(fields[i]); ++i) {
+            }
+            scanner.nextLine();
+        }
+        if (ticks.isEmpty()) {
+            return info;
+        }
+
+        // On first call (or after the cpu count changed) only store the baseline
+        if (lastCpuTicks.size() == ticks.size()) {
+            const int rows = ticks.size() / CpuFieldCount;
+            info.total = cpuUsageFromDelta(ticks.constData(), lastCpuTicks.constData());
+            info.cores.resize(rows - 1);
+            for (int row = 1; row < rows; ++row) {
+                info.cores[row - 1] = cpuUsageFromDelta(ticks.constData() + row * CpuFieldCount,
+                                                        lastCpuTicks.constData() + row * CpuFieldCount);
+            }
+        } else {
+            info.cores.resize(ticks.size() / CpuFieldCount - 1);
+        }
+        // Swap rather than copy so neither table reallocates next tick
+        lastCpuTicks.swap(ticks);
+        return info;
+    }
+
     double getCpuUsage() {
-        // Read system-wide CPU statistics from /proc/stat
-        QFile file("/proc/stat");
-        if (!file.open(QIODevice::ReadOnly)) {
-            return 0.0;
-        }
-        QTextStream in(&file);
-        QString line = in.readLine();
-        file.close();
-        // Parse first line (system-wide): cpu user nice system idle iowait irq
-        softirq
-            QStringList parts = line.split(' ', Qt::SkipEmptyParts);
-        if (parts.size() < 5) {
-            return 0.0;
-        }
-        unsigned long long totalUser = parts[1].toULongLong();
-        unsigned long long totalUserLow = parts[2].toULongLong();
-        unsigned long long totalSys = parts[3].toULongLong();
-        unsigned long long totalIdle = parts[4].toULongLong();
-        // On first call, store baseline values and return 0
-        if (!cpuInitialized) {
-            lastTotalUser = totalUser;
-            lastTotalUserLow = totalUserLow;
-            lastTotalSys = totalSys;
-            lastTotalIdle = totalIdle;
-            cpuInitialized = true;
-            return 0.0;
-        }
-        // Calculate system-wide CPU usage percentage
-        unsigned long long total = (totalUser - lastTotalUser) + (totalUserLow -
-                                                                  lastTotalUserLow) +
-                                   (totalSys - lastTotalSys);
-        unsigned long long totalDelta = total + (totalIdle - lastTotalIdle);
-        double percent = 0.0;
-        if (totalDelta > 0) {
-            percent = (total * 100.0) / totalDelta;
-        }
-        lastTotalUser = totalUser;
-        lastTotalUserLow = totalUserLow;
-        lastTotalSys = totalSys;
-        lastTotalIdle = totalIdle;
-        return percent;
+        return getCpuInfo().total.usage;
+    }
+
+    // Fields used from /proc/meminfo (kB) and /proc/vmstat (counts)
+    enum MemoryKey {
+        MemTotal, MemFree, MemAvailable, Buffers, Cached, Dirty, Writeback,
+        Slab, SReclaimable, Shmem, SwapTotal, SwapFree,
+        PswpIn, PswpOut, PgFault, PgMajFault,
+        MemoryKeyCount
+    };
+    static constexpr const char *memoryKeyNames[MemoryKeyCount] = {
+        "MemTotal", "MemFree", "MemAvailable", "Buffers", "Cached", "Dirty", "Writeback",
+        "Slab", "SReclaimable", "Shmem", "SwapTotal", "SwapFree",
+        "pswpin", "pswpout", "pgfault", "pgmajfault"
+    };
+    // Both files have dozens of lines we skip; each costs one hash probe
+    static constexpr KeyTable<MemoryKeyCount, 64> memoryKeys(memoryKeyNames);
+    static_assert(memoryKeys.isValid(), "no collision-free seed for the memory key table");
+
+    // Parses "key<separator> value" lines, storing the values of known keys
+    static void parseMemoryKeys(const ProcFile &file, char separator, quint64 values[MemoryKeyCount]) {
+        ProcScanner scanner(file.data(), file.size());
+        for (; !scanner.atEnd(); scanner.nextLine()) {
+            const char *key = scanner.position();
+            if (!scanner.skipPast(separator)) {
+                continue;
+            }
+            const int id = memoryKeys.find(key, static_cast<int>(scanner.position() - key) - 1);
+            if (id >= 0) {
+                values[id] = scanner.number();
+            }
+        }
     }
+
     MemoryInfo getMemoryInfo() {
         MemoryInfo info = {};
-        struct sysinfo memInfo;
-        sysinfo(&memInfo);
-        long long totalPhysical = memInfo.totalram;
-        totalPhysical *= memInfo.mem_unit;
-        long long availPhysical = memInfo.freeram;
-        availPhysical *= memInfo.mem_unit;
-        info.totalPhysical = totalPhysical;
-        info.availablePhysical = availPhysical;
-        info.usedPhysical = totalPhysical - availPhysical;
-        info.totalVirtual = memInfo.totalswap * memInfo.mem_unit;
-        info.availableVirtual = memInfo.freeswap * memInfo.mem_unit;
+        static ProcFile meminfoFile("/proc/meminfo");
+        static ProcFile vmstatFile("/proc/vmstat");
+        static quint64 lastVmstat[MemoryKeyCount] = {};
+        static SampleClock clock;
+        if (!meminfoFile.read()) {
+            return info;
+        }
+        quint64 values[MemoryKeyCount] = {};
+        parseMemoryKeys(meminfoFile, ':', values);
+        const bool hasAvailable = values[MemAvailable] != 0;
+
+        // Values in /proc/meminfo are in kB
+        auto bytes = [&values](MemoryKey key) { return static_cast<qint64>(values[key]) * 1024; };
+        info.totalPhysical = bytes(MemTotal);
+        // Kernels before 3.14 have no MemAvailable; approximate it the old way
+        info.availablePhysical = hasAvailable ? bytes(MemAvailable)
+                                              : bytes(MemFree) + bytes(Buffers) + bytes(Cached);
+        info.usedPhysical = info.totalPhysical - info.availablePhysical;
+        info.totalVirtual = bytes(SwapTotal);
+        info.availableVirtual = bytes(SwapFree);
+        info.freePhysical = bytes(MemFree);
+        info.buffers = bytes(Buffers);
+        info.cached = bytes(Cached);
+        info.dirty = bytes(Dirty);
+        info.writeback = bytes(Writeback);
+        info.slab = bytes(Slab);
+        info.slabReclaimable = bytes(SReclaimable);
+        info.shmem = bytes(Shmem);
         if (info.totalPhysical > 0) {
             info.usagePercentage = (info.usedPhysical * 100.0) / info.totalPhysical;
         }
+
+        // Paging activity from /proc/vmstat, as rates since the previous call
+        if (vmstatFile.read()) {
+            parseMemoryKeys(vmstatFile, ' ', values);
+            const double seconds = clock.isValid() ? clock.nsecsElapsed() / 1e9 : 0.0;
+            clock.start();
+            auto rate = [&](MemoryKey key) {
+                return values[key] >= lastVmstat[key] ? (values[key] - lastVmstat[key]) / seconds : 0.0;
+            };
+            if (seconds > 0.0) {
+                info.swapInPagesPerSec = rate(PswpIn);
+                info.swapOutPagesPerSec = rate(PswpOut);
+                info.pageFaultsPerSec = rate(PgFault);
+                info.majorFaultsPerSec = rate(PgMajFault);
+            }
+            for (int key = PswpIn; key <= PgMajFault; ++key) {
+                lastVmstat[key] = values[key];
+            }
+        }
         return info;
     }
+
     QVector<DiskInfo> getDiskInfo() {
         QVector<DiskInfo> disks;
-        QList<QStorageInfo> volumes = QStorageInfo::mountedVolumes();
-        for (const QStorageInfo &storage : volumes) {
-            if (!storage.isValid() || storage.isReadOnly()) {
-                continue;
-            }
-            // Skip special filesystems
-            QString fsType = QString::fromUtf8(storage.fileSystemType());
-            if (fsType.startsWith("tmpfs") || fsType.startsWith("devtmpfs") ||
-                fsType.startsWith("proc") || fsType.startsWith("sys")) {
+        // Only re-parsed when the kernel signals a mount change
+        static MountTable mountTable;
+        mountTable.refresh();
+        disks.reserve(mountTable.mounts().size());
+        for (const MountTable::Mount &mount : mountTable.mounts()) {
+            struct statvfs vfs;
+            if (!ProcReader::statFileSystem(mount.path, vfs)) {
                 continue;
             }
-            DiskInfo disk;
-            disk.name = storage.name();
-            if (disk.name.isEmpty()) {
-                disk.name = storage.device();
-            }
-
-            disk.mountPoint = storage.rootPath();
-            disk.totalSpace = storage.bytesTotal();
-            disk.availableSpace = storage.bytesAvailable();
+            DiskInfo disk = {};
+            disk.name = mount.device;
+            disk.mountPoint = mount.mountPoint;
+            disk.totalSpace = static_cast<qint64>(vfs.f_blocks) * vfs.f_frsize;
+            disk.availableSpace = static_cast<qint64>(vfs.f_bavail) * vfs.f_frsize;
             disk.usedSpace = disk.totalSpace - disk.availableSpace;
-            disk.fileSystem = fsType;
+            disk.fileSystem = mount.fileSystem;
             if (disk.totalSpace > 0) {
                 disk.usagePercentage = (disk.usedSpace * 100.0) / disk.totalSpace;
                 disks.append(disk);
@@ -109,87 +214,311 @@ namespace SystemInfo {
         }
         return disks;
     }
+
+    // Per-device counters of the previous /proc/diskstats read
+    struct DiskCounters {
+        QString name;
+        bool wholeDisk = false;
+        quint64 generation = 0;
+        quint64 reads = 0, sectorsRead = 0, readMs = 0;
+        quint64 writes = 0, sectorsWritten = 0, writeMs = 0;
+        quint64 ioMs = 0, weightedIoMs = 0;
+    };
+
+    // Only whole physical disks are reported. Partitions would count the
+    // same I/O twice, and so would device-mapper and md devices, which
+    // list the disks underneath them in slaves/; loop and ram devices are
+    // not interesting
+    static bool isWholeDisk(const QByteArray &name) {
+        if (name.startsWith("loop") || name.startsWith("ram") || name.startsWith("zram")) {
+            return false;
+        }
+        const QByteArray device = QByteArray(ProcReader::root()) + "/sys/block/" + name;
+        return ProcReader::exists(device) && !ProcReader::hasEntries(device + "/slaves");
+    }
+
+    QVector<DiskIoStats> getDiskIoStats() {
+        QVector<DiskIoStats> result;
+        static ProcFile diskstatsFile("/proc/diskstats");
+        static QHash<quint64, DiskCounters> devices;
+        static quint64 generation = 0;
+        static SampleClock clock;
+        if (!diskstatsFile.read()) {
+            return result;
+        }
+        const double elapsedMs = clock.isValid() ? clock.nsecsElapsed() / 1e6 : 0.0;
+        clock.start();
+        ++generation;
+
+        // major minor name reads merged sectors ms writes merged sectors ms
+        // in_flight io_ms weighted_io_ms [discard and flush fields]
+        ProcScanner scanner(diskstatsFile.data(), diskstatsFile.size());
+        for (; !scanner.atEnd(); scanner.nextLine()) {
+            quint64 major = 0, minor = 0;
+            const char *name;
+            int nameLength;
+            if (!scanner.readNumber(major) || !scanner.readNumber(minor) ||
+                !scanner.readToken(name, nameLength)) {
+                continue;
+            }
+            quint64 fields[11];
+            int parsed = 0;
+            while (parsed < 11 && scanner.readNumber(fields[parsed])) {
+                ++parsed;
+            }
+            if (parsed < 11) {
+                continue;
+            }
+
+            DiskCounters &last = devices[(major << 32) | minor];
+            const bool fresh = last.generation == 0;
+            if (fresh) {
+                const QByteArray deviceName(name, nameLength);
+                last.name = QString::fromLatin1(deviceName);
+                last.wholeDisk = isWholeDisk(deviceName);
+            }
+            last.generation = generation;
+            if (!last.wholeDisk) {
+                continue;
+            }
+
+            DiskCounters current = last;
+            current.reads = fields[0];
+            current.sectorsRead = fields[2];
+            current.readMs = fields[3];
+            current.writes = fields[4];
+            current.sectorsWritten = fields[6];
+            current.writeMs = fields[7];
+            current.ioMs = fields[9];
+            current.weightedIoMs = fields[10];
+
+            // Counters restart when a device is re-attached
+            auto delta = [](quint64 now, quint64 before) { return now >= before ? now - before : 0; };
+            if (!fresh && elapsedMs > 0.0) {
+                const double seconds = elapsedMs / 1000.0;
+                const quint64 reads = delta(current.reads, last.reads);
+                const quint64 writes = delta(current.writes, last.writes);
+                const quint64 requestMs = delta(current.readMs, last.readMs) +
+                                          delta(current.writeMs, last.writeMs);
+                DiskIoStats stats = {};
+                stats.name = last.name;
+                // diskstats sectors are always 512 bytes
+                stats.readBytesPerSec = delta(current.sectorsRead, last.sectorsRead) * 512.0 / seconds;
+                stats.writeBytesPerSec = delta(current.sectorsWritten, last.sectorsWritten) * 512.0 / seconds;
+                stats.readIops = reads / seconds;
+                stats.writeIops = writes / seconds;
+                stats.avgQueueDepth = delta(current.weightedIoMs, last.weightedIoMs) / elapsedMs;
+                stats.avgLatencyMs = reads + writes > 0 ? static_cast<double>(requestMs) / (reads + writes) : 0.0;
+                stats.utilization = qMin(100.0, delta(current.ioMs, last.ioMs) * 100.0 / elapsedMs);
+                result.append(stats);
+            }
+            last = current;
+        }
+
+        // Forget devices that disappeared
+        for (auto it = devices.begin(); it != devices.end();) {
+            if (it.value().generation != generation) {
+                it = devices.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return result;
+    }
+
+    // Fallback when rtnetlink is not available: the same counters from
+    // /proc/net/dev, which only reports what fits its text columns
+    static bool readNetDevCounters(QVector<LinkCounters> &links) {
+        static ProcFile netDevFile("/proc/net/dev");
+        links.resize(0);
+        if (!netDevFile.read()) {
+            return false;
+        }
+        ProcScanner scanner(netDevFile.data(), netDevFile.size());
+        // Skip header lines
+        scanner.nextLine();
+        scanner.nextLine();
+        for (; !scanner.atEnd(); scanner.nextLine()) {
+            // "  eth0: rx_bytes packets errs drop fifo frame compressed multicast
+            //          tx_bytes packets errs drop ..."
+            scanner.skipSpaces();
+            const char *iface = scanner.position();
+            if (!scanner.skipPast(':')) {
+                continue;
+            }
+            const int ifaceLength = static_cast<int>(scanner.position() - iface) - 1;
+            quint64 fields[12];
+            int parsed = 0;
+            while (parsed < 12 && scanner.readNumber(fields[parsed])) {
+                ++parsed;
+            }
+            if (parsed < 12) continue;
+            LinkCounters link = {};
+            qstrncpy(link.name, QByteArray(iface, qMin<int>(ifaceLength, sizeof(link.name) - 1)).constData(),
+                     sizeof(link.name));
+            link.index = static_cast<int>(if_nametoindex(link.name));
+            // Interfaces this namespace does not know (a fixture's) still
+            // need distinct keys
+            if (link.index == 0) {
+                link.index = -(links.size() + 1);
+            }
+            link.loopback = qstrcmp(link.name, "lo") == 0;
+            link.up = true;
+            link.rxBytes = fields[0];
+            link.rxPackets = fields[1];
+            link.rxErrors = fields[2];
+            link.rxDropped = fields[3];
+            link.txBytes = fields[8];
+            link.txPackets = fields[9];
+            link.txErrors = fields[10];
+            link.txDropped = fields[11];
+            links.append(link);
+        }
+        return true;
+    }
+
+    static bool readLinkCounters(QVector<LinkCounters> &links) {
+        static NetlinkReader netlink;
+        // Netlink always describes this host, never a substituted /proc
+        return (!ProcReader::hasRoot() && netlink.dumpLinks(links)) || readNetDevCounters(links);
+    }
+
     NetworkStats getNetworkStats() {
         NetworkStats stats = {};
-        QFile file("/proc/net/dev");
-        if (!file.open(QIODevice::ReadOnly)) {
+        static QVector<LinkCounters> links;
+        if (!readLinkCounters(links)) {
             return stats;
         }
-        QTextStream in(&file);
-        // Skip header lines
-        in.readLine();
-        in.readLine();
         qint64 totalRx = 0;
         qint64 totalTx = 0;
-        while (!in.atEnd()) {
-            QString line = in.readLine().trimmed();
-            QStringList parts = line.split(QRegularExpression("\\s+"), Qt
-                                           ::SkipEmptyParts);
-            if (parts.size() < 10) continue;
-            QString iface = parts[0];
-            iface.remove(':');
+        for (const LinkCounters &link : links) {
             // Skip loopback
-            if (iface == "lo") continue;
-            qint64 rxBytes = parts[1].toLongLong();
-            qint64 txBytes = parts[9].toLongLong();
-            totalRx += rxBytes;
-            totalTx += txBytes;
-            if (stats.interfaceName.isEmpty() && rxBytes > 0) {
-                stats.interfaceName = iface;
+            if (link.loopback) continue;
+            totalRx += static_cast<qint64>(link.rxBytes);
+            totalTx += static_cast<qint64>(link.txBytes);
+            if (stats.interfaceName.isEmpty() && link.rxBytes > 0) {
+                stats.interfaceName = QString::fromLatin1(link.name);
             }
         }
-        file.close();
         stats.bytesReceived = totalRx;
         stats.bytesSent = totalTx;
         return stats;
     }
 
-    QVector<ProcessInfo> getTopProcesses(int count) {
-        QVector<ProcessInfo> processes;
-        QDir procDir("/proc");
-        QStringList pidDirs = procDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-        for (const QString &pidStr : pidDirs) {
-            bool ok;
-            quint32 pid = pidStr.toUInt(&ok);
-            if (!ok) continue;
-            ProcessInfo proc;
-            proc.pid = pid;
-            proc.cpuUsage = 0.0;
-            proc.memoryUsage = 0; // Initialize to 0
-            proc.status = "Running";
-            // Read process name from /proc/[pid]/comm
-            QFile commFile(QString("/proc/%1/comm").arg(pid));
-            if (commFile.open(QIODevice::ReadOnly)) {
-                proc.name = QString::fromUtf8(commFile.readAll().trimmed());
-                commFile.close();
-            }
-            // Read memory usage from /proc/[pid]/statm
-            QFile statmFile(QString("/proc/%1/statm").arg(pid));
-            if (statmFile.open(QIODevice::ReadOnly)) {
-                QString line = QString::fromUtf8(statmFile.readAll().trimmed());
-                statmFile.close();
-                QStringList parts = line.split(' ', Qt::SkipEmptyParts);
-                if (parts.size() >= 2) {
-                    // Second field is RSS in pages, convert to bytes
-                    long pageSize = sysconf(_SC_PAGESIZE);
-                    qint64 rssPages = parts[1].toLongLong();
-                    proc.memoryUsage = rssPages * pageSize;
-                }
-            }
-            if (!proc.name.isEmpty()) {
-                processes.append(proc);
-            }
-        }
-
-        // Sort by memory usage
-        std::sort(processes.begin(), processes.end(), [](const ProcessInfo &a, const ProcessInfo &b) {
-            return a.memoryUsage > b.memoryUsage;
-        });
-        if (count > 0 && count < processes.size()) {
-            processes.resize(count);
+    // Previous counters of one interface, keyed by interface index
+    struct InterfaceCounters {
+        LinkCounters counters;
+        QString name;
+        quint64 generation = 0;
+    };
+
+    // Difference between two readings of a monotonically increasing counter.
+    // A counter that went down was reset, e.g. by a driver reload, unless
+    // it was about to wrap at 32 bits (drivers that only keep 32-bit
+    // counters) and is now just past zero.
+    static quint64 counterDelta(quint64 now, quint64 before) {
+        if (now >= before) {
+            return now - before;
+        }
+        constexpr quint64 k32BitRange = Q_UINT64_C(1) << 32;
+        // How near the limit a counter must have been, and how far past
+        // zero it may be now, to count as wrapped
+        constexpr quint64 kWrapWindow = k32BitRange / 4;
+        if (before < k32BitRange && before >= k32BitRange - kWrapWindow && now < kWrapWindow) {
+            return now + k32BitRange - before;
+        }
+        return 0;
+    }
+
+    QVector<InterfaceStats> getInterfaceStats() {
+        QVector<InterfaceStats> result;
+        static QVector<LinkCounters> links;
+        static QHash<int, InterfaceCounters> previous;
+        static quint64 generation = 0;
+        static SampleClock clock;
+        if (!readLinkCounters(links)) {
+            return result;
+        }
+        const double seconds = clock.isValid() ? clock.nsecsElapsed() / 1e9 : 0.0;
+        clock.start();
+        ++generation;
+
+        result.reserve(links.size());
+        for (const LinkCounters &link : links) {
+            if (link.loopback) continue;
+            InterfaceCounters &last = previous[link.index];
+            // A new interface, or an index reused by a different one
+            const bool fresh = last.generation == 0 || qstrcmp(last.counters.name, link.name) != 0;
+            if (fresh) {
+                last.name = QString::fromLatin1(link.name);
+            }
+
+            InterfaceStats stats = {};
+            stats.name = last.name;
+            stats.index = link.index;
+            stats.up = link.up;
+            stats.rxBytes = link.rxBytes;
+            stats.txBytes = link.txBytes;
+            if (!fresh && seconds > 0.0) {
+                const LinkCounters &before = last.counters;
+                stats.rxBytesPerSec = counterDelta(link.rxBytes, before.rxBytes) / seconds;
+                stats.txBytesPerSec = counterDelta(link.txBytes, before.txBytes) / seconds;
+                stats.rxPacketsPerSec = counterDelta(link.rxPackets, before.rxPackets) / seconds;
+                stats.txPacketsPerSec = counterDelta(link.txPackets, before.txPackets) / seconds;
+                stats.rxDropsPerSec = counterDelta(link.rxDropped, before.rxDropped) / seconds;
+                stats.txDropsPerSec = counterDelta(link.txDropped, before.txDropped) / seconds;
+                stats.rxErrorsPerSec = counterDelta(link.rxErrors, before.rxErrors) / seconds;
+                stats.txErrorsPerSec = counterDelta(link.txErrors, before.txErrors) / seconds;
+            }
+            last.counters = link;
+            last.generation = generation;
+            result.append(stats);
+        }
+
+        // Forget interfaces that disappeared
+        for (auto it = previous.begin(); it != previous.end();) {
+            if (it.value().generation != generation) {
+                it = previous.erase(it);
+            } else {
+                ++it;
+            }
         }
+        return result;
+    }
+
+    // Keeps per-PID CPU ticks between scans
+    static ProcessCache &processCache() {
+        static ProcessCache cache;
+        return cache;
+    }
+
+    void setMaxScanThreads(int count) {
+        processCache().setMaxThreads(count);
+    }
+
+    QVector<ProcessInfo> getProcesses() {
+        QVector<ProcessInfo> processes;
+        processCache().scan(processes);
         return processes;
     }
+
+    QVector<ProcessDetails> getProcessDetails(const QVector<quint32> &pids, int maxAgeMs) {
+        QVector<ProcessDetails> details;
+        processCache().readDetails(pids, maxAgeMs, details);
+        return details;
+    }
+
+    QVector<ProcessInfo> getTopProcesses(int count) {
+        const QVector<ProcessInfo> processes = getProcesses();
+        auto selector = makeTopKSelector<ProcessInfo>(count > 0 ? count : processes.size(),
+            [](const ProcessInfo &a, const ProcessInfo &b) {
+                return a.memoryUsage > b.memoryUsage;
+            });
+        for (const ProcessInfo &proc : processes) {
+            selector.offer(proc);
+        }
+        return selector.take();
+    }
 } //namespace SystemInfo
 
 #endif // __linux__
@@ -1,11 +1,14 @@
 #ifdef _WIN32
 
 #include "systeminfo.h"
+#include "topk.h"
 #include <windows.h>
 #include <psapi.h>
 #include <iphlpapi.h>
 #include <pdh.h>
 #include <tlhelp32.h>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QStorageInfo>
 #include <QDebug>
 
@@ -33,6 +36,13 @@ namespace SystemInfo {
         return counterVal.doubleValue;
     }
 
+    CpuInfo getCpuInfo() {
+        // PDH only gives us the total here, per-core counters are not queried
+        CpuInfo info = {};
+        info.total.usage = getCpuUsage();
+        return info;
+    }
+
     MemoryInfo getMemoryInfo() {
         MemoryInfo info = {};
 
@@ -90,6 +100,11 @@ namespace SystemInfo {
         return disks;
     }
 
+    QVector<DiskIoStats> getDiskIoStats() {
+        // Not implemented on Windows yet (would need the PhysicalDisk PDH counters)
+        return QVector<DiskIoStats>();
+    }
+
     NetworkStats getNetworkStats() {
         NetworkStats stats = {};
 
@@ -129,7 +144,61 @@ namespace SystemInfo {
         return stats;
     }
 
-    QVector<ProcessInfo> getTopProcesses(int count) {
+    QVector<InterfaceStats> getInterfaceStats() {
+        QVector<InterfaceStats> result;
+        // Previous octet and packet counters per interface index
+        static QHash<DWORD, MIB_IFROW> previous;
+        static QElapsedTimer clock;
+        const double seconds = clock.isValid() ? clock.nsecsElapsed() / 1e9 : 0.0;
+        clock.start();
+
+        // MIB_IFROW counters are 32 bits wide and wrap on busy links
+        auto delta = [](DWORD now, DWORD before) { return static_cast<DWORD>(now - before); };
+
+        ULONG ulSize = 0;
+        if (GetIfTable(nullptr, &ulSize, FALSE) != ERROR_INSUFFICIENT_BUFFER) {
+            return result;
+        }
+        PMIB_IFTABLE pIfTable = (MIB_IFTABLE *)malloc(ulSize);
+        if (pIfTable == nullptr) {
+            return result;
+        }
+        if (GetIfTable(pIfTable, &ulSize, FALSE) == NO_ERROR) {
+            QHash<DWORD, MIB_IFROW> current;
+            for (DWORD i = 0; i < pIfTable->dwNumEntries; i++) {
+                const MIB_IFROW &row = pIfTable->table[i];
+                if (row.dwType == MIB_IF_TYPE_LOOPBACK) {
+                    continue;
+                }
+                InterfaceStats stats = {};
+                stats.name = QString::fromUtf8(reinterpret_cast<const char *>(row.bDescr));
+                stats.index = static_cast<int>(row.dwIndex);
+                stats.up = row.dwOperStatus == MIB_IF_OPER_STATUS_OPERATIONAL;
+                stats.rxBytes = row.dwInOctets;
+                stats.txBytes = row.dwOutOctets;
+                if (previous.contains(row.dwIndex) && seconds > 0.0) {
+                    const MIB_IFROW &before = previous[row.dwIndex];
+                    stats.rxBytesPerSec = delta(row.dwInOctets, before.dwInOctets) / seconds;
+                    stats.txBytesPerSec = delta(row.dwOutOctets, before.dwOutOctets) / seconds;
+                    stats.rxPacketsPerSec = delta(row.dwInUcastPkts + row.dwInNUcastPkts,
+                                                  before.dwInUcastPkts + before.dwInNUcastPkts) / seconds;
+                    stats.txPacketsPerSec = delta(row.dwOutUcastPkts + row.dwOutNUcastPkts,
+                                                  before.dwOutUcastPkts + before.dwOutNUcastPkts) / seconds;
+                    stats.rxDropsPerSec = delta(row.dwInDiscards, before.dwInDiscards) / seconds;
+                    stats.txDropsPerSec = delta(row.dwOutDiscards, before.dwOutDiscards) / seconds;
+                    stats.rxErrorsPerSec = delta(row.dwInErrors, before.dwInErrors) / seconds;
+                    stats.txErrorsPerSec = delta(row.dwOutErrors, before.dwOutErrors) / seconds;
+                }
+                current.insert(row.dwIndex, row);
+                result.append(stats);
+            }
+            previous = current;
+        }
+        free(pIfTable);
+        return result;
+    }
+
+    QVector<ProcessInfo> getProcesses() {
         QVector<ProcessInfo> processes;
         HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
 
@@ -147,6 +216,8 @@ namespace SystemInfo {
                 proc.name = QString::fromWCharArray(pe32.szExeFile);
                 proc.cpuUsage = 0.0; // CPU usage per process is complex on Windows
                 proc.memoryUsage = 0; // Initialize to 0
+                proc.ioBytesPerSec = 0;
+                proc.threads = static_cast<int>(pe32.cntThreads);
                 proc.status = "Running";
 
                 // Get memory usage
@@ -165,16 +236,51 @@ namespace SystemInfo {
 
         CloseHandle(hSnapshot);
 
-        // Sort by memory usage since CPU per-process is complex
-        std::sort(processes.begin(), processes.end(), [](const ProcessInfo &a, const ProcessInfo &b) {
-            return a.memoryUsage > b.memoryUsage;
-        });
+        return processes;
+    }
+
+    QVector<ProcessDetails> getProcessDetails(const QVector<quint32> &pids, int maxAgeMs) {
+        // Cheap enough to query every time; the command line of another
+        // process would need its PEB read, so it is left empty
+        Q_UNUSED(maxAgeMs);
+        QVector<ProcessDetails> details;
+        for (quint32 pid : pids) {
+            HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+            if (!hProcess) {
+                continue;
+            }
+            ProcessDetails detail = {};
+            detail.pid = pid;
+            detail.readBytes = -1;
+            detail.writeBytes = -1;
+            detail.pssBytes = -1;
+            IO_COUNTERS io;
+            if (GetProcessIoCounters(hProcess, &io)) {
+                detail.readBytes = static_cast<qint64>(io.ReadTransferCount);
+                detail.writeBytes = static_cast<qint64>(io.WriteTransferCount);
+            }
+            CloseHandle(hProcess);
+            details.append(detail);
+        }
+        return details;
+    }
 
-        if (count > 0 && count < processes.size()) {
-            processes.resize(count);
+    QVector<ProcessInfo> getTopProcesses(int count) {
+        // Ranked by memory usage since CPU per-process is complex
+        const QVector<ProcessInfo> processes = getProcesses();
+        auto selector = makeTopKSelector<ProcessInfo>(count > 0 ? count : processes.size(),
+            [](const ProcessInfo &a, const ProcessInfo &b) {
+                return a.memoryUsage > b.memoryUsage;
+            });
+        for (const ProcessInfo &proc : processes) {
+            selector.offer(proc);
         }
+        return selector.take();
+    }
 
-        return processes;
+    void setMaxScanThreads(int count) {
+        // The toolhelp snapshot is taken in one call, nothing to parallelize
+        Q_UNUSED(count);
     }
 } // namespace SystemInfo
 
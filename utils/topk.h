@@ -0,0 +1,98 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <QVector>
+#include <algorithm>
+#include "systeminfo.h"
+
+/**
+ * @brief Keeps the k best items offered to it in a bounded heap
+ *
+ * offer() is O(log k), so selecting from n items costs O(n log k)
+ * instead of the O(n log n) of sorting everything first. Better is a
+ * strict ordering where better(a, b) means a ranks ahead of b.
+ */
+template <typename T, typename Better>
+class TopKSelector
+{
+public:
+    TopKSelector(int k, Better better) : m_k(k), m_better(better) { m_heap.reserve(k); }
+
+    void offer(const T &item) {
+        if (m_k <= 0) {
+            return;
+        }
+        // The heap root is the worst item kept so far
+        if (m_heap.size() < m_k) {
+            m_heap.append(item);
+            std::push_heap(m_heap.begin(), m_heap.end(), m_better);
+        } else if (m_better(item, m_heap.first())) {
+            std::pop_heap(m_heap.begin(), m_heap.end(), m_better);
+            m_heap.last() = item;
+            std::push_heap(m_heap.begin(), m_heap.end(), m_better);
+        }
+    }
+
+    // Returns the selection best first and leaves the selector empty
+    QVector<T> take() {
+        std::sort_heap(m_heap.begin(), m_heap.end(), m_better);
+        QVector<T> result;
+        result.swap(m_heap);
+        return result;
+    }
+
+private:
+    int m_k;
+    Better m_better;
+    QVector<T> m_heap;
+};
+
+template <typename T, typename Better>
+TopKSelector<T, Better> makeTopKSelector(int k, Better better)
+{
+    return TopKSelector<T, Better>(k, better);
+}
+
+/**
+ * @brief Ranks processes by every ProcessSortKey in a single pass
+ *
+ * Only indices move through the heaps; the k winners of each ranking are
+ * copied out at the end.
+ */
+inline void rankProcesses(const QVector<ProcessInfo> &processes, int k,
+                          QVector<ProcessInfo> rankings[ProcessSortKeyCount])
+{
+    const ProcessInfo *data = processes.constData();
+    // Ties are broken by PID so rankings are stable between ticks
+    auto byCpu = [data](int a, int b) {
+        return data[a].cpuUsage != data[b].cpuUsage ? data[a].cpuUsage > data[b].cpuUsage
+                                                    : data[a].pid < data[b].pid;
+    };
+    auto byMemory = [data](int a, int b) {
+        return data[a].memoryUsage != data[b].memoryUsage ? data[a].memoryUsage > data[b].memoryUsage
+                                                          : data[a].pid < data[b].pid;
+    };
+    auto byIo = [data](int a, int b) {
+        return data[a].ioBytesPerSec != data[b].ioBytesPerSec ? data[a].ioBytesPerSec > data[b].ioBytesPerSec
+                                                              : data[a].pid < data[b].pid;
+    };
+    auto cpu = makeTopKSelector<int>(k, byCpu);
+    auto memory = makeTopKSelector<int>(k, byMemory);
+    auto io = makeTopKSelector<int>(k, byIo);
+    for (int i = 0; i < processes.size(); ++i) {
+        cpu.offer(i);
+        memory.offer(i);
+        io.offer(i);
+    }
+
+    const QVector<int> selected[ProcessSortKeyCount] = { cpu.take(), memory.take(), io.take() };
+    for (int key = 0; key < ProcessSortKeyCount; ++key) {
+        rankings[key].resize(0);
+        rankings[key].reserve(selected[key].size());
+        for (int index : selected[key]) {
+            rankings[key].append(data[index]);
+        }
+    }
+}
+
+#endif // TOPK_H
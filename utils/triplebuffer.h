@@ -0,0 +1,52 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <QtGlobal>
+#include <atomic>
+
+/**
+ * @brief Lock-free single-writer, single-reader triple buffer
+ *
+ * The writer fills back() and publish()es it; the reader acquire()s the
+ * newest published buffer and reads front() for as long as it likes.
+ * Neither side ever waits on the other: the only shared state is one
+ * atomic byte holding the index of the middle buffer and a "fresh" flag.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : m_middle(1), m_back(2), m_front(0) {}
+
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // Writer side
+    T &back() { return m_buffers[m_back]; }
+
+    void publish() {
+        m_back = m_middle.exchange(m_back | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    // Reader side, returns false if nothing new was published since last time
+    bool acquire() {
+        if (!(m_middle.load(std::memory_order_relaxed) & kFresh)) {
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+
+    const T &front() const { return m_buffers[m_front]; }
+
+private:
+    static constexpr quint8 kIndexMask = 0x3;
+    static constexpr quint8 kFresh = 0x4;
+
+    T m_buffers[3];
+    std::atomic<quint8> m_middle;
+    quint8 m_back;  // only touched by the writer
+    quint8 m_front; // only touched by the reader
+};
+
+#endif // TRIPLEBUFFER_H
@@ -1,15 +1,34 @@
 #include "chartwidget.h"
+#include "../utils/lttb.h"
+#include <QDateTime>
+#include <QEvent>
+#include <QMouseEvent>
 #include <QPainter>
+#include <QWheelEvent>
+
+// About four and a half hours at one sample per second
+static constexpr int kDefaultRetention = 16384;
+// Narrowest window the wheel can zoom into
+static constexpr double kMinSpanMs = 5000.0;
 
 ChartWidget::ChartWidget(const QString &title, QWidget *parent)
     : QWidget{parent}
     , m_title(title)
-    , m_maxDataPoints(60)
+    , m_samples(kDefaultRetention)
     , m_minY(0.0)
     , m_maxY(100.0)
     , m_lineColor(QColor("#2196F3"))
+    , m_rollups(nullptr)
+    , m_defaultSpanMs(60000.0)
+    , m_viewSpanMs(m_defaultSpanMs)
+    , m_viewEndMs(0.0)
+    , m_followLatest(true)
+    , m_staticDirty(true)
+    , m_seriesDirty(true)
+    , m_dragging(false)
+    , m_dragOriginX(0)
+    , m_dragOriginEndMs(0.0)
 {
-    m_dataPoints.fill(0.0, m_maxDataPoints);
     m_fillColor = m_lineColor;
     m_fillColor.setAlpha(80);
     setMinimumHeight(250);
@@ -17,13 +36,26 @@ ChartWidget::ChartWidget(const QString &title, QWidget *parent)
 
 void ChartWidget::addDataPoint(double value)
 {
-    for (int i = 0; i < m_dataPoints.size() - 1; ++i) {
-        m_dataPoints[i] = m_dataPoints[i + 1];
+    addDataPoint(QDateTime::currentMSecsSinceEpoch(), value);
+}
+
+void ChartWidget::addDataPoint(qint64 timeMs, double value)
+{
+    // Samples must arrive in time order for the binary searches
+    if (!m_samples.isEmpty() && timeMs < m_samples.last().x()) {
+        return;
     }
-    if (!m_dataPoints.isEmpty()) {
-        m_dataPoints.last() = value;
+    m_samples.append(QPointF(timeMs, value));
+    // A panned view stays put until it scrolls out of the retained range
+    if (!m_followLatest) {
+        const double oldEnd = m_viewEndMs;
+        const bool oldFollow = m_followLatest;
+        clampView();
+        if (m_viewEndMs != oldEnd || m_followLatest != oldFollow) {
+            invalidateStaticLayer();
+        }
     }
-    update();
+    invalidateSeries();
 }
 
 void ChartWidget::setColor(const QColor &color)
@@ -31,28 +63,228 @@ void ChartWidget::setColor(const QColor &color)
     m_lineColor = color;
     m_fillColor = color;
     m_fillColor.setAlpha(80);
-    update();
+    update(chartRect());
 }
 
 void ChartWidget::setYAxisRange(double min, double max)
 {
     m_minY = min;
     m_maxY = max;
-    update();
+    invalidateStaticLayer();
+    invalidateSeries();
 }
 
-void ChartWidget::paintEvent(QPaintEvent *event)
+void ChartWidget::setValueSuffix(const QString &suffix)
+{
+    m_valueSuffix = suffix;
+    invalidateStaticLayer();
+}
+
+void ChartWidget::setRetention(int samples)
+{
+    m_samples.setCapacity(samples);
+    invalidateSeries();
+}
+
+void ChartWidget::setTimeSpan(int ms)
+{
+    m_defaultSpanMs = qMax(kMinSpanMs, double(ms));
+    resetView();
+}
+
+void ChartWidget::resetView()
+{
+    m_viewSpanMs = m_defaultSpanMs;
+    m_followLatest = true;
+    invalidateStaticLayer();
+    invalidateSeries();
+}
+
+void ChartWidget::setRollups(const RollupSeries *rollups)
+{
+    m_rollups = rollups;
+    invalidateSeries();
+}
+
+int ChartWidget::lowerBound(double timeMs) const
+{
+    int low = 0;
+    int high = m_samples.size();
+    while (low < high) {
+        const int mid = (low + high) / 2;
+        if (m_samples.at(mid).x() < timeMs) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+double ChartWidget::viewEnd() const
+{
+    if (m_followLatest) {
+        return m_samples.isEmpty() ? 0.0 : m_samples.last().x();
+    }
+    return m_viewEndMs;
+}
+
+double ChartWidget::oldestTimestamp() const
+{
+    double oldest = m_samples.first().x();
+    if (m_rollups && !m_rollups->isEmpty()) {
+        oldest = qMin(oldest, double(m_rollups->oldestTimestamp()));
+    }
+    return oldest;
+}
+
+void ChartWidget::clampView()
+{
+    if (m_samples.isEmpty()) {
+        m_followLatest = true;
+        return;
+    }
+    // Rollups let the view reach further back than the raw samples
+    const double oldest = oldestTimestamp();
+    const double newest = m_samples.last().x();
+    m_viewSpanMs = qBound(kMinSpanMs, m_viewSpanMs, qMax(m_defaultSpanMs, newest - oldest));
+    if (m_viewEndMs >= newest) {
+        m_followLatest = true;
+    } else {
+        m_viewEndMs = qMax(m_viewEndMs, qMin(oldest + m_viewSpanMs, newest));
+    }
+}
+
+void ChartWidget::wheelEvent(QWheelEvent *event)
 {
-    Q_UNUSED(event);
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-    // Calculate drawing area
     const int chartWidth = width() - MARGIN_LEFT - MARGIN_RIGHT;
-    const int chartHeight = height() - MARGIN_TOP - MARGIN_BOTTOM;
-    if (chartWidth <= 0 || chartHeight <= 0) {
-        return; // Widget too small
+    if (m_samples.isEmpty() || chartWidth <= 0 || event->angleDelta().y() == 0) {
+        event->ignore();
+        return;
+    }
+    // Keep the time under the cursor in place while the span changes
+    const double fraction = qBound(0.0, (event->position().x() - MARGIN_LEFT) / chartWidth, 1.0);
+    const double end = viewEnd();
+    const double anchor = end - m_viewSpanMs * (1.0 - fraction);
+    const double factor = event->angleDelta().y() > 0 ? 0.8 : 1.25;
+    m_viewSpanMs *= factor;
+    m_viewEndMs = anchor + m_viewSpanMs * (1.0 - fraction);
+    m_followLatest = false;
+    clampView();
+    invalidateStaticLayer();
+    invalidateSeries();
+    event->accept();
+}
+
+void ChartWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton && !m_samples.isEmpty()) {
+        m_dragging = true;
+        m_dragOriginX = event->pos().x();
+        m_dragOriginEndMs = viewEnd();
+        setCursor(Qt::ClosedHandCursor);
+    }
+    QWidget::mousePressEvent(event);
+}
+
+void ChartWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    const int chartWidth = width() - MARGIN_LEFT - MARGIN_RIGHT;
+    if (m_dragging && chartWidth > 0) {
+        const double msPerPixel = m_viewSpanMs / chartWidth;
+        m_viewEndMs = m_dragOriginEndMs - (event->pos().x() - m_dragOriginX) * msPerPixel;
+        m_followLatest = false;
+        clampView();
+        invalidateStaticLayer();
+        invalidateSeries();
+    }
+    QWidget::mouseMoveEvent(event);
+}
+
+void ChartWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton && m_dragging) {
+        m_dragging = false;
+        unsetCursor();
+    }
+    QWidget::mouseReleaseEvent(event);
+}
+
+void ChartWidget::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    Q_UNUSED(event);
+    resetView();
+}
+
+void ChartWidget::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    invalidateStaticLayer();
+    invalidateSeries();
+}
+
+void ChartWidget::changeEvent(QEvent *event)
+{
+    // Theme switches arrive as palette or style changes
+    if (event->type() == QEvent::PaletteChange || event->type() == QEvent::StyleChange ||
+        event->type() == QEvent::FontChange) {
+        invalidateStaticLayer();
+    }
+    QWidget::changeEvent(event);
+}
+
+QRect ChartWidget::chartRect() const
+{
+    return QRect(MARGIN_LEFT, MARGIN_TOP,
+                 width() - MARGIN_LEFT - MARGIN_RIGHT, height() - MARGIN_TOP - MARGIN_BOTTOM);
+}
+
+void ChartWidget::invalidateStaticLayer()
+{
+    m_staticDirty = true;
+    update();
+}
+
+void ChartWidget::invalidateSeries()
+{
+    m_seriesDirty = true;
+    // Only the plot area changes; the margins come from the cached layer
+    update(chartRect().adjusted(-2, -2, 2, 2));
+}
+
+QString ChartWidget::timeLabel(double timeMs) const
+{
+    // Following: age relative to the right edge. Panned: wall clock time
+    if (!m_followLatest) {
+        return QDateTime::fromMSecsSinceEpoch(qint64(timeMs)).toString(
+            m_viewSpanMs < 24 * 3600 * 1000.0 ? "HH:mm:ss" : "MM-dd HH:mm");
+    }
+    const double age = viewEnd() - timeMs;
+    if (age < 1000.0) {
+        return QString("now");
+    }
+    if (m_viewSpanMs <= 2 * 60 * 1000.0) {
+        return QString("-%1s").arg(qRound(age / 1000.0));
     }
-    const QRect chartRect(MARGIN_LEFT, MARGIN_TOP, chartWidth, chartHeight);
+    if (m_viewSpanMs <= 2 * 3600 * 1000.0) {
+        return QString("-%1m").arg(age / 60000.0, 0, 'f', age < 600000.0 ? 1 : 0);
+    }
+    if (m_viewSpanMs <= 2 * 86400 * 1000.0) {
+        return QString("-%1h").arg(age / 3600000.0, 0, 'f', 1);
+    }
+    return QString("-%1d").arg(age / 86400000.0, 0, 'f', 1);
+}
+
+void ChartWidget::rebuildStaticLayer()
+{
+    const qreal ratio = devicePixelRatioF();
+    m_staticLayer = QPixmap(size() * ratio);
+    m_staticLayer.setDevicePixelRatio(ratio);
+    m_staticDirty = false;
+
+    QPainter painter(&m_staticLayer);
+    painter.setRenderHint(QPainter::Antialiasing);
+    const QRect plot = chartRect();
     // Setup theme colors
     QPalette pal = palette();
     const bool isDark = (pal.color(QPalette::Window).lightness() < 128);
@@ -64,12 +296,164 @@ void ChartWidget::paintEvent(QPaintEvent *event)
     const QColor borderColor = isDark ? QColor("#606060") : QColor("#BDBDBD");
     // Draw background
     painter.fillRect(rect(), bgColor);
+
+    // Title
+    QFont titleFont = font();
+    titleFont.setBold(true);
+    titleFont.setPointSizeF(titleFont.pointSizeF() * 1.2);
+    painter.setFont(titleFont);
+    painter.setPen(textColor);
+    painter.drawText(QRect(MARGIN_LEFT, 0, width() - MARGIN_LEFT - MARGIN_RIGHT, MARGIN_TOP),
+                     Qt::AlignLeft | Qt::AlignVCenter, m_title);
+
+    if (plot.width() <= 0 || plot.height() <= 0) {
+        return; // Widget too small
+    }
+    painter.fillRect(plot, chartBgColor);
+
+    // Horizontal grid lines with value labels
+    static constexpr int kRows = 4;
+    QFont labelFont = font();
+    labelFont.setPointSizeF(labelFont.pointSizeF() * 0.85);
+    painter.setFont(labelFont);
+    for (int row = 0; row <= kRows; ++row) {
+        const double y = plot.bottom() - double(row) * plot.height() / kRows;
+        painter.setPen(QPen(gridColor, 1, Qt::DashLine));
+        painter.drawLine(QPointF(plot.left(), y), QPointF(plot.right(), y));
+        const double value = m_minY + (m_maxY - m_minY) * row / kRows;
+        painter.setPen(labelColor);
+        painter.drawText(QRectF(0, y - 10, MARGIN_LEFT - 8, 20), Qt::AlignRight | Qt::AlignVCenter,
+                         QString::number(value, 'f', m_maxY - m_minY < 10.0 ? 1 : 0) + m_valueSuffix);
+    }
+
+    // Vertical grid lines with time labels
+    static constexpr int kColumns = 4;
+    const double end = viewEnd();
+    for (int column = 0; column <= kColumns; ++column) {
+        const double x = plot.left() + double(column) * plot.width() / kColumns;
+        if (column > 0 && column < kColumns) {
+            painter.setPen(QPen(gridColor, 1, Qt::DashLine));
+            painter.drawLine(QPointF(x, plot.top()), QPointF(x, plot.bottom()));
+        }
+        const double timeMs = end - m_viewSpanMs * (kColumns - column) / kColumns;
+        const Qt::Alignment alignment = column == 0 ? Qt::AlignLeft
+                                        : column == kColumns ? Qt::AlignRight : Qt::AlignHCenter;
+        const double labelWidth = 80.0;
+        const double left = column == 0 ? x : column == kColumns ? x - labelWidth : x - labelWidth / 2;
+        painter.setPen(labelColor);
+        painter.drawText(QRectF(left, plot.bottom() + 6, labelWidth, MARGIN_BOTTOM - 12),
+                         alignment | Qt::AlignTop, timeLabel(timeMs));
+    }
+
+    painter.setPen(QPen(borderColor, 1));
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(plot);
+}
+
+void ChartWidget::rebuildSeries()
+{
+    m_seriesDirty = false;
+    m_seriesLine.resize(0);
+    m_seriesArea.resize(0);
+    const QRect plot = chartRect();
+    if (m_samples.isEmpty() || m_maxY <= m_minY || plot.width() <= 0 || plot.height() <= 0) {
+        return;
+    }
+    const double end = viewEnd();
+    const double start = end - m_viewSpanMs;
+
+    // Raw samples while they cover the view at better than a minute per
+    // pixel, then the coarsest rollup that still gives a bucket per pixel
+    const double msPerPixel = m_viewSpanMs / plot.width();
+    if (m_rollups && !m_rollups->isEmpty() &&
+        (msPerPixel >= RollupSeries::bucketWidthMs(MinuteRollup) || start < m_samples.first().x())) {
+        const RollupLevel level = msPerPixel >= RollupSeries::bucketWidthMs(HourRollup) ? HourRollup
+                                                                                        : MinuteRollup;
+        if (rebuildSeriesFromRollups(level, start, end)) {
+            return;
+        }
+    }
+
+    // Visible samples, plus one on each side so the line reaches the edges
+    const int first = qMax(0, lowerBound(start) - 1);
+    const int last = qMin(m_samples.size(), lowerBound(end) + 1);
+
+    // Decimate in pixel space, one point per horizontal pixel
+    const double xScale = plot.width() / m_viewSpanMs;
+    const double yScale = plot.height() / (m_maxY - m_minY);
+    const auto toPixel = [&](int i) {
+        const QPointF &sample = m_samples.at(i);
+        const double value = qBound(m_minY, sample.y(), m_maxY);
+        return QPointF(plot.left() + (sample.x() - start) * xScale,
+                       plot.bottom() - (value - m_minY) * yScale);
+    };
+    decimateLttb(toPixel, first, last, plot.width(), m_seriesLine);
+    if (m_seriesLine.size() < 2) {
+        m_seriesLine.resize(0);
+        return;
+    }
+    m_seriesArea = m_seriesLine;
+    m_seriesArea.append(QPointF(m_seriesLine.last().x(), plot.bottom()));
+    m_seriesArea.append(QPointF(m_seriesLine.first().x(), plot.bottom()));
+}
+
+bool ChartWidget::rebuildSeriesFromRollups(RollupLevel level, double start, double end)
+{
+    m_rollups->query(level, qint64(start), qint64(end), m_buckets);
+    if (m_buckets.size() < 2) {
+        return false;
+    }
+    // The average as the line, the min-max range as a band around it
+    const QRect plot = chartRect();
+    const double xScale = plot.width() / m_viewSpanMs;
+    const double yScale = plot.height() / (m_maxY - m_minY);
+    const double halfWidth = RollupSeries::bucketWidthMs(level) / 2.0;
+    const auto toY = [&](float value) {
+        return plot.bottom() - (qBound(m_minY, double(value), m_maxY) - m_minY) * yScale;
+    };
+    m_seriesLine.reserve(m_buckets.size());
+    m_seriesArea.reserve(m_buckets.size() * 2);
+    for (const RollupBucket &bucket : m_buckets) {
+        const double x = plot.left() + (bucket.startMs + halfWidth - start) * xScale;
+        m_seriesLine.append(QPointF(x, toY(bucket.avg)));
+        m_seriesArea.append(QPointF(x, toY(bucket.max)));
+    }
+    for (int i = m_buckets.size() - 1; i >= 0; --i) {
+        m_seriesArea.append(QPointF(m_seriesLine.at(i).x(), toY(m_buckets.at(i).min)));
+    }
+    return true;
+}
+
+void ChartWidget::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    if (m_staticDirty || m_staticLayer.devicePixelRatio() != devicePixelRatioF()) {
+        rebuildStaticLayer();
+    }
+    if (m_seriesDirty) {
+        rebuildSeries();
+    }
+
+    // Qt clips to the update region, so a new sample only blits the plot area
+    QPainter painter(this);
+    painter.drawPixmap(0, 0, m_staticLayer);
+    if (m_seriesLine.isEmpty()) {
+        return;
+    }
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setClipRect(chartRect(), Qt::IntersectClip);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(m_fillColor);
+    painter.drawPolygon(m_seriesArea);
+    painter.setPen(QPen(m_lineColor, 2));
+    painter.setBrush(Qt::NoBrush);
+    painter.drawPolyline(m_seriesLine);
 }
 
 void ChartWidget::clear()
 {
-    m_dataPoints.fill(0.0, m_maxDataPoints);
-    update();
+    m_samples.clear();
+    resetView();
 }
 
 QSize ChartWidget::sizeHint() const
@@ -81,4 +465,3 @@ QSize ChartWidget::minimumSizeHint() const
 {
     return QSize(300, 200);
 }
-
@@ -4,7 +4,12 @@
 #include <QWidget>
 #include <QVector>
 #include <QColor>
+#include <QPixmap>
+#include <QPointF>
+#include <QPolygonF>
 #include <QString>
+#include "../utils/ringbuffer.h"
+#include "../utils/rollup.h"
 
 class ChartWidget : public QWidget
 {
@@ -13,23 +18,75 @@ public:
     explicit ChartWidget(const QString &title, QWidget *parent = nullptr);
 
     void addDataPoint(double value);
+    void addDataPoint(qint64 timeMs, double value);
     void setColor(const QColor &color);
     void setYAxisRange(double min, double max);
+    // Appended to the Y axis labels, e.g. "%"
+    void setValueSuffix(const QString &suffix);
+    // Number of samples kept, rounded up to a power of two; drops the history
+    void setRetention(int samples);
+    // Width of the visible window when following the latest samples
+    void setTimeSpan(int ms);
+    // Returns to the default span, following the latest samples
+    void resetView();
+    // Aggregates drawn when the view is too wide for raw samples; the
+    // series must outlive the chart
+    void setRollups(const RollupSeries *rollups);
 
 protected:
     void paintEvent(QPaintEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
     void clear();
     QSize sizeHint() const override;
     QSize minimumSizeHint() const override;
 
 private:
+    // Index of the first sample at or after timeMs
+    int lowerBound(double timeMs) const;
+    double viewEnd() const;
+    // Keeps the view inside the retained samples
+    void clampView();
+    QRect chartRect() const;
+    // Marks the static layer or the series for rebuilding and schedules a repaint
+    void invalidateStaticLayer();
+    void invalidateSeries();
+    void rebuildStaticLayer();
+    void rebuildSeries();
+    bool rebuildSeriesFromRollups(RollupLevel level, double start, double end);
+    double oldestTimestamp() const;
+    QString timeLabel(double timeMs) const;
+
     QString m_title;
-    QVector<double> m_dataPoints;
-    int m_maxDataPoints;
+    RingBuffer<QPointF> m_samples; // x is ms since epoch, y the value
+    QString m_valueSuffix;
     double m_minY;
     double m_maxY;
     QColor m_lineColor;
     QColor m_fillColor;
+    const RollupSeries *m_rollups;
+    QVector<RollupBucket> m_buckets;
+    // Visible window
+    double m_defaultSpanMs;
+    double m_viewSpanMs;
+    double m_viewEndMs;
+    bool m_followLatest;
+    // Cached layers: everything but the series is drawn into m_staticLayer,
+    // the series is kept as ready-to-draw polygons in widget coordinates
+    QPixmap m_staticLayer;
+    bool m_staticDirty;
+    QPolygonF m_seriesLine;
+    QPolygonF m_seriesArea;
+    bool m_seriesDirty;
+    // Drag panning
+    bool m_dragging;
+    int m_dragOriginX;
+    double m_dragOriginEndMs;
     // Drawing parameters
     static constexpr int MARGIN_LEFT = 60;
     static constexpr int MARGIN_RIGHT = 20;
@@ -0,0 +1,130 @@
+#include "diagnosticsdialog.h"
+#include "../utils/formatters.h"
+#include "../utils/instrumentation.h"
+#include <QCheckBox>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+namespace {
+    enum Column {
+        ProbeColumn,
+        SamplesColumn,
+        WallMedianColumn,
+        WallP99Column,
+        WallMaxColumn,
+        CpuMedianColumn,
+        CpuP99Column,
+        AllocationsMedianColumn,
+        AllocationsMaxColumn,
+        ColumnCount
+    };
+}
+
+DiagnosticsDialog::DiagnosticsDialog(QWidget *parent)
+    : QDialog(parent)
+    , m_enabled(new QCheckBox("Record collector costs", this))
+    , m_table(new QTableWidget(Instrumentation::ProbeCount, ColumnCount, this))
+    , m_timer(new QTimer(this))
+{
+    setWindowTitle("Diagnostics");
+    resize(820, 360);
+
+    m_table->setHorizontalHeaderLabels({"Probe", "Samples", "Wall p50", "Wall p99", "Wall max",
+                                        "CPU p50", "CPU p99", "new calls p50", "new calls max"});
+    m_table->horizontalHeaderItem(CpuMedianColumn)->setToolTip("Includes the process scan's helper threads");
+    m_table->horizontalHeaderItem(CpuP99Column)->setToolTip("Includes the process scan's helper threads");
+    const QString newCallsTip = "operator new calls on the collecting thread; Qt containers allocate with "
+                                "malloc() and are not counted";
+    m_table->horizontalHeaderItem(AllocationsMedianColumn)->setToolTip(newCallsTip);
+    m_table->horizontalHeaderItem(AllocationsMaxColumn)->setToolTip(newCallsTip);
+    m_table->verticalHeader()->hide();
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionMode(QAbstractItemView::NoSelection);
+    m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    for (int row = 0; row < Instrumentation::ProbeCount; ++row) {
+        m_table->setItem(row, ProbeColumn,
+                         new QTableWidgetItem(Instrumentation::probeName(Instrumentation::Probe(row))));
+        for (int column = SamplesColumn; column < ColumnCount; ++column) {
+            QTableWidgetItem *item = new QTableWidgetItem;
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            m_table->setItem(row, column, item);
+        }
+    }
+
+    QPushButton *resetButton = new QPushButton("Reset", this);
+    QPushButton *saveButton = new QPushButton("Save JSON…", this);
+    QPushButton *closeButton = new QPushButton("Close", this);
+
+    QHBoxLayout *buttons = new QHBoxLayout;
+    buttons->addWidget(m_enabled);
+    buttons->addStretch();
+    buttons->addWidget(resetButton);
+    buttons->addWidget(saveButton);
+    buttons->addWidget(closeButton);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(m_table);
+    layout->addLayout(buttons);
+
+    m_enabled->setChecked(Instrumentation::isEnabled());
+    connect(m_enabled, &QCheckBox::toggled, this, [](bool checked) {
+        Instrumentation::setEnabled(checked);
+    });
+    // The probes clear themselves on their next record
+    connect(resetButton, &QPushButton::clicked, this, []() {
+        Instrumentation::reset();
+    });
+    connect(saveButton, &QPushButton::clicked, this, &DiagnosticsDialog::saveJson);
+    connect(closeButton, &QPushButton::clicked, this, &QDialog::close);
+
+    m_timer->setInterval(1000);
+    connect(m_timer, &QTimer::timeout, this, &DiagnosticsDialog::refresh);
+}
+
+void DiagnosticsDialog::showEvent(QShowEvent *event)
+{
+    QDialog::showEvent(event);
+    refresh();
+    m_timer->start();
+}
+
+void DiagnosticsDialog::hideEvent(QHideEvent *event)
+{
+    m_timer->stop();
+    QDialog::hideEvent(event);
+}
+
+void DiagnosticsDialog::refresh()
+{
+    for (int row = 0; row < Instrumentation::ProbeCount; ++row) {
+        const Instrumentation::ProbeStats &stats = Instrumentation::stats(Instrumentation::Probe(row));
+        const bool empty = stats.wallNs.count() == 0;
+        auto duration = [empty](double ns) { return empty ? QString("–") : Formatters::formatDuration(ns); };
+        auto count = [empty](quint64 value) {
+            return empty || !Instrumentation::countsAllocations() ? QString("–") : QString::number(value);
+        };
+        m_table->item(row, SamplesColumn)->setText(QString::number(stats.wallNs.count()));
+        m_table->item(row, WallMedianColumn)->setText(duration(stats.wallNs.percentile(50.0)));
+        m_table->item(row, WallP99Column)->setText(duration(stats.wallNs.percentile(99.0)));
+        m_table->item(row, WallMaxColumn)->setText(duration(stats.wallNs.max()));
+        m_table->item(row, CpuMedianColumn)->setText(duration(stats.cpuNs.percentile(50.0)));
+        m_table->item(row, CpuP99Column)->setText(duration(stats.cpuNs.percentile(99.0)));
+        m_table->item(row, AllocationsMedianColumn)->setText(count(stats.allocations.percentile(50.0)));
+        m_table->item(row, AllocationsMaxColumn)->setText(count(stats.allocations.max()));
+    }
+}
+
+void DiagnosticsDialog::saveJson()
+{
+    const QString path = QFileDialog::getSaveFileName(this, "Save diagnostics", "systemmonitor-diagnostics.json",
+                                                      "JSON files (*.json)");
+    if (!path.isEmpty() && !Instrumentation::writeJson(path)) {
+        QMessageBox::warning(this, "Diagnostics", QString("Cannot write %1").arg(path));
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef DIAGNOSTICSDIALOG_H
+#define DIAGNOSTICSDIALOG_H
+
+#include <QDialog>
+
+class QCheckBox;
+class QTableWidget;
+class QTimer;
+
+/**
+ * @brief Shows what each collector costs the host, per tick
+ *
+ * One row per Instrumentation probe with the wall time, CPU time and
+ * operator new call percentiles recorded so far, refreshed every second
+ * while the dialog is open. Recording itself is switched on and off here,
+ * and the numbers can be saved as JSON.
+ */
+class DiagnosticsDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit DiagnosticsDialog(QWidget *parent = nullptr);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private slots:
+    void refresh();
+    void saveJson();
+
+private:
+    QCheckBox *m_enabled;
+    QTableWidget *m_table;
+    QTimer *m_timer;
+};
+
+#endif // DIAGNOSTICSDIALOG_H
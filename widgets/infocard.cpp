@@ -8,6 +8,7 @@ InfoCard::InfoCard(const QString &title, QWidget *parent)
     , m_iconLabel(new QLabel(this))
     , m_titleLabel(new QLabel(this))
     , m_valueLabel(new QLabel(this))
+    , m_secondaryValueLabel(new QLabel(this))
     , m_subtitleLabel(new QLabel(this))
     , m_progressBar(new QProgressBar(this))
 {
@@ -63,6 +64,12 @@ void InfoCard::setupUI()
     m_valueLabel->setAlignment(Qt::AlignLeft);
     mainLayout->addWidget(m_valueLabel);
 
+    // Secondary value label, hidden until a card sets one
+    m_secondaryValueLabel->setStyleSheet("font-size: 11pt; font-weight: bold;");
+    m_secondaryValueLabel->setAlignment(Qt::AlignLeft);
+    m_secondaryValueLabel->hide();
+    mainLayout->addWidget(m_secondaryValueLabel);
+
     // Subtitle label
     m_subtitleLabel->setStyleSheet("font-size: 9pt;");
     m_subtitleLabel->setAlignment(Qt::AlignLeft);
@@ -79,7 +86,7 @@ void InfoCard::setupUI()
     mainLayout->addStretch();
 
     setMinimumSize(220, 120);
-    setMaximumHeight(130);
+    setMaximumHeight(150);
 
     // Add shadow effect
     QGraphicsDropShadowEffect *shadow = new QGraphicsDropShadowEffect();
@@ -97,6 +104,12 @@ void InfoCard::setValue(const QString &value)
     m_valueLabel->setText(value);
 }
 
+void InfoCard::setSecondaryValue(const QString &value)
+{
+    m_secondaryValueLabel->setText(value);
+    m_secondaryValueLabel->setVisible(!value.isEmpty());
+}
+
 void InfoCard::setPercentage(double percent)
 {
     m_progressBar->setValue(static_cast<int>(percent));
@@ -14,6 +14,7 @@ public:
     explicit InfoCard(const QString &title, QWidget *parent = nullptr);
     // Setter Methods
     void setValue(const QString &value);
+    void setSecondaryValue(const QString &value);
     void setPercentage(double percent);
     void setIcon(const QIcon &icon);
     void setIconText(const QString &iconText);
@@ -31,6 +32,7 @@ private:
     QLabel *m_iconLabel;
     QLabel *m_titleLabel;
     QLabel *m_valueLabel;
+    QLabel *m_secondaryValueLabel;
     QLabel *m_subtitleLabel;
     QProgressBar *m_progressBar;
 };
@@ -0,0 +1,102 @@
+#include "processtable.h"
+#include "processtablemodel.h"
+#include <QHeaderView>
+#include <QScrollBar>
+#include <QTableView>
+#include <QTimer>
+#include <QVBoxLayout>
+#include <algorithm>
+
+// Delay after the last scroll step before the watch list follows
+static constexpr int kWatchDelayMs = 150;
+
+ProcessTable::ProcessTable(QWidget *parent)
+    : QWidget(parent)
+    , m_model(new ProcessTableModel(this))
+    , m_view(new QTableView(this))
+    , m_watchTimer(new QTimer(this))
+{
+    m_view->setModel(m_model);
+    m_view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_view->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_view->setAlternatingRowColors(true);
+    m_view->setWordWrap(false);
+    m_view->setShowGrid(false);
+    m_view->verticalHeader()->hide();
+    // Fixed heights keep scrolling O(1) in the number of rows
+    m_view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    m_view->verticalHeader()->setDefaultSectionSize(fontMetrics().height() + 6);
+    m_view->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    m_view->horizontalHeader()->setStretchLastSection(true);
+    m_view->horizontalHeader()->setSortIndicatorShown(true);
+    m_view->setColumnWidth(ProcessTableModel::NameColumn, 180);
+    m_view->setColumnWidth(ProcessTableModel::StatusColumn, 100);
+    m_view->setSortingEnabled(true);
+    m_view->sortByColumn(ProcessTableModel::CpuColumn, Qt::DescendingOrder);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(m_view);
+
+    m_watchTimer->setSingleShot(true);
+    m_watchTimer->setInterval(kWatchDelayMs);
+    connect(m_watchTimer, &QTimer::timeout, this, &ProcessTable::updateWatched);
+    connect(m_view->verticalScrollBar(), &QScrollBar::valueChanged, this, &ProcessTable::scheduleWatchUpdate);
+    connect(m_view->selectionModel(), &QItemSelectionModel::currentRowChanged,
+            this, &ProcessTable::scheduleWatchUpdate);
+    connect(m_model, &QAbstractItemModel::layoutChanged, this, &ProcessTable::scheduleWatchUpdate);
+    connect(m_model, &QAbstractItemModel::rowsInserted, this, &ProcessTable::scheduleWatchUpdate);
+    connect(m_model, &QAbstractItemModel::rowsRemoved, this, &ProcessTable::scheduleWatchUpdate);
+}
+
+void ProcessTable::updateSnapshot(const SystemSnapshot &snapshot)
+{
+    m_model->updateSnapshot(snapshot);
+}
+
+void ProcessTable::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    scheduleWatchUpdate();
+}
+
+void ProcessTable::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    scheduleWatchUpdate();
+}
+
+void ProcessTable::scheduleWatchUpdate()
+{
+    if (!m_watchTimer->isActive()) {
+        m_watchTimer->start();
+    }
+}
+
+void ProcessTable::updateWatched()
+{
+    QVector<quint32> pids;
+    const int rows = m_model->rowCount();
+    if (rows > 0) {
+        // rowAt() is -1 below the last row when the table is short
+        const int first = qMax(0, m_view->rowAt(0));
+        int last = m_view->rowAt(m_view->viewport()->height() - 1);
+        if (last < 0) {
+            last = rows - 1;
+        }
+        for (int row = first; row <= last; ++row) {
+            pids.append(m_model->pidAt(row));
+        }
+        const QModelIndex current = m_view->selectionModel()->currentIndex();
+        if (current.isValid() && (current.row() < first || current.row() > last)) {
+            pids.append(m_model->pidAt(current.row()));
+        }
+    }
+    // The same rows in another order need no new details
+    std::sort(pids.begin(), pids.end());
+    if (pids != m_watched) {
+        m_watched = pids;
+        emit watchedProcessesChanged(m_watched);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef PROCESSTABLE_H
+#define PROCESSTABLE_H
+
+#include <QVector>
+#include <QWidget>
+#include "../systemsnapshot.h"
+
+class ProcessTableModel;
+class QTableView;
+class QTimer;
+
+/**
+ * @brief The process list, with every process of the host
+ *
+ * A QTableView over a ProcessTableModel, set up for very many rows: fixed
+ * row heights, so the view never measures rows it does not show, and
+ * sorting by header click inside the model. Sorted by CPU to begin with.
+ *
+ * Detail fields are only loaded for the rows on screen and the selected
+ * one. Whenever those change, after scrolling settles, the table emits
+ * their PIDs for SystemMonitor::setWatchedProcesses().
+ */
+class ProcessTable : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit ProcessTable(QWidget *parent = nullptr);
+
+    void updateSnapshot(const SystemSnapshot &snapshot);
+
+signals:
+    void watchedProcessesChanged(const QVector<quint32> &pids);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+
+private slots:
+    void scheduleWatchUpdate();
+    void updateWatched();
+
+private:
+    ProcessTableModel *m_model;
+    QTableView *m_view;
+    // Coalesces scrolling and row moves into one update of the watch list
+    QTimer *m_watchTimer;
+    QVector<quint32> m_watched;
+};
+
+#endif // PROCESSTABLE_H
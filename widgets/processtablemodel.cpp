@@ -0,0 +1,447 @@
+#include "processtablemodel.h"
+#include "../utils/formatters.h"
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+#ifdef Q_OS_UNIX
+#include <pwd.h>
+#include <unistd.h>
+#endif
+
+// Beyond this many separate runs of exited rows, one layout change is
+// cheaper than a removal per run, each of which shifts the rows behind it
+static constexpr int kMaxRemovalRuns = 16;
+
+// Three-way comparison of two values, for the sort key
+template<typename T>
+static int compareValues(const T &a, const T &b)
+{
+    return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+ProcessTableModel::ProcessTableModel(QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_sortColumn(-1)
+    , m_sortOrder(Qt::AscendingOrder)
+    , m_rowOfPidValid(false)
+{
+}
+
+int ProcessTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+int ProcessTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ProcessTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size()) {
+        return QVariant();
+    }
+    const Row &row = m_rows.at(index.row());
+    const ProcessInfo &info = row.info;
+
+    if (role == Qt::TextAlignmentRole) {
+        switch (index.column()) {
+        case NameColumn:
+        case StatusColumn:
+        case UserColumn:
+        case CommandColumn:
+            return int(Qt::AlignLeft | Qt::AlignVCenter);
+        default:
+            return int(Qt::AlignRight | Qt::AlignVCenter);
+        }
+    }
+    if (role == Qt::ToolTipRole && index.column() == CommandColumn && row.hasDetails) {
+        return row.details.commandLine;
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    switch (index.column()) {
+    case PidColumn:
+        return info.pid;
+    case NameColumn:
+        return info.name;
+    case CpuColumn:
+        return Formatters::formatPercentage(info.cpuUsage);
+    case MemoryColumn:
+        return Formatters::formatBytes(info.memoryUsage);
+    case IoColumn:
+        return Formatters::formatBytes(info.ioBytesPerSec) + "/s";
+    case ThreadsColumn:
+        return info.threads;
+    case StatusColumn:
+        return info.status;
+    default:
+        break;
+    }
+
+    // Detail columns stay blank until the process has been watched
+    if (!row.hasDetails) {
+        return QVariant();
+    }
+    switch (index.column()) {
+    case UserColumn:
+        return userName(row.details.uid);
+    case PssColumn:
+        return row.details.pssBytes >= 0 ? QVariant(Formatters::formatBytes(row.details.pssBytes)) : QVariant();
+    case CommandColumn:
+        return row.details.commandLine;
+    default:
+        return QVariant();
+    }
+}
+
+QVariant ProcessTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    static const char *const titles[ColumnCount] = {
+        "PID", "Name", "CPU", "Memory", "Disk I/O", "Threads", "Status", "User", "PSS", "Command"
+    };
+    return section >= 0 && section < ColumnCount ? QString(titles[section]) : QVariant();
+}
+
+void ProcessTableModel::sort(int column, Qt::SortOrder order)
+{
+    m_sortColumn = column;
+    m_sortOrder = order;
+    sortRows();
+}
+
+void ProcessTableModel::updateSnapshot(const SystemSnapshot &snapshot)
+{
+    if (snapshot.updatedFamilies & familyBit(ProcessFamily)) {
+        if (!snapshot.processes.isEmpty()) {
+            applyProcesses(snapshot.processes);
+        } else {
+            // The rankings overlap; keep the first sighting of every PID
+            m_ranked.resize(0);
+            m_incoming.clear();
+            for (const QVector<ProcessInfo> &ranking : snapshot.topProcesses) {
+                for (const ProcessInfo &process : ranking) {
+                    if (!m_incoming.contains(process.pid)) {
+                        m_incoming.insert(process.pid, m_ranked.size());
+                        m_ranked.append(process);
+                    }
+                }
+            }
+            applyProcesses(m_ranked);
+        }
+    }
+    if (snapshot.updatedFamilies & (familyBit(ProcessFamily) | familyBit(ProcessDetailFamily))) {
+        applyDetails(snapshot.processDetails);
+    }
+    sortRows();
+}
+
+void ProcessTableModel::applyProcesses(const QVector<ProcessInfo> &processes)
+{
+    m_incoming.clear();
+    m_incoming.reserve(processes.size());
+    for (int i = 0; i < processes.size(); ++i) {
+        m_incoming.insert(processes.at(i).pid, i);
+    }
+
+    // Rows of processes that have exited
+    m_removed.resize(0);
+    for (int row = 0; row < m_rows.size(); ++row) {
+        if (!m_incoming.contains(m_rows.at(row).info.pid)) {
+            m_removed.append(row);
+        }
+    }
+    removeExitedRows(m_removed);
+
+    // Changed cells, reported for runs of adjacent changed rows over the
+    // columns that changed in any of them
+    m_matched.fill(false, processes.size());
+    int runFirst = -1;
+    int runLast = -1;
+    int runFirstColumn = ColumnCount;
+    int runLastColumn = -1;
+    for (int row = 0; row < m_rows.size(); ++row) {
+        ProcessInfo &current = m_rows[row].info;
+        const int incoming = m_incoming.value(current.pid);
+        m_matched[incoming] = true;
+        const ProcessInfo &next = processes.at(incoming);
+
+        int firstColumn = ColumnCount;
+        int lastColumn = -1;
+        auto changed = [&](Column column) {
+            firstColumn = qMin(firstColumn, int(column));
+            lastColumn = qMax(lastColumn, int(column));
+        };
+        if (current.name != next.name) {
+            changed(NameColumn);
+        }
+        if (current.cpuUsage != next.cpuUsage) {
+            changed(CpuColumn);
+        }
+        if (current.memoryUsage != next.memoryUsage) {
+            changed(MemoryColumn);
+        }
+        if (current.ioBytesPerSec != next.ioBytesPerSec) {
+            changed(IoColumn);
+        }
+        if (current.threads != next.threads) {
+            changed(ThreadsColumn);
+        }
+        if (current.status != next.status) {
+            changed(StatusColumn);
+        }
+        if (lastColumn < 0) {
+            continue;
+        }
+        current = next;
+
+        if (runLast == row - 1 && runFirst >= 0) {
+            runLast = row;
+            runFirstColumn = qMin(runFirstColumn, firstColumn);
+            runLastColumn = qMax(runLastColumn, lastColumn);
+        } else {
+            emitChangedRows(runFirst, runLast, runFirstColumn, runLastColumn);
+            runFirst = runLast = row;
+            runFirstColumn = firstColumn;
+            runLastColumn = lastColumn;
+        }
+    }
+    emitChangedRows(runFirst, runLast, runFirstColumn, runLastColumn);
+
+    // New processes, appended in one insertion; sorting places them
+    int added = 0;
+    for (bool matched : std::as_const(m_matched)) {
+        added += matched ? 0 : 1;
+    }
+    if (added > 0) {
+        const int first = m_rows.size();
+        beginInsertRows(QModelIndex(), first, first + added - 1);
+        m_rows.reserve(first + added);
+        for (int i = 0; i < processes.size(); ++i) {
+            if (!m_matched.at(i)) {
+                Row row;
+                row.info = processes.at(i);
+                m_rows.append(row);
+            }
+        }
+        endInsertRows();
+        m_rowOfPidValid = false;
+    }
+}
+
+void ProcessTableModel::removeExitedRows(const QVector<int> &removed)
+{
+    if (removed.isEmpty()) {
+        return;
+    }
+    m_rowOfPidValid = false;
+
+    int runs = 1;
+    for (int i = 1; i < removed.size(); ++i) {
+        runs += removed.at(i) != removed.at(i - 1) + 1 ? 1 : 0;
+    }
+    if (runs > kMaxRemovalRuns) {
+        // Keep the survivors in their order, dropping the others
+        m_order.resize(0);
+        int next = 0;
+        for (int row = 0; row < m_rows.size(); ++row) {
+            if (next < removed.size() && removed.at(next) == row) {
+                ++next;
+            } else {
+                m_order.append(row);
+            }
+        }
+        emit layoutAboutToBeChanged();
+        reorderRows();
+        emit layoutChanged();
+        return;
+    }
+
+    // Back to front, so earlier runs keep their row numbers
+    int last = removed.size() - 1;
+    while (last >= 0) {
+        int first = last;
+        while (first > 0 && removed.at(first - 1) == removed.at(first) - 1) {
+            --first;
+        }
+        beginRemoveRows(QModelIndex(), removed.at(first), removed.at(last));
+        m_rows.remove(removed.at(first), last - first + 1);
+        endRemoveRows();
+        last = first - 1;
+    }
+}
+
+void ProcessTableModel::applyDetails(const QVector<ProcessDetails> &details)
+{
+    m_previousDetailPids.swap(m_detailPids);
+    m_detailPids.resize(0);
+    for (const ProcessDetails &detail : details) {
+        const int row = rowOfPid(detail.pid);
+        if (row < 0) {
+            continue;
+        }
+        Row &target = m_rows[row];
+        target.details = detail;
+        target.hasDetails = true;
+        m_detailPids.append(detail.pid);
+        emitChangedRows(row, row, UserColumn, CommandColumn);
+    }
+
+    // Rows that are no longer watched go blank again; both lists only
+    // hold the rows on screen
+    for (quint32 pid : std::as_const(m_previousDetailPids)) {
+        if (m_detailPids.contains(pid)) {
+            continue;
+        }
+        const int row = rowOfPid(pid);
+        if (row >= 0 && m_rows.at(row).hasDetails) {
+            m_rows[row].hasDetails = false;
+            emitChangedRows(row, row, UserColumn, CommandColumn);
+        }
+    }
+}
+
+void ProcessTableModel::sortRows()
+{
+    if (m_sortColumn < 0 || m_sortColumn >= ColumnCount) {
+        return;
+    }
+    auto lessThan = [this](const Row &a, const Row &b) { return rowLessThan(a, b); };
+    // Most ticks move no row at all, e.g. when sorted by PID or name
+    if (std::is_sorted(m_rows.cbegin(), m_rows.cend(), lessThan)) {
+        return;
+    }
+
+    // Sort a permutation, so persistent indexes can follow their rows
+    m_order.resize(m_rows.size());
+    std::iota(m_order.begin(), m_order.end(), 0);
+    std::sort(m_order.begin(), m_order.end(), [this](int a, int b) {
+        return rowLessThan(m_rows.at(a), m_rows.at(b));
+    });
+    emit layoutAboutToBeChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+    reorderRows();
+    emit layoutChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+}
+
+void ProcessTableModel::reorderRows()
+{
+    m_newRowOf.fill(-1, m_rows.size());
+    m_reordered.resize(0);
+    m_reordered.reserve(m_order.size());
+    for (int i = 0; i < m_order.size(); ++i) {
+        m_newRowOf[m_order.at(i)] = i;
+        m_reordered.append(std::move(m_rows[m_order.at(i)]));
+    }
+    m_rows.swap(m_reordered);
+    m_rowOfPidValid = false;
+
+    // Only the views' few persistent indexes (selection, current row)
+    // need moving, not every row
+    const QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    to.reserve(from.size());
+    for (const QModelIndex &index : from) {
+        const int row = m_newRowOf.value(index.row(), -1);
+        to.append(row >= 0 ? createIndex(row, index.column()) : QModelIndex());
+    }
+    changePersistentIndexList(from, to);
+}
+
+bool ProcessTableModel::rowLessThan(const Row &a, const Row &b) const
+{
+    int order = 0;
+    switch (m_sortColumn) {
+    case NameColumn:
+        order = a.info.name.compare(b.info.name, Qt::CaseInsensitive);
+        break;
+    case CpuColumn:
+        order = compareValues(a.info.cpuUsage, b.info.cpuUsage);
+        break;
+    case MemoryColumn:
+        order = compareValues(a.info.memoryUsage, b.info.memoryUsage);
+        break;
+    case IoColumn:
+        order = compareValues(a.info.ioBytesPerSec, b.info.ioBytesPerSec);
+        break;
+    case ThreadsColumn:
+        order = compareValues(a.info.threads, b.info.threads);
+        break;
+    case StatusColumn:
+        order = a.info.status.compare(b.info.status);
+        break;
+    case UserColumn:
+    case PssColumn:
+    case CommandColumn:
+        // Rows without details sort last either way
+        if (a.hasDetails != b.hasDetails) {
+            return a.hasDetails;
+        }
+        if (!a.hasDetails) {
+            break;
+        }
+        if (m_sortColumn == UserColumn) {
+            order = compareValues(a.details.uid, b.details.uid);
+        } else if (m_sortColumn == PssColumn) {
+            order = compareValues(a.details.pssBytes, b.details.pssBytes);
+        } else {
+            order = a.details.commandLine.compare(b.details.commandLine);
+        }
+        break;
+    default:
+        break;
+    }
+    if (order != 0) {
+        return m_sortOrder == Qt::AscendingOrder ? order < 0 : order > 0;
+    }
+    // Ties always go by PID, so equal rows never swap places between ticks
+    return m_sortColumn == PidColumn && m_sortOrder == Qt::DescendingOrder ? a.info.pid > b.info.pid
+                                                                           : a.info.pid < b.info.pid;
+}
+
+void ProcessTableModel::emitChangedRows(int firstRow, int lastRow, int firstColumn, int lastColumn)
+{
+    if (firstRow < 0 || lastColumn < 0) {
+        return;
+    }
+    emit dataChanged(index(firstRow, firstColumn), index(lastRow, lastColumn), {Qt::DisplayRole});
+}
+
+int ProcessTableModel::rowOfPid(quint32 pid)
+{
+    if (!m_rowOfPidValid) {
+        m_rowOfPid.clear();
+        m_rowOfPid.reserve(m_rows.size());
+        for (int row = 0; row < m_rows.size(); ++row) {
+            m_rowOfPid.insert(m_rows.at(row).info.pid, row);
+        }
+        m_rowOfPidValid = true;
+    }
+    return m_rowOfPid.value(pid, -1);
+}
+
+QString ProcessTableModel::userName(quint32 uid) const
+{
+    auto cached = m_userNames.constFind(uid);
+    if (cached != m_userNames.constEnd()) {
+        return cached.value();
+    }
+    QString name = QString::number(uid);
+#ifdef Q_OS_UNIX
+    // getpwuid() may consult NSS and take a while, hence the cache
+    struct passwd entry;
+    struct passwd *result = nullptr;
+    char buffer[1024];
+    if (getpwuid_r(uid, &entry, buffer, sizeof(buffer), &result) == 0 && result) {
+        name = QString::fromLocal8Bit(result->pw_name);
+    }
+#endif
+    m_userNames.insert(uid, name);
+    return name;
+}
@@ -0,0 +1,99 @@
+#ifndef PROCESSTABLEMODEL_H
+#define PROCESSTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QVector>
+#include "../systemsnapshot.h"
+
+/**
+ * @brief Every process of the latest snapshot, one row each
+ *
+ * Built for tens of thousands of rows. Each snapshot is applied as a diff
+ * against the rows already shown: exited processes are removed in runs,
+ * new ones appended in one insertion, and dataChanged covers only the
+ * rows and columns whose values moved. The model is never reset, so the
+ * views keep their scroll position and selection, and repaint only what
+ * changed. Text is formatted in data(), i.e. only for rows on screen.
+ *
+ * Sorting happens in the model itself. After every update the rows are
+ * checked for order and re-sorted only when a value moved a row; the
+ * layout change carries persistent indexes along.
+ *
+ * The detail columns are filled for the processes in the snapshot's
+ * processDetails only, and blank otherwise.
+ */
+class ProcessTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column {
+        PidColumn,
+        NameColumn,
+        CpuColumn,
+        MemoryColumn,
+        IoColumn,
+        ThreadsColumn,
+        StatusColumn,
+        UserColumn,    // details from here on
+        PssColumn,
+        CommandColumn,
+        ColumnCount
+    };
+
+    explicit ProcessTableModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    // Applies the families the snapshot updated. Without a full process
+    // list, e.g. while viewing another collector, the rankings stand in.
+    void updateSnapshot(const SystemSnapshot &snapshot);
+
+    quint32 pidAt(int row) const { return m_rows.at(row).info.pid; }
+
+private:
+    struct Row {
+        ProcessInfo info;
+        ProcessDetails details;
+        bool hasDetails = false;
+    };
+
+    void applyProcesses(const QVector<ProcessInfo> &processes);
+    void applyDetails(const QVector<ProcessDetails> &details);
+    void removeExitedRows(const QVector<int> &removed);
+    void sortRows();
+    // Moves the rows into the order of m_order, which lists old rows by
+    // their new position and may leave some out
+    void reorderRows();
+    bool rowLessThan(const Row &a, const Row &b) const;
+    void emitChangedRows(int firstRow, int lastRow, int firstColumn, int lastColumn);
+    int rowOfPid(quint32 pid);
+    QString userName(quint32 uid) const;
+
+    QVector<Row> m_rows;
+    int m_sortColumn;
+    Qt::SortOrder m_sortOrder;
+
+    // Scratch space reused between updates
+    QHash<quint32, int> m_incoming; // pid -> index into the applied list
+    QVector<bool> m_matched;
+    QVector<int> m_removed;
+    QVector<int> m_order;
+    QVector<int> m_newRowOf;
+    QVector<Row> m_reordered;
+    QVector<ProcessInfo> m_ranked;
+
+    // pid -> row, rebuilt on demand after rows moved
+    QHash<quint32, int> m_rowOfPid;
+    bool m_rowOfPidValid;
+    // Rows showing details, now and before the latest update
+    QVector<quint32> m_detailPids;
+    QVector<quint32> m_previousDetailPids;
+    mutable QHash<quint32, QString> m_userNames;
+};
+
+#endif // PROCESSTABLEMODEL_H